@@ -68,6 +68,18 @@ local function server()
 end
 
 
+--往返延迟采样(微秒),每秒输出一次p50/p99
+local rtts = {}
+
+local function showLatency()
+	local n = #rtts
+	if n > 0 then
+		table.sort(rtts)
+		print(string.format("rtt samples:%d,p50:%dus,p99:%dus",n,rtts[math.ceil(n*0.5)],rtts[math.ceil(n*0.99)]))
+		rtts = {}
+	end
+end
+
 local function client(clientCount)
 
 	local content = ""
@@ -75,6 +87,8 @@ local function client(clientCount)
 		content = content .. "11111111"
 	end
 
+	event_loop:AddTimer(1000,showLatency)
+
 	local c = 0
 	for i=1,clientCount do
 		socket.stream.dial(event_loop,serverAddr,function (fd,errCode)
@@ -92,8 +106,12 @@ local function client(clientCount)
 						event_loop:Stop()
 					end
 				end)
+				local sendTick
 				conn:Start(event_loop,function (data)
 					if data then
+						local now = chuck.time.microtick()
+						rtts[#rtts + 1] = now - sendTick
+						sendTick = now
 						conn:Send(data)
 					else
 						conn:Close()
@@ -104,6 +122,7 @@ local function client(clientCount)
 				local buff = chuck.buffer.New(4096)
 				local w = packet.Writer(buff)
 				w:WriteStr(content)
+				sendTick = chuck.time.microtick()
 				conn:Send(buff)
 			end
 		end)
@@ -115,17 +134,23 @@ local function run()
 
 	local runType = arg[1]
 	if not runType then
-		print("usage: lua benchmark_brocast both|server|client [clientCount]")
+		print("usage: lua benchmark_pingpong both|server|client [clientCount] [busyPollUs]")
 		return
 	end
 	local clientCount = arg[2]
 
 
 	if (runType == "both" or runType == "client") and nil == clientCount then
-		print("usage: lua benchmark_brocast both|server|client [clientCount]")
+		print("usage: lua benchmark_pingpong both|server|client [clientCount] [busyPollUs]")
 		return
 	end	
 
+	--busyPollUs > 0时开启busy-poll,比较两种模式下客户端输出的rtt p50/p99
+	local busyPoll = tonumber(arg[3])
+	if busyPoll and busyPoll > 0 then
+		event_loop:SetBusyPoll(busyPoll)
+	end
+
 	if runType == "both" or runType == "server" then
 		if not server() then
 			print("start server failed")
@@ -0,0 +1,35 @@
+package.path = './lib/?.lua;'
+package.cpath = './lib/?.so;'
+
+local chuck = require("chuck")
+local socket = chuck.socket
+local log = chuck.log
+
+local event_loop,idx = ...
+
+if event_loop then
+	--运行在loop_group的线程中,每个线程以SO_REUSEPORT监听同一地址
+	local serverAddr = socket.addr(socket.AF_INET,"127.0.0.1",9010)
+	server = socket.stream.listen(event_loop,serverAddr,function (fd)
+		local conn = socket.stream.socket(fd,4096)
+		if conn then
+			conn:Start(event_loop,function (data,err)
+				if data then
+					conn:Send(data:Clone())
+				else
+					conn:Close()
+				end
+			end)
+		end
+	end,true)
+	log.SysLog(log.info,string.format("worker %d start",idx))
+else
+	local main_loop = chuck.event_loop.New()
+	local group = chuck.event_loop.NewGroup(4,"example/loop_group_echo.lua")
+	main_loop:WatchSignal(chuck.signal.SIGINT,function()
+		log.SysLog(log.info,"recv SIGINT stop server")
+		group:Stop()
+		main_loop:Stop()
+	end)
+	main_loop:Run()
+end
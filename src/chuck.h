@@ -16,10 +16,12 @@
 #include "util/chk_signal.h"
 #include "thread/chk_thread.h"
 #include "event/chk_event_loop.h"
+#include "event/chk_loop_group.h"
 #include "socket/chk_acceptor.h"
 #include "socket/chk_connector.h"
 #include "socket/chk_decoder.h"
 #include "socket/chk_stream_socket.h"
+#include "socket/chk_socket_group.h"
 #include "socket/chk_datagram_socket.h"
 #include "lua/chk_lua.h"
 #include "redis/chk_client.h"
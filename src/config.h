@@ -16,6 +16,29 @@
 
 #define MAX_SEND_SIZE        1024*64
 
+/*
+*  边缘触发模式下stream_socket每次事件处理的预算:读(写)的字节数达到STREAM_IO_BUDGET,
+*  或回调给上层的包数达到STREAM_PACKET_BUDGET时停止处理,handle被放到loop的让出列表,
+*  下一轮循环继续处理,避免繁忙的连接饿死其它连接
+*/
+
+#define STREAM_IO_BUDGET     1024*256
+
+#define STREAM_PACKET_BUDGET 64
+
+/*
+*  接收缓冲自适应(option.recv_buffer_max大于recv_buffer_size时开启):读满提供的缓冲时接收chunk倍增,
+*  连续CHK_RECV_SHRINK_WINDOW次读取的字节数都不超过当前大小的1/4时减半
+*/
+
+#define CHK_RECV_SHRINK_WINDOW 64
+
+/*
+*  惰性接收模式(option.lazy_recv)下每个线程用于读取的临时缓冲大小
+*/
+
+#define CHK_RECV_SCRATCH_SIZE  1024*64
+
 /*
 *  定时器支持的最大超时值(毫秒),如果传入的超时值大于MAX_TIMEOUT
 *  超时值将被设置为MAX_TIMEOUT 
@@ -29,6 +52,21 @@
 
 #define INIT_FREE_TIMER_SIZE 1024
 
+/*
+*  closure对象池(每线程)每次补充的数量,以及线程缓存的最大空闲closure数量,
+*  超过MAX_FREE_CLOSURE_SIZE的closure直接释放
+*/
+
+#define INIT_FREE_CLOSURE_SIZE 256
+
+#define MAX_FREE_CLOSURE_SIZE  4096
+
+/*
+*  每个线程缓存的空闲stream_socket对象的最大数量,超过的直接释放
+*/
+
+#define MAX_FREE_STREAM_SOCKET 1024
+
 
 /*
 *  单个日志文件的最大大小,超过这个值将会创建新的日志文件 
@@ -56,6 +94,55 @@
 
 #define CHK_IDLE_TIMER_TIMEOUT 100
 
+/*
+*  空闲时步进lua GC的默认参数:每次lua_gc(LUA_GCSTEP)的步长(KB),每次空闲时GC的时间上限(微秒)
+*/
+
+#define CHK_LUA_GC_STEP_KB     64
+
+#define CHK_LUA_GC_BUDGET_US   1000
+
+/*
+*  busy-poll自适应窗口的下限(微秒),loop空闲时轮询窗口逐次减半直到这个值
+*/
+
+#define CHK_BUSY_POLL_MIN_US   8
+
+/*
+*  每轮循环最多处理的closure数量(默认预算,可以通过chk_loop_set_budget修改)
+*/
+
+#define CHK_LOOP_CLOSURE_BUDGET 1024
+
+/*
+*  共享epoll模式下worker每次从共享epoll取出的最大事件数,取得越少负载在worker之间分布越均匀
+*/
+
+#define CHK_SHARED_EPOLL_BATCH 4
+
+/*
+*  watchdog用于请求loop线程记录调用栈的信号.只在loop线程被卡住时发送,
+*  会打断该线程正在进行的慢速系统调用(安装时带SA_RESTART)
+*/
+
+#ifdef _LINUX
+#define CHK_WATCHDOG_SIGNAL    (SIGRTMIN+2)
+#else
+#define CHK_WATCHDOG_SIGNAL    SIGUSR2
+#endif
+
+/*
+*  watchdog等待loop线程记录调用栈的最长时间(毫秒),超时只输出回调的基本信息
+*/
+
+#define CHK_WATCHDOG_BT_WAIT   100
+
+/*
+*  acceptor准入控制默认的采样间隔(毫秒)
+*/
+
+#define CHK_ADMISSION_INTERVAL 100
+
 #define MAX_LOG_FILE_NAME 256
 
 #define SEND_TIME_OUT 5*1000
@@ -45,6 +45,14 @@ typedef void* chk_event_callback;
     int32_t         fd;                                                     \
     int32_t         active_evetns;/*激活的事件*/                            \
     int32_t         events;         /*关注的事件*/                          \
+    int32_t         kernel_events;  /*已提交给内核的关注事件*/              \
+    chk_dlist_entry pending_entry;  /*关注事件有变更,等待本轮循环提交*/     \
+    chk_dlist_entry flush_entry;    /*等待本轮循环结束时的CHK_EVENT_FLUSH*/ \
+    int8_t          priority;       /*就绪时的处理顺序,CHK_PRIORITY_XXX*/   \
+    int8_t          shared;         /*注册在loop group的共享epoll上*/       \
+    int8_t          shared_lock;    /*共享handle状态的自旋锁*/              \
+    int8_t          shared_held;    /*共享handle正被worker持有,未arm*/      \
+    int8_t          shared_handoff; /*有其它线程交来的操作,arm时加上写事件*/\
     chk_event_loop *loop;                                                   \
     int32_t (*handle_add)(chk_event_loop*,chk_handle*,chk_event_callback);  \
     void    (*on_events)(chk_handle*,int32_t events)                    
@@ -55,6 +63,18 @@ struct chk_handle {
     _chk_handle;
 };
 
+/*
+* handle的优先级,同一轮循环中就绪的handle按HIGH,NORMAL,LOW的顺序处理,
+* I/O预算用完时剩余的handle留到下一轮.监听和控制连接使用HIGH,大流量的数据连接使用LOW
+*/
+
+enum{
+    CHK_PRIORITY_NORMAL = 0,
+    CHK_PRIORITY_HIGH,
+    CHK_PRIORITY_LOW,
+    CHK_PRIORITY_COUNT,
+};
+
 
 #ifndef TEMP_FAILURE_RETRY
 #define TEMP_FAILURE_RETRY(expression)                                      \
@@ -75,7 +95,9 @@ extern int32_t pipe2(int pipefd[2], int flags);
 enum{
     CHK_EVENT_READ   =  EPOLLIN | EPOLLERR | EPOLLHUP | EPOLLRDHUP,
     CHK_EVENT_WRITE  =  EPOLLOUT,
+    CHK_EVENT_ET     =  (int32_t)EPOLLET,//与READ/WRITE一起传给chk_watch_handle,以边缘触发方式监听
     CHK_EVENT_LOOPCLOSE = 0x7fffffff,//engine close    
+    CHK_EVENT_FLUSH  =  0x7ffffffe,//本轮循环结束,见chk_loop_defer_flush
 };
 
 #elif _MACH
@@ -85,7 +107,9 @@ enum{
 enum{
     CHK_EVENT_READ   =  1,
     CHK_EVENT_WRITE  =  1 << 2,
+    CHK_EVENT_ET     =  1 << 3,//对应EV_CLEAR
     CHK_EVENT_LOOPCLOSE = 0x7fffffff,//engine close         
+    CHK_EVENT_FLUSH  =  0x7ffffffe,//本轮循环结束,见chk_loop_defer_flush
 };
 
 #else
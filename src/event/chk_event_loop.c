@@ -1,13 +1,16 @@
 #include <assert.h>
+#include <pthread.h>
+#include <string.h>
 #include "thread/chk_thread.h"
 #include "util/chk_log.h"
+#include "util/chk_atomic.h"
+#include "../config.h"
 
 #define _CORE_
 
 #include "event/chk_event_loop.h" 
 #include "event/chk_event_loop_define.h"
-
-static int32_t stopevent = 1;
+#include "event/chk_loop_watchdog.h"
 
 #define READY_TO_HANDLE(ENTRY)                                              \
     (chk_handle*)(((char*)(ENTRY))-sizeof(chk_dlist_entry))
@@ -18,6 +21,15 @@ enum {
 	CLOSING =  1 << 2,
 };
 
+#ifdef CHUCK_LUA
+//恢复自动回收,释放步进用的锚点(见chk_lua_gc_anchor)
+static void chk_lua_gc_free(_lua_gc *gc) {
+	lua_pushnil(gc->L);
+	lua_rawsetp(gc->L,LUA_REGISTRYINDEX,gc);
+	lua_gc(gc->L,LUA_GCRESTART,0);
+	free(gc);
+}
+#endif
 
 static inline void chk_idle_finalize(chk_event_loop *e) {
 	if(e->idle.idle_timer) {
@@ -28,12 +40,27 @@ static inline void chk_idle_finalize(chk_event_loop *e) {
 	if(e->idle.on_idle.L) {
 		chk_luaRef_release(&e->idle.on_idle);
 	}
+	if(e->idle.gc) {
+		chk_lua_gc_free(e->idle.gc);
+		e->idle.gc = NULL;
+	}
 #endif
 
 }
 
+#ifdef CHUCK_LUA
+static void chk_lua_gc_run(chk_event_loop *e,int32_t idle);
+#endif
+
 static inline void chk_check_idle(chk_event_loop *e,uint64_t elapse) {
 
+#ifdef CHUCK_LUA
+	//内存增长的检查每轮循环都做,只读取计数
+	if(e->idle.gc && e->idle.fire_tick == 0) {
+		chk_lua_gc_run(e,0);
+	}
+#endif
+
 	if(e->idle.fire_tick == 0) {
 		return;
 	}
@@ -53,6 +80,10 @@ static inline void chk_check_idle(chk_event_loop *e,uint64_t elapse) {
 		}
 	}
 
+	if(e->idle.gc) {
+		chk_lua_gc_run(e,elapse < 1);
+	}
+
 #else
 
 	if(e->idle.on_idle) {
@@ -68,13 +99,557 @@ static inline void chk_check_idle(chk_event_loop *e,uint64_t elapse) {
 }
 
 
+/*
+* closure对象池,每线程一个.closure从投递线程的池中分配,通常在loop线程中释放,
+* 释放时归还给分配它的池:同一线程直接放回空闲列表,其它线程压入池的remote栈(无锁),
+* 池所属的线程在空闲列表为空时一次取走整个remote栈,所以跨线程投递也能重复使用closure.
+* refs为属于该池的closure数加上线程本身的1,线程退出之后池在最后一个closure释放时删除
+*/
+
+typedef struct chk_closure_pool {
+	chk_mpsc_node *head;              //空闲列表,只在所属线程访问
+	uint32_t       size;
+	chk_mpsc_node *remote;            //其它线程归还的closure
+	uint32_t       refs;
+	int32_t        dead;              //所属线程已经退出
+}closure_pool;
+
+static pthread_key_t   closure_pool_key;
+static pthread_once_t  closure_pool_once = PTHREAD_ONCE_INIT;
+static __thread closure_pool *t_closure_pool = NULL;
+
+static inline void closure_pool_unref(closure_pool *pool,uint32_t n) {
+	if(n > 0 && 0 == chk_atomic_sub_fetch(&pool->refs,n)) {
+		free(pool);
+	}
+}
+
+/*释放列表中的closure,返回释放的数量*/
+static uint32_t closure_list_free(chk_mpsc_node *n) {
+	chk_mpsc_node *next;
+	uint32_t       count = 0;
+	for(; n; n = next) {
+		next = n->next;
+		free(n);
+		++count;
+	}
+	return count;
+}
+
+static inline void closure_remote_push(closure_pool *pool,chk_mpsc_node *n) {
+	chk_mpsc_node *head;
+	//只有所属线程以exchange取走整个栈,不存在ABA问题
+	do {
+		head = chk_atomic_load_acquire(&pool->remote);
+		n->next = head;
+	}while(!chk_compare_and_swap(&pool->remote,head,n));
+}
+
+static void closure_pool_destructor(void *ud) {
+	closure_pool  *pool = (closure_pool*)ud;
+	uint32_t       count;
+	count = closure_list_free(pool->head);
+	pool->head = NULL;
+	pool->size = 0;
+	chk_atomic_store_release(&pool->dead,1);
+	chk_fence();
+	//之后归还的closure由归还的线程释放
+	count += closure_list_free(chk_atomic_exchange(&pool->remote,NULL));
+	t_closure_pool = NULL;
+	closure_pool_unref(pool,count + 1);
+}
+
+static void closure_pool_key_create() {
+	pthread_key_create(&closure_pool_key,closure_pool_destructor);
+}
+
+static inline closure_pool *get_closure_pool() {
+	if(!t_closure_pool) {
+		pthread_once(&closure_pool_once,closure_pool_key_create);
+		t_closure_pool = calloc(1,sizeof(*t_closure_pool));
+		if(t_closure_pool) {
+			t_closure_pool->refs = 1;
+			pthread_setspecific(closure_pool_key,t_closure_pool);
+		}
+	}
+	return t_closure_pool;
+}
+
+/*取回其它线程归还的closure,空闲列表最多保留MAX_FREE_CLOSURE_SIZE个*/
+static void closure_pool_reclaim(closure_pool *pool) {
+	chk_mpsc_node *n,*next;
+	uint32_t       count = 0;
+	for(n = chk_atomic_exchange(&pool->remote,NULL); n; n = next) {
+		next = n->next;
+		if(pool->size < MAX_FREE_CLOSURE_SIZE) {
+			n->next = pool->head;
+			pool->head = n;
+			++pool->size;
+		} else {
+			free(n);
+			++count;
+		}
+	}
+	closure_pool_unref(pool,count);
+}
+
+static inline chk_clouser *get_free_closure() {
+	int32_t        i;
+	chk_mpsc_node *n;
+	chk_clouser   *c;
+	closure_pool  *pool = get_closure_pool();
+	if(!pool) {
+		return calloc(1,sizeof(chk_clouser));
+	}
+
+	if(!pool->head && chk_atomic_load_acquire(&pool->remote)) {
+		closure_pool_reclaim(pool);
+	}
+
+	if(!pool->head) {
+		for(i = 0; i < INIT_FREE_CLOSURE_SIZE; ++i) {
+			if(NULL == (n = malloc(sizeof(chk_clouser)))) {
+				break;
+			}
+			n->next = pool->head;
+			pool->head = n;
+			++pool->size;
+		}
+		if(i > 0) {
+			chk_atomic_add_fetch(&pool->refs,i);
+		}
+	}
+
+	if(!(n = pool->head)) {
+		return NULL;
+	}
+	pool->head = n->next;
+	--pool->size;
+	c = (chk_clouser*)n;
+	memset(c,0,sizeof(*c));
+	c->pool = pool;
+	return c;
+}
+
+static inline void release_closure(chk_clouser *c) {
+	closure_pool *pool = c->pool;
+	if(!pool) {
+		free(c);
+	} else if(pool == t_closure_pool) {
+		if(pool->size < MAX_FREE_CLOSURE_SIZE) {
+			c->entry.next = pool->head;
+			pool->head = &c->entry;
+			++pool->size;
+		} else {
+			free(c);
+			closure_pool_unref(pool,1);
+		}
+	} else {
+		//c保证pool此时有效,先加一个引用,所属线程可能同时退出并释放它取走的closure
+		chk_atomic_increase_fetch(&pool->refs);
+		closure_remote_push(pool,&c->entry);
+		chk_fence();
+		if(chk_atomic_load_acquire(&pool->dead)) {
+			closure_pool_unref(pool,closure_list_free(chk_atomic_exchange(&pool->remote,NULL)));
+		}
+		closure_pool_unref(pool,1);
+	}
+}
+
 void chk_destroy_closure(chk_clouser *c) {
 	#ifdef CHUCK_LUA
 		if(c->data.v.lr.L) {
 			chk_luaRef_release(&c->data.v.lr);
 		}
 	#endif
-	free(c);
+	release_closure(c);
+}
+
+static inline chk_clouser *chk_pop_closure(chk_event_loop *e) {
+	return (chk_clouser*)chk_mpsc_queue_pop(&e->closures);
+}
+
+static inline int32_t chk_have_closure(chk_event_loop *e) {
+	return !chk_mpsc_queue_empty(&e->closures);
+}
+
+/*
+*  计算等待事件的超时时间(毫秒,-1表示无限等待):有待处理的closure或让出的handle时不等待,
+*  否则最多等到下一个定时器到期.没有定时器到期时loop不会被唤醒
+*/
+
+static inline int32_t chk_loop_timeout(chk_event_loop *e,uint32_t ms,int once) {
+	int32_t timeout,next;
+	if(chk_have_closure(e) || !chk_dlist_empty(&e->yield)) {
+		return 0;
+	}
+	timeout = once ? (int32_t)ms : -1;
+	if(timeout != 0 && e->timermgr) {
+		next = chk_timermgr_next_timeout(e->timermgr,chk_accurate_tick64());
+		if(next >= 0 && (timeout < 0 || next < timeout)) {
+			timeout = next;
+		}
+	}
+	return timeout;
+}
+
+/*
+*  就绪列表按优先级分为CHK_PRIORITY_COUNT个,按chk_priority_order的顺序处理
+*/
+
+static const int8_t chk_priority_order[CHK_PRIORITY_COUNT] = {
+	CHK_PRIORITY_HIGH,
+	CHK_PRIORITY_NORMAL,
+	CHK_PRIORITY_LOW,
+};
+
+static inline void chk_ready_init(chk_dlist *ready_list) {
+	int32_t i;
+	for(i = 0; i < CHK_PRIORITY_COUNT; ++i) {
+		chk_dlist_init(&ready_list[i]);
+	}
+}
+
+static inline chk_dlist *chk_ready_list(chk_dlist *ready_list,chk_handle *h) {
+	uint8_t priority = (uint8_t)h->priority;
+	return &ready_list[priority < CHK_PRIORITY_COUNT ? priority : CHK_PRIORITY_NORMAL];
+}
+
+/*
+*  将handle加入本轮的就绪列表,handle已经在列表中(同一fd的多个事件,或上一轮让出的handle)时合并事件
+*/
+
+static inline void chk_ready_handle(chk_dlist *ready_list,chk_handle *h,int32_t events) {
+	if(h->ready_entry.next) {
+		h->active_evetns |= events;
+	} else {
+		h->active_evetns = events;
+		chk_dlist_pushback(chk_ready_list(ready_list,h),&h->ready_entry);
+	}
+}
+
+/*
+*  把上一轮让出的handle移入本轮的就绪列表,只保留仍然被关注的事件
+*/
+
+static inline void chk_take_yield(chk_event_loop *e,chk_dlist *ready_list) {
+	chk_dlist_entry *entry;
+	chk_handle      *h;
+	while((entry = chk_dlist_pop(&e->yield))) {
+		h = READY_TO_HANDLE(entry);
+		h->active_evetns &= h->events;
+		if(h->active_evetns) {
+			chk_dlist_pushback(chk_ready_list(ready_list,h),entry);
+		}
+	}
+}
+
+/*
+*  阶段预算:count为已执行的回调数,deadline为截止的tsc(0表示不限时).
+*  预算用完后剩余的工作留到下一轮,chk_loop_timeout会让下一轮不阻塞
+*/
+
+typedef struct {
+	uint32_t count;
+	uint32_t limit;
+	uint64_t deadline;
+}chk_phase_budget;
+
+static inline void chk_budget_begin(chk_phase_budget *b,uint32_t count,uint32_t us) {
+	b->count    = 0;
+	b->limit    = count;
+	b->deadline = us ? chk_tsc() + (uint64_t)((double)us * 1000 / chk_tsc_ns_per_tick()) : 0;
+}
+
+//每执行完一个回调调用一次
+static inline int32_t chk_budget_exhausted(chk_phase_budget *b) {
+	if(b->limit && ++b->count >= b->limit) {
+		return 1;
+	}
+	return b->deadline && chk_tsc() >= b->deadline;
+}
+
+static int32_t chk_timer_budget_exhausted(void *ud) {
+	return chk_budget_exhausted(cast(chk_phase_budget*,ud));
+}
+
+static inline void chk_budget_default(chk_event_loop *e) {
+	memset(&e->budget,0,sizeof(e->budget));
+	e->budget.closure_count = CHK_LOOP_CLOSURE_BUDGET;
+}
+
+/*
+*  运行统计:开启时在每个阶段的边界读取一次TSC,累计各阶段耗时,
+*  没有开启时只有一次判断.统计可能在回调中被关闭,所以每次都重新读取e->stats
+*/
+
+#define TSC_TO_NS(TICKS) ((uint64_t)((double)(TICKS) * chk_tsc_ns_per_tick()))
+
+static inline uint32_t chk_lag_bucket(uint64_t us) {
+	uint32_t msb,idx;
+	if(us < 4) {
+		return (uint32_t)us;
+	}
+	msb = 63 - __builtin_clzll(us);
+	idx = ((msb - 1) << 2) | ((us >> (msb - 2)) & 3);
+	return idx < CHK_LOOP_LAG_BUCKETS ? idx : CHK_LOOP_LAG_BUCKETS - 1;
+}
+
+static inline uint64_t chk_stats_tsc(chk_event_loop *e) {
+	return e->stats ? chk_tsc() : 0;
+}
+
+//事件等待返回,*tsc为进入等待时的计数,返回后更新为唤醒时的计数
+static inline void chk_stats_wakeup(chk_event_loop *e,uint64_t *tsc,int32_t nfds) {
+	uint64_t        now;
+	chk_loop_stats *s = e->stats;
+	if(!s) {
+		return;
+	}
+	now = chk_tsc();
+	if(*tsc) {
+		s->wait_ns += TSC_TO_NS(now - *tsc);
+	}
+	*tsc = now;
+	++s->iterations;
+	if(nfds > 0) {
+		s->events += nfds;
+		if((uint64_t)nfds > s->max_events) {
+			s->max_events = nfds;
+		}
+	}
+}
+
+//把从*tsc到现在的时间累计到FIELD,并把*tsc更新为现在
+#define chk_stats_phase(E,TSC,FIELD) do {                                  \
+	if((E)->stats) {                                                        \
+		uint64_t __now = chk_tsc();                                         \
+		if(TSC) (E)->stats->FIELD += TSC_TO_NS(__now - (TSC));             \
+		(TSC) = __now;                                                      \
+	}                                                                       \
+}while(0)
+
+//一轮循环结束,记录从唤醒到现在的时间
+static inline void chk_stats_lag(chk_event_loop *e,uint64_t wake) {
+	chk_loop_stats *s = e->stats;
+	if(s && wake) {
+		++s->lag[chk_lag_bucket(TSC_TO_NS(chk_tsc() - wake)/1000)];
+	}
+}
+
+/*
+*  watchdog:开启时在回调前后更新探针.探针可能在回调中被替换或释放,所以离开时重新读取e->probe
+*/
+
+static inline void chk_probe_done(chk_event_loop *e) {
+	chk_loop_probe *p = e->probe;
+	if(p) {
+		chk_probe_leave(p);
+	}
+}
+
+static inline void chk_dispatch_handle(chk_event_loop *e,chk_handle *h) {
+	int32_t         fd;
+	uint64_t        start,ns;
+	chk_loop_stats *s;
+	if(!e->stats && !e->probe) {
+		h->on_events(h,h->active_evetns);
+		return;
+	}
+	fd = h->fd;
+	start = e->stats ? chk_tsc() : 0;
+	if(e->probe) {
+		chk_probe_enter(e->probe,CHK_PROBE_IO,fd,cast(void*,h->on_events));
+	}
+	h->on_events(h,h->active_evetns);
+	//这里之后不能访问h,因为h在on_events中可能被释放
+	chk_probe_done(e);
+	if((s = e->stats) && start) {
+		ns = TSC_TO_NS(chk_tsc() - start);
+		if(ns > s->slowest_ns) {
+			s->slowest_ns = ns;
+			s->slowest_fd = fd;
+		}
+	}
+}
+
+/*
+*  按优先级处理就绪的handle,I/O预算用完时把剩余的handle移入让出列表
+*/
+
+static inline void chk_dispatch_ready(chk_event_loop *e,chk_dlist *ready_list) {
+	int32_t           i,stop = 0;
+	chk_dlist        *l;
+	chk_dlist_entry  *entry;
+	chk_phase_budget  b;
+	chk_budget_begin(&b,e->budget.io_count,e->budget.io_us);
+	for(i = 0; i < CHK_PRIORITY_COUNT; ++i) {
+		l = &ready_list[chk_priority_order[i]];
+		while(!stop && (entry = chk_dlist_pop(l))) {
+			chk_dispatch_handle(e,READY_TO_HANDLE(entry));
+			stop = chk_budget_exhausted(&b);
+		}
+		while((entry = chk_dlist_pop(l))) {
+			chk_dlist_pushback(&e->yield,entry);
+		}
+	}
+}
+
+static inline void chk_run_timer(chk_event_loop *e) {
+	chk_phase_budget b;
+	if(!e->timermgr) {
+		return;
+	}
+	if(e->probe) {
+		chk_probe_enter(e->probe,CHK_PROBE_TIMER,-1,NULL);
+	}
+	if(e->budget.timer_count || e->budget.timer_us) {
+		chk_budget_begin(&b,e->budget.timer_count,e->budget.timer_us);
+		chk_timer_tick_budget(e->timermgr,chk_accurate_tick64(),chk_timer_budget_exhausted,&b);
+	} else {
+		chk_timer_tick(e->timermgr,chk_accurate_tick64());
+	}
+	chk_probe_done(e);
+}
+
+static inline void chk_run_closure(chk_event_loop *e,chk_clouser *c) {
+	if(e->probe) {
+		chk_probe_enter(e->probe,CHK_PROBE_CLOSURE,-1,cast(void*,c->func));
+	}
+	c->func(c->data);
+	chk_probe_done(e);
+	chk_destroy_closure(c);
+}
+
+static inline void chk_run_closures(chk_event_loop *e) {
+	chk_clouser      *c;
+	chk_phase_budget  b;
+	chk_budget_begin(&b,e->budget.closure_count,e->budget.closure_us);
+	while((c = chk_pop_closure(e))) {
+		chk_run_closure(e,c);
+		if(chk_budget_exhausted(&b)) {
+			break;
+		}
+	}
+}
+
+#define FLUSH_TO_HANDLE(ENTRY)                                              \
+    (chk_handle*)(((char*)(ENTRY))-offsetof(chk_handle,flush_entry))
+
+/*
+*  本轮循环结束,在等待事件之前回调请求了chk_loop_defer_flush的handle,
+*  回调中再次请求的handle在本次调用中继续处理
+*/
+
+static inline void chk_run_flush(chk_event_loop *e) {
+	chk_dlist_entry *entry;
+	chk_handle      *h;
+	while((entry = chk_dlist_pop(&e->flush))) {
+		h = FLUSH_TO_HANDLE(entry);
+		if(e->probe) {
+			chk_probe_enter(e->probe,CHK_PROBE_IO,h->fd,cast(void*,h->on_events));
+		}
+		h->on_events(h,CHK_EVENT_FLUSH);
+		chk_probe_done(e);
+	}
+}
+
+static inline void chk_watchdog_finalize(chk_event_loop *e) {
+	if(e->probe) {
+		chk_watchdog_unregister(e->probe);
+		e->probe = NULL;
+	}
+}
+
+/*
+*  busy-poll:阻塞等待之前先以0超时轮询至多busy_poll_window微秒.
+*  轮询期间(或刚结束后一个窗口内)等到事件说明loop繁忙,窗口翻倍直到busy_poll_us;
+*  否则窗口减半直到CHK_BUSY_POLL_MIN_US,空闲的loop每次唤醒只付出很短的轮询
+*/
+
+//返回轮询截止的tsc,返回0表示不轮询
+static inline uint64_t chk_busy_poll_deadline(chk_event_loop *e,int32_t timeout) {
+	uint64_t us;
+	if(!e->busy_poll_us || timeout == 0) {
+		return 0;
+	}
+	us = e->busy_poll_window;
+	if(timeout > 0 && (uint64_t)timeout * 1000 < us) {
+		us = (uint64_t)timeout * 1000;
+	}
+	return chk_tsc() + (uint64_t)((double)us * 1000 / chk_tsc_ns_per_tick());
+}
+
+static inline void chk_busy_poll_adapt(chk_event_loop *e,uint64_t deadline,int32_t nfds) {
+	uint64_t now    = chk_tsc();
+	uint32_t window = e->busy_poll_window;
+	if(nfds > 0 && (now <= deadline || TSC_TO_NS(now - deadline) <= (uint64_t)window * 1000)) {
+		window = window << 1 < e->busy_poll_us ? window << 1 : e->busy_poll_us;
+	} else {
+		window = MAX(window >> 1,MIN(CHK_BUSY_POLL_MIN_US,e->busy_poll_us));
+	}
+	e->busy_poll_window = window;
+}
+
+#ifdef CHUCK_LUA
+
+/*
+*  Lua 5.3进入清扫阶段时(entersweep->sweeptolive)一次释放allgc头部连续的全部死对象,
+*  这一步不可分割,空闲期间积累的垃圾越多停顿越长.每次步进前新建一个由注册表引用的表,
+*  新对象位于allgc头部且存活,清扫在它之后停下,其余的对象由后续步进增量清扫
+*/
+static inline void chk_lua_gc_anchor(_lua_gc *gc) {
+	lua_newtable(gc->L);
+	lua_rawsetp(gc->L,LUA_REGISTRYINDEX,gc);
+}
+
+/*
+*  空闲GC:空闲时只在回收周期进行中或内存有增长时步进;其余时候(每轮循环)只在增长超过force_kb时步进,
+*  直到回收周期结束.每次调用连续执行LUA_GCSTEP直到周期结束或用完budget_us,调用的总耗时作为一次停顿记录.
+*  只在两次步进之间检查时间,一次停顿不超过budget_us加上一次LUA_GCSTEP的耗时;原子阶段(atomic)
+*  同样不可分割,耗时与存活对象中需要重新遍历的部分成正比,无法由budget_us限制
+*/
+static void chk_lua_gc_run(chk_event_loop *e,int32_t idle) {
+	_lua_gc        *gc = e->idle.gc;
+	chk_loop_stats *s  = e->stats;
+	int32_t         kb = lua_gc(gc->L,LUA_GCCOUNT,0);
+	uint64_t        start,ns,steps = 0;
+	if(idle) {
+		if(!gc->in_cycle && kb <= gc->base_kb) {
+			return;
+		}
+	} else if(!gc->opt.force_kb || kb < gc->base_kb + (int32_t)gc->opt.force_kb) {
+		return;
+	}
+
+	start = chk_tsc();
+	do {
+		++steps;
+		chk_lua_gc_anchor(gc);
+		if(lua_gc(gc->L,LUA_GCSTEP,gc->opt.step_kb)) {
+			gc->in_cycle = 0;
+			gc->base_kb  = lua_gc(gc->L,LUA_GCCOUNT,0);
+			if(s) ++s->gc_cycles;
+			break;
+		}
+		gc->in_cycle = 1;
+		ns = TSC_TO_NS(chk_tsc() - start);
+	}while(ns < (uint64_t)gc->opt.budget_us * 1000);
+
+	if(s) {
+		ns = TSC_TO_NS(chk_tsc() - start);
+		s->gc_ns    += ns;
+		s->gc_steps += steps;
+		if(!idle) ++s->gc_forced;
+		++s->gc_pause[chk_lag_bucket(ns/1000)];
+	}
+}
+
+#endif
+
+static inline void chk_stats_finalize(chk_event_loop *e) {
+	free(e->stats);
+	e->stats = NULL;
 }
 
 #ifdef _LINUX
@@ -89,13 +664,174 @@ int32_t chk_loop_post_closure(chk_event_loop *loop,void (*func)(chk_ud),chk_ud u
 	if(!loop || !func) {
 		return chk_error_invaild_argument;
 	}
-	chk_clouser *c = (chk_clouser*)calloc(1,sizeof(*c));
+	chk_clouser *c = get_free_closure();
+	if(!c) {
+		return chk_error_no_memory;
+	}
 	c->data = ud;
 	c->func = func;
-	chk_list_pushback(&loop->closures,(chk_list_entry*)c);
+	chk_mpsc_queue_push(&loop->closures,&c->entry);
+	/*
+	* 在loop线程中投递的closure会在本次循环结束前被处理,无需唤醒.
+	* 其它线程投递时,只有第一个把notified置1的线程需要唤醒loop,
+	* loop在读取唤醒事件后先清除notified再处理closure
+	*/
+	if(loop->threadid != chk_thread_current_tid() && 0 == chk_atomic_exchange(&loop->notified,1)) {
+		chk_loop_wakeup(loop);
+	}
 	return 0;
 }
 
+void chk_loop_interest_stats(chk_event_loop *e,uint64_t *requested,uint64_t *flushed) {
+	if(requested) *requested = e->interest_requested;
+	if(flushed) *flushed = e->interest_flushed;
+}
+
+int32_t chk_loop_enable_stats(chk_event_loop *e,int8_t on) {
+	if(!on) {
+		chk_stats_finalize(e);
+		return chk_error_ok;
+	}
+	if(!e->stats) {
+		e->stats = calloc(1,sizeof(*e->stats));
+		if(!e->stats) {
+			CHK_SYSLOG(LOG_ERROR,"calloc chk_loop_stats failed");
+			return chk_error_no_memory;
+		}
+		chk_tsc_ns_per_tick();//校准放在开启时,不影响循环
+	} else {
+		memset(e->stats,0,sizeof(*e->stats));
+	}
+	e->stats->slowest_fd = -1;
+	return chk_error_ok;
+}
+
+int32_t chk_loop_set_busy_poll(chk_event_loop *e,uint32_t us) {
+	if(us) {
+		chk_tsc_ns_per_tick();
+	}
+	e->busy_poll_us = us;
+	e->busy_poll_window = us;
+	return chk_error_ok;
+}
+
+int32_t chk_loop_set_watchdog(chk_event_loop *e,uint32_t ms) {
+	if(e->threadid != chk_thread_current_tid()) {
+		CHK_SYSLOG(LOG_ERROR,"e->threadid != chk_thread_current_tid()");
+		return chk_error_not_loop_thread;
+	}
+	if(!ms) {
+		chk_watchdog_finalize(e);
+		return chk_error_ok;
+	}
+	if(e->probe) {
+		e->probe->threshold = ms;
+		return chk_error_ok;
+	}
+	if(NULL == (e->probe = chk_watchdog_register(ms))) {
+		CHK_SYSLOG(LOG_ERROR,"chk_watchdog_register() failed");
+		return chk_error_no_memory;
+	}
+	return chk_error_ok;
+}
+
+uint64_t chk_loop_stall_count(chk_event_loop *e) {
+	return e->probe ? chk_atomic_load_acquire(&e->probe->stalls) : 0;
+}
+
+int32_t chk_loop_get_stats(chk_event_loop *e,chk_loop_stats *stats) {
+	if(!e->stats) {
+		return chk_error_loop_stats_disable;
+	}
+	*stats = *e->stats;
+	return chk_error_ok;
+}
+
+uint64_t chk_loop_stats_bucket(uint32_t idx) {
+	if(idx < 4) {
+		return idx;
+	}
+	if(idx >= CHK_LOOP_LAG_BUCKETS) {
+		idx = CHK_LOOP_LAG_BUCKETS - 1;
+	}
+	return (uint64_t)(4 | (idx & 3)) << ((idx >> 2) - 1);
+}
+
+static uint64_t histogram_percentile(const uint64_t *hist,double p) {
+	uint32_t i;
+	uint64_t total = 0,count = 0;
+	for(i = 0; i < CHK_LOOP_LAG_BUCKETS; ++i) {
+		total += hist[i];
+	}
+	if(total == 0) {
+		return 0;
+	}
+	for(i = 0; i < CHK_LOOP_LAG_BUCKETS; ++i) {
+		count += hist[i];
+		if((double)count * 100 >= p * (double)total) {
+			break;
+		}
+	}
+	return i + 1 < CHK_LOOP_LAG_BUCKETS ? chk_loop_stats_bucket(i + 1) : chk_loop_stats_bucket(i);
+}
+
+uint64_t chk_loop_stats_lag_percentile(const chk_loop_stats *stats,double p) {
+	return histogram_percentile(stats->lag,p);
+}
+
+uint64_t chk_loop_stats_gc_percentile(const chk_loop_stats *stats,double p) {
+	return histogram_percentile(stats->gc_pause,p);
+}
+
+int32_t chk_loop_yield_handle(chk_handle *h,int32_t events) {
+	chk_event_loop *e = h->loop;
+	if(!e) {
+		return chk_error_no_event_loop;
+	}
+	if(h->ready_entry.next) {
+		//已经在就绪(或让出)列表中,合并事件即可
+		h->active_evetns |= events;
+	} else {
+		h->active_evetns = events;
+		chk_dlist_pushback(&e->yield,&h->ready_entry);
+	}
+	return chk_error_ok;
+}
+
+int32_t chk_loop_defer_flush(chk_handle *h) {
+	chk_event_loop *e = h->loop;
+	if(!e) {
+		return chk_error_no_event_loop;
+	}
+	if(!h->flush_entry.next) {
+		chk_dlist_pushback(&e->flush,&h->flush_entry);
+	}
+	return chk_error_ok;
+}
+
+int32_t chk_loop_set_priority(chk_handle *h,int8_t priority) {
+	if(priority < 0 || priority >= CHK_PRIORITY_COUNT) {
+		return chk_error_invaild_argument;
+	}
+	h->priority = priority;
+	return chk_error_ok;
+}
+
+int32_t chk_loop_set_budget(chk_event_loop *e,const chk_loop_budget *budget) {
+	if(!budget) {
+		return chk_error_invaild_argument;
+	}
+	if(budget->io_us || budget->timer_us || budget->closure_us) {
+		chk_tsc_ns_per_tick();
+	}
+	e->budget = *budget;
+	return chk_error_ok;
+}
+
+void chk_loop_get_budget(chk_event_loop *e,chk_loop_budget *budget) {
+	*budget = e->budget;
+}
+
 int32_t chk_loop_run_once(chk_event_loop *e,uint32_t ms) {
 	return _loop_run(e,ms,1);
 }
@@ -106,13 +842,13 @@ int32_t chk_loop_add_handle(chk_event_loop *e,chk_handle *h,chk_event_callback c
 }
 
 void chk_loop_end(chk_event_loop *e) {
-	TEMP_FAILURE_RETRY(write(e->notifyfds[1],&stopevent,sizeof(stopevent)));
+	chk_atomic_exchange(&e->stop,1);
+	chk_loop_wakeup(e);
 }
 
 chk_event_loop *chk_loop_new() {
 	chk_event_loop *ep = calloc(1,sizeof(*ep));
 	if(!ep) return NULL;
-	chk_list_init(&ep->closures);
 	if(chk_error_ok != chk_loop_init(ep)) {
 		CHK_SYSLOG(LOG_ERROR,"chk_loop_init() failed");
 		free(ep);
@@ -131,7 +867,7 @@ void chk_loop_del(chk_event_loop *e) {
 	else {
 		chk_loop_finalize(e);
 		chk_clouser *c;
-		while((c = (chk_clouser*)chk_list_pop(&e->closures))) {
+		while((c = chk_pop_closure(e))) {
 			c->func(c->data);
 			chk_destroy_closure(c);
 		}		
@@ -152,7 +888,7 @@ static int32_t on_idle_timer_timeout(uint64_t tick,chk_ud ud) {
 	chk_event_loop *loop = (chk_event_loop*)ud.v.val;
 
 #ifdef CHUCK_LUA
-	if(!loop->idle.on_idle.L)
+	if(!loop->idle.on_idle.L && !loop->idle.gc)
 #else
 	if(!loop->idle.on_idle)
 #endif
@@ -193,6 +929,55 @@ int32_t chk_loop_set_idle_func_lua(chk_event_loop *loop,chk_luaRef idle_cb) {
 	return 0;
 }
 
+int32_t chk_loop_set_lua_gc(chk_event_loop *loop,lua_State *L,const chk_loop_lua_gc *gc) {
+	_lua_gc *g;
+	if(!loop || (gc && !L)) {
+		return chk_error_invaild_argument;
+	}
+
+	if(!gc) {
+		if(loop->idle.gc) {
+			chk_lua_gc_free(loop->idle.gc);
+			loop->idle.gc = NULL;
+		}
+		return chk_error_ok;
+	}
+
+	if(!(g = loop->idle.gc) && NULL == (g = calloc(1,sizeof(*g)))) {
+		CHK_SYSLOG(LOG_ERROR,"calloc _lua_gc failed");
+		return chk_error_no_memory;
+	}
+
+	//L可能是协程,GC作用于整个lua_State,保存主线程
+	lua_rawgeti(L,LUA_REGISTRYINDEX,LUA_RIDX_MAINTHREAD);
+	g->L = lua_tothread(L,-1);
+	lua_pop(L,1);
+	g->opt = *gc;
+	if(0 == g->opt.step_kb) {
+		g->opt.step_kb = CHK_LUA_GC_STEP_KB;
+	}
+	if(0 == g->opt.budget_us) {
+		g->opt.budget_us = CHK_LUA_GC_BUDGET_US;
+	}
+
+	if(!loop->idle.idle_timer) {
+		loop->idle.idle_timer = chk_loop_addtimer(loop,CHK_IDLE_TIMER_TIMEOUT,on_idle_timer_timeout,chk_ud_make_void(loop));
+		if(!loop->idle.idle_timer) {
+			if(!loop->idle.gc) {
+				free(g);
+			}
+			return chk_error_add_timer;
+		}
+	}
+
+	if(!loop->idle.gc) {
+		g->base_kb = lua_gc(g->L,LUA_GCCOUNT,0);
+		loop->idle.gc = g;
+	}
+	lua_gc(g->L,LUA_GCSTOP,0);
+	return chk_error_ok;
+}
+
 #else
 
 int32_t chk_loop_set_idle_func(chk_event_loop *loop,void (*idle_cb)()) {
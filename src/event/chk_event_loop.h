@@ -4,14 +4,54 @@
 #include <stdint.h>
 #include "util/chk_timer.h"  
 #include "util/chk_list.h"  
+#include "util/chk_mpsc_queue.h"
 #include "event/chk_event.h"
 #include    "chk_ud.h"
 
+struct chk_closure_pool;
+
 typedef struct {
-    chk_dlist_entry entry;
+    chk_mpsc_node   entry;
     chk_ud          data;
     void (*func)(chk_ud);
+    struct chk_closure_pool *pool;          //分配它的线程的对象池,释放时归还
 }chk_clouser;
+
+#define CHK_LOOP_LAG_BUCKETS 80
+
+/*
+* event_loop运行统计,时间单位为纳秒
+*/
+typedef struct {
+    uint64_t iterations;                    //循环次数
+    uint64_t events;                        //事件等待返回的事件总数
+    uint64_t max_events;                    //单次事件等待返回的最大事件数
+    uint64_t wait_ns;                       //阻塞在事件等待中的时间
+    uint64_t io_ns;                         //handle事件回调的时间
+    uint64_t timer_ns;                      //定时器处理的时间
+    uint64_t closure_ns;                    //closure处理的时间
+    uint64_t slowest_ns;                    //最慢的一次handle回调
+    int32_t  slowest_fd;                    //最慢回调对应的fd
+    uint64_t lag[CHK_LOOP_LAG_BUCKETS];     //loop延迟(一轮循环从唤醒到再次等待的时间)的对数线性直方图
+    uint64_t gc_ns;                         //空闲GC步进的时间
+    uint64_t gc_steps;                      //lua_gc(LUA_GCSTEP)的调用次数
+    uint64_t gc_cycles;                     //完成的回收周期数
+    uint64_t gc_forced;                     //因内存增长超限在非空闲时执行的次数
+    uint64_t gc_pause[CHK_LOOP_LAG_BUCKETS];//每次GC停顿的直方图,桶与lag相同
+}chk_loop_stats;
+
+/*
+* 每轮循环中各阶段的预算,0表示不限制.count为回调次数,us为耗时(微秒),每个回调结束后检查.
+* 预算用完时剩余的工作留到下一轮,下一轮不会阻塞等待
+*/
+typedef struct {
+    uint32_t io_count;
+    uint32_t io_us;
+    uint32_t timer_count;
+    uint32_t timer_us;
+    uint32_t closure_count;                 //默认CHK_LOOP_CLOSURE_BUDGET
+    uint32_t closure_us;
+}chk_loop_budget;
  
 /**
  * 创建一个新的event_loop
@@ -74,9 +114,166 @@ int32_t         chk_loop_add_handle(chk_event_loop *loop,chk_handle *handle,chk_
 
 int32_t         chk_loop_remove_handle(chk_handle *handle);
 
+/**
+ * handle用完本次事件的处理预算时调用,handle被放入loop的让出列表,
+ * 下一轮循环(不等待新事件)以events再次回调on_events.用于边缘触发模式下未处理完的handle
+ * @param handle 已注册到loop的handle
+ * @param events 下一轮需要继续处理的事件
+ */
+
+int32_t         chk_loop_yield_handle(chk_handle *handle,int32_t events);
+
+/**
+ * 请求在本轮循环结束时(等待下一批事件之前)以CHK_EVENT_FLUSH回调handle的on_events,
+ * 同一轮中多次请求只回调一次.用于把一轮循环中产生的输出合并后再提交
+ * @param handle 已注册到loop的handle
+ */
+
+int32_t         chk_loop_defer_flush(chk_handle *handle);
+
+/**
+ * 把注册在loop group共享epoll上的handle固定到当前处理它的loop,之后只在该loop中处理.
+ * 只能在handle自身的事件回调中调用,用于需要和loop绑定的资源(如定时器),对普通handle没有作用
+ * @param handle handle
+ */
+
+int32_t         chk_loop_pin_handle(chk_handle *handle);
+
+enum {
+    CHK_SHARED_ARMED = 1,
+    CHK_SHARED_HELD,
+};
+
+/**
+ * 在共享epoll上的handle的持有者(正在处理它的worker)之外的线程中修改handle之前调用.
+ * 返回0表示handle不是共享的,或者调用线程正持有它,可以直接操作;否则handle已经加锁:
+ * CHK_SHARED_ARMED表示handle在共享epoll上等待事件,CHK_SHARED_HELD表示正被其它worker持有.
+ * 调用者记录要交给worker的操作之后调用chk_loop_shared_handoff
+ * @param handle handle
+ */
+
+int32_t         chk_loop_shared_acquire(chk_handle *handle);
+
+/**
+ * 解锁chk_loop_shared_acquire加锁的handle,并让worker处理交来的操作:handle以加上写事件重新arm,
+ * ARMED时立即arm,HELD时由持有者在处理完之后arm,取到事件的worker在回调中处理
+ * @param handle handle
+ * @param state chk_loop_shared_acquire的返回值
+ */
+
+void            chk_loop_shared_handoff(chk_handle *handle,int32_t state);
+
+/**
+ * 共享handle的状态锁,用于保护与chk_loop_shared_handoff交接的数据,不能在持有时调用其它chk_loop_shared_xxx
+ */
+
+void            chk_loop_shared_lock(chk_handle *handle);
+
+void            chk_loop_shared_unlock(chk_handle *handle);
+
+/**
+ * 设置handle的优先级
+ * @param handle handle
+ * @param priority CHK_PRIORITY_HIGH/CHK_PRIORITY_NORMAL/CHK_PRIORITY_LOW
+ */
+
+int32_t         chk_loop_set_priority(chk_handle *handle,int8_t priority);
+
+/**
+ * 设置每轮循环的预算
+ * @param loop event_loop
+ * @param budget 预算
+ */
+
+int32_t         chk_loop_set_budget(chk_event_loop *loop,const chk_loop_budget *budget);
+
+void            chk_loop_get_budget(chk_event_loop *loop,chk_loop_budget *budget);
+
 
 int32_t         chk_loop_set_idle_func(chk_event_loop *loop,void (*idle_cb)());
 
+/**
+ * 获取关注事件变更的统计,关注事件的变更在每轮循环等待事件前批量提交给内核,
+ * 同一轮中相互抵消的变更不会提交
+ * @param loop event_loop
+ * @param requested 输出,chk_events_enable/chk_events_disable引起的变更次数
+ * @param flushed 输出,实际提交给内核的次数(epoll_ctl/kevent),requested - flushed即节省的系统调用
+ */
+
+void            chk_loop_interest_stats(chk_event_loop *loop,uint64_t *requested,uint64_t *flushed);
+
+/**
+ * 设置busy-poll:等待事件时先以0超时轮询至多us微秒再阻塞,降低唤醒延迟.
+ * 轮询窗口自适应,loop空闲时逐渐缩小,有事件时恢复.us为0时关闭
+ * 注意:轮询期间loop线程占满CPU,只应用于延迟敏感的loop
+ * @param loop event_loop
+ * @param us 最大轮询时间(微秒)
+ */
+
+int32_t         chk_loop_set_busy_poll(chk_event_loop *loop,uint32_t us);
+
+/**
+ * 开启/关闭运行统计,开启时清零已有的统计.统计使用TSC计时,开销很小,可以在生产环境中保持开启
+ * @param loop event_loop
+ * @param on 非0开启
+ */
+
+int32_t         chk_loop_enable_stats(chk_event_loop *loop,int8_t on);
+
+/**
+ * 获取运行统计,没有开启统计时返回chk_error_loop_stats_disable.应在loop所属线程中调用
+ * @param loop event_loop
+ * @param stats 输出
+ */
+
+int32_t         chk_loop_get_stats(chk_event_loop *loop,chk_loop_stats *stats);
+
+/**
+ * 开启watchdog:loop在一个on_events,定时器或closure回调中停留超过ms毫秒时,
+ * 记录回调类型,fd,回调函数,C调用栈(回调来自lua时还有lua调用栈)到系统日志并累加卡顿计数.
+ * 必须在loop所属线程中调用,否则返回chk_error_not_loop_thread
+ * @param loop event_loop
+ * @param ms 阈值(毫秒),0关闭
+ */
+
+int32_t         chk_loop_set_watchdog(chk_event_loop *loop,uint32_t ms);
+
+/**
+ * 返回watchdog检测到的卡顿次数,没有开启watchdog时返回0
+ */
+
+uint64_t        chk_loop_stall_count(chk_event_loop *loop);
+
+/**
+ * 返回lag直方图第idx个桶的下限(微秒).前4个桶宽1微秒,
+ * 之后每个2的幂区间等分为4个桶,最后一个桶包含所有更大的值
+ * @param idx 桶下标
+ */
+
+uint64_t        chk_loop_stats_bucket(uint32_t idx);
+
+/**
+ * 根据lag直方图估算百分位数,返回所在桶的上限(微秒)
+ * @param stats 运行统计
+ * @param p 百分位(0-100)
+ */
+
+uint64_t        chk_loop_stats_lag_percentile(const chk_loop_stats *stats,double p);
+
+/**
+ * 根据GC停顿直方图估算百分位数,返回所在桶的上限(微秒)
+ */
+
+uint64_t        chk_loop_stats_gc_percentile(const chk_loop_stats *stats,double p);
+
+/**
+ * 投递一个closure,func(ud)将在loop所属线程中被调用
+ * 线程安全:可以在任意线程调用,如果loop正阻塞在事件等待中将被唤醒
+ * @param loop event_loop
+ * @param func 回调函数
+ * @param ud 用户传递数据,调用func时回传
+ */
+
 int32_t         chk_loop_post_closure(chk_event_loop *loop,void (*func)(chk_ud),chk_ud ud);
 
 #if CHUCK_LUA
@@ -85,6 +282,25 @@ int32_t         chk_loop_post_closure(chk_event_loop *loop,void (*func)(chk_ud),
 
 int32_t         chk_loop_set_idle_func_lua(chk_event_loop *loop,chk_luaRef idle_cb);
 
+typedef struct {
+    uint32_t step_kb;       //每次lua_gc(LUA_GCSTEP)的步长(KB),0使用CHK_LUA_GC_STEP_KB
+    uint32_t budget_us;     //每次GC的时间上限(微秒),0使用CHK_LUA_GC_BUDGET_US
+    uint32_t force_kb;      //内存比上个回收周期结束时增长超过该值,不空闲也执行一次,0不强制
+}chk_loop_lua_gc;
+
+/**
+ * 空闲GC模式:停止L的自动回收,由loop的idle检测(每CHK_IDLE_TIMER_TIMEOUT毫秒)在空闲时
+ * 执行有时间上限的增量步进,避免完整的回收周期落在流量高峰中.不空闲时只有内存增长超过
+ * force_kb才执行一次步进.GC耗时和停顿分布记录在loop的运行统计中.必须在loop所属线程中调用.
+ * 时间只在两次LUA_GCSTEP之间检查,一次停顿的上限是budget_us加上一次step_kb步进的耗时,
+ * 原子阶段不可分割,存活对象很多时可能超出
+ * @param loop event_loop
+ * @param L lua_State,使用它的主线程
+ * @param gc 参数,NULL恢复自动回收
+ */
+
+int32_t         chk_loop_set_lua_gc(chk_event_loop *loop,lua_State *L,const chk_loop_lua_gc *gc);
+
 #endif
 
 #endif
\ No newline at end of file
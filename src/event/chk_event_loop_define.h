@@ -1,12 +1,24 @@
 #ifdef _CORE_
 
 
+#ifdef CHUCK_LUA
+
+typedef struct _lua_gc {
+	lua_State      *L;
+	chk_loop_lua_gc opt;
+	int32_t         base_kb;     //上个回收周期结束时的内存(KB)
+	int8_t          in_cycle;    //回收周期进行中
+}_lua_gc;
+
+#endif
+
 typedef struct _idle {
 	chk_timer *idle_timer;
 	uint64_t   fire_tick;
 
 #ifdef CHUCK_LUA
 	chk_luaRef  on_idle;	
+	struct _lua_gc *gc;          //NULL表示lua_State自动回收
 #else	
 	void      (*on_idle)();
 #endif
@@ -16,25 +28,66 @@ typedef struct _idle {
 
 #define _chk_loop				 	 \
 	 chk_timermgr  *timermgr;        \
-     int32_t        notifyfds[2];    \
      chk_dlist      handles;         \
-     chk_list       closures;        \
+     chk_dlist      pending;         \
+     chk_dlist      yield;           \
+     chk_dlist      flush;           \
+     uint64_t       interest_requested; \
+     uint64_t       interest_flushed;   \
+     chk_loop_stats *stats;          \
+     struct chk_loop_probe *probe;   \
+     chk_loop_budget budget;         \
+     uint32_t       busy_poll_us;    \
+     uint32_t       busy_poll_window;\
+     chk_mpsc_queue closures;        \
+     int32_t        notified;        \
+     int32_t        stop;            \
      int32_t        status;          \
      pid_t          threadid;		 \
      _idle          idle;         
 
 #ifdef _LINUX
+#include <pthread.h>
+
+	/*
+	* loop group的共享epoll:handle以EPOLLONESHOT注册,每次就绪只会被一个worker取走,
+	* 处理完后由该worker重新arm,同一handle的回调不会并发执行.
+	* 其它线程修改arm中的handle时会重新arm它,可能和已经取出的事件重复,
+	* worker在handle的锁内认领,已经被持有的handle丢弃该事件
+	*/
+	typedef struct chk_shared_epoll {
+		int32_t         epfd;
+		int32_t         refcount;    //引用它的loop数量,最后一个loop销毁时释放
+		pthread_mutex_t mtx;         //保护handles
+		chk_dlist       handles;
+		uint32_t        epoch;       //删除handle时递增
+		int32_t         polling[2];  //按epoch的奇偶计数,正在取事件和认领的worker数
+	}chk_shared_epoll;
+
+	chk_shared_epoll *chk_shared_epoll_new();
+
+	//loop加入共享epoll,必须在loop运行之前调用
+	int32_t chk_loop_join_shared(chk_event_loop *e,chk_shared_epoll *shared);
+
+	//释放一个引用,最后一个引用者通知剩余的handle并关闭共享epoll,e为执行通知的loop
+	void chk_shared_epoll_release(chk_shared_epoll *shared,chk_event_loop *e);
+
+	//arm刚加入共享epoll的handle
+	int32_t chk_loop_shared_arm(chk_handle *h);
+
 	struct chk_event_loop {
 		_chk_loop;
-		int32_t    tfd;
+		int32_t    efd;              //eventfd,用于跨线程唤醒
 		int32_t    epfd;
 		struct     epoll_event* events;
 		int32_t    maxevents;
+		chk_shared_epoll *shared;    //非NULL表示属于共享epoll的loop group
 	};
 #elif _MACH
 
 	struct chk_event_loop{
 		_chk_loop;
+		int32_t notifyfds[2];
 		//int    tfd;		
 		int32_t kfd;
 		struct kevent* events;
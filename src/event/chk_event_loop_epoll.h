@@ -1,6 +1,7 @@
 #ifdef _CORE_
 
-#include <sys/timerfd.h>
+#include <sched.h>
+#include <sys/eventfd.h>
 #include "util/chk_util.h"
 
 #ifndef  cast
@@ -9,6 +10,157 @@
 
 static int32_t events_mod(chk_handle *h,int32_t events);
 
+static inline void chk_loop_wakeup(chk_event_loop *e) {
+	uint64_t one = 1;
+	TEMP_FAILURE_RETRY(write(e->efd,&one,sizeof(one)));
+}
+
+static inline void chk_shared_lock(chk_handle *h) {
+	while(chk_atomic_exchange(&h->shared_lock,1)) {
+		while(chk_atomic_load_acquire(&h->shared_lock));
+	}
+}
+
+static inline void chk_shared_unlock(chk_handle *h) {
+	chk_atomic_store_release(&h->shared_lock,0);
+}
+
+/*
+*  worker从epoll_wait到认领完取出的handle之间处于poll区间,返回区间所属的计数
+*/
+
+static inline int32_t chk_shared_poll_enter(chk_shared_epoll *shared) {
+	uint32_t epoch;
+	for(;;) {
+		epoch = chk_atomic_load_acquire(&shared->epoch);
+		chk_atomic_increase_fetch(&shared->polling[epoch & 1]);
+		if(epoch == chk_atomic_load_acquire(&shared->epoch)) {
+			return epoch & 1;
+		}
+		chh_atomic_decrease_fetch(&shared->polling[epoch & 1]);
+	}
+}
+
+static inline void chk_shared_poll_leave(chk_shared_epoll *shared,int32_t idx) {
+	chh_atomic_decrease_fetch(&shared->polling[idx]);
+}
+
+/*
+*  从共享epoll删除handle之后调用:其它worker可能在删除之前取到了它的重复事件,
+*  等待删除之前开始的poll区间结束,之后不会再有worker访问handle,handle可以被释放
+*/
+
+static void chk_shared_quiesce(chk_shared_epoll *shared) {
+	uint32_t epoch;
+	pthread_mutex_lock(&shared->mtx);
+	epoch = chk_atomic_fetch_increase(&shared->epoch);
+	while(chk_atomic_load_acquire(&shared->polling[epoch & 1])) {
+		sched_yield();
+	}
+	pthread_mutex_unlock(&shared->mtx);
+}
+
+/*
+*  共享handle先以不关注任何事件的EPOLLONESHOT加入共享epoll,处于被持有的状态,
+*  调用者完成初始化之后再由chk_loop_shared_arm开始接收事件
+*/
+
+static int32_t chk_watch_shared(chk_event_loop *e,chk_handle *h,int32_t events) {
+	chk_shared_epoll   *shared = e->shared;
+	struct epoll_event  ev = {0};
+	if(!shared) {
+		CHK_SYSLOG(LOG_ERROR,"event_loop not in shared epoll group");
+		return chk_error_invaild_argument;
+	}
+	ev.data.ptr = h;
+	ev.events = EPOLLONESHOT;
+	if(0 != epoll_ctl(shared->epfd,EPOLL_CTL_ADD,h->fd,&ev)){ 
+		CHK_SYSLOG(LOG_ERROR,"epoll_ctl() failed errno:%d",errno);
+		return chk_error_epoll_add;
+	}
+	h->events = events;
+	h->kernel_events = 0;
+	h->shared_held = 1;
+	h->shared_handoff = 0;
+	h->loop = e;
+	pthread_mutex_lock(&shared->mtx);
+	chk_dlist_pushback(&shared->handles,cast(chk_dlist_entry*,h));
+	pthread_mutex_unlock(&shared->mtx);
+	return chk_error_ok;
+}
+
+/*
+*  在handle的锁内重新arm,有交来的操作时加上写事件,让取到它的worker在回调中处理
+*/
+
+static inline void chk_shared_rearm(chk_handle *h) {
+	struct epoll_event ev = {0};
+	ev.data.ptr = h;
+	ev.events = h->events | EPOLLONESHOT;
+	if(h->shared_handoff) {
+		ev.events |= EPOLLOUT;
+		h->shared_handoff = 0;
+	}
+	h->kernel_events = h->events;
+	if(0 != epoll_ctl(h->loop->shared->epfd,EPOLL_CTL_MOD,h->fd,&ev)){ 
+		CHK_SYSLOG(LOG_ERROR,"epoll_ctl() failed errno:%d",errno);
+	}
+}
+
+/*
+*  持有者处理完之后归还handle,解锁之后handle可能立即被其它worker取走,不能再访问h
+*/
+
+static inline void chk_shared_return(chk_handle *h) {
+	chk_shared_lock(h);
+	h->shared_held = 0;
+	chk_shared_rearm(h);
+	chk_shared_unlock(h);
+}
+
+int32_t chk_loop_shared_arm(chk_handle *h) {
+	if(!h->shared || !h->loop) {
+		return chk_error_invaild_argument;
+	}
+	chk_shared_return(h);
+	return chk_error_ok;
+}
+
+int32_t chk_loop_shared_acquire(chk_handle *h) {
+	if(!h->shared) {
+		return 0;
+	}
+	chk_shared_lock(h);
+	if(!h->shared) {
+		chk_shared_unlock(h);
+		return 0;
+	}
+	if(!h->shared_held) {
+		return CHK_SHARED_ARMED;
+	}
+	if(h->loop->threadid == chk_thread_current_tid()) {
+		chk_shared_unlock(h);
+		return 0;
+	}
+	return CHK_SHARED_HELD;
+}
+
+void chk_loop_shared_handoff(chk_handle *h,int32_t state) {
+	h->shared_handoff = 1;
+	if(state == CHK_SHARED_ARMED) {
+		chk_shared_rearm(h);
+	}
+	chk_shared_unlock(h);
+}
+
+void chk_loop_shared_lock(chk_handle *h) {
+	chk_shared_lock(h);
+}
+
+void chk_loop_shared_unlock(chk_handle *h) {
+	chk_shared_unlock(h);
+}
+
 int32_t chk_watch_handle(chk_event_loop *e,chk_handle *h,int32_t events) {
 	struct epoll_event ev = {0};
 	ev.data.ptr = h;
@@ -16,11 +168,15 @@ int32_t chk_watch_handle(chk_event_loop *e,chk_handle *h,int32_t events) {
 	if(h->loop) {
 		return chk_error_duplicate_add_handle;
 	}
+	if(h->shared) {
+		return chk_watch_shared(e,h,events);
+	}
 	if(0 != epoll_ctl(e->epfd,EPOLL_CTL_ADD,h->fd,&ev)){ 
 		CHK_SYSLOG(LOG_ERROR,"epoll_ctl() failed errno:%d",errno);
 		return chk_error_epoll_add;
 	}
 	h->events = events;
+	h->kernel_events = events;
 	h->loop = e;
 	chk_dlist_pushback(&e->handles,cast(chk_dlist_entry*,h));
 	return chk_error_ok;
@@ -33,40 +189,259 @@ int32_t chk_unwatch_handle(chk_handle *h) {
 	if(!e) {
 		return chk_error_no_event_loop;
 	}
-	if(0 != epoll_ctl(e->epfd,EPOLL_CTL_DEL,h->fd,&ev)){ 
+	if(0 != epoll_ctl(h->shared ? e->shared->epfd : e->epfd,EPOLL_CTL_DEL,h->fd,&ev)){ 
 		CHK_SYSLOG(LOG_ERROR,"epoll_ctl() failed errno:%d",errno);
 		return chk_error_epoll_del; 
 	}
+	if(h->shared) {
+		pthread_mutex_lock(&e->shared->mtx);
+		chk_dlist_remove(&h->entry);
+		pthread_mutex_unlock(&e->shared->mtx);
+		chk_shared_lock(h);
+		h->shared = 0;
+		h->shared_held = 0;
+		chk_shared_unlock(h);
+		chk_shared_quiesce(e->shared);
+	}
 	h->events = 0;
+	h->kernel_events = 0;
 	h->loop = NULL;
+	chk_dlist_remove(&h->pending_entry);
+	chk_dlist_remove(&h->flush_entry);
 	chk_dlist_remove(&h->ready_entry);
 	chk_dlist_remove(&h->entry);
 	return chk_error_ok;	
 }
 
+/*
+*  关注事件的变更只记录在handle上,在下一次epoll_wait之前由chk_flush_interest统一提交,
+*  同一轮循环中先打开又关闭(或反之)的变更不会产生epoll_ctl调用
+*/
+
 int32_t events_mod(chk_handle *h,int32_t events) {
 	chk_event_loop *e = h->loop;	
-	struct epoll_event ev = {0};
 	if(!e) {
 		CHK_SYSLOG(LOG_DEBUG,"NULL == h->loop");
 		return chk_error_no_event_loop;
 	}
-	ev.data.ptr = h;
-	ev.events = events;
-	if(0 != epoll_ctl(e->epfd,EPOLL_CTL_MOD,h->fd,&ev)){ 
-		CHK_SYSLOG(LOG_ERROR,"epoll_ctl() failed errno:%d",errno);
-		return chk_error_epoll_mod; 
+	if(h->events == events) {
+		return chk_error_ok;
+	}
+	h->events = events;
+	++e->interest_requested;
+	if(h->kernel_events == events) {
+		chk_dlist_remove(&h->pending_entry);
+	} else if(!h->pending_entry.next) {
+		chk_dlist_pushback(&e->pending,&h->pending_entry);
 	}
-	h->events = events;		
 	return chk_error_ok;	
 }
 
+/*
+*  共享handle的关注事件可能在任何线程中修改,在锁内计算:被持有时只记录,
+*  由持有者归还时提交;在共享epoll上等待事件时直接重新arm
+*/
+
+static int32_t shared_events_mod(chk_handle *h,int32_t enable,int32_t disable) {
+	int32_t events;
+	if(!h->loop) {
+		CHK_SYSLOG(LOG_DEBUG,"NULL == h->loop");
+		return chk_error_no_event_loop;
+	}
+	chk_shared_lock(h);
+	events = (h->events | enable) & (~disable);
+	if(h->events != events) {
+		h->events = events;
+		if(!h->shared_held) {
+			chk_shared_rearm(h);
+		}
+	}
+	chk_shared_unlock(h);
+	return chk_error_ok;
+}
+
+#define PENDING_TO_HANDLE(ENTRY)                                            \
+    (chk_handle*)(((char*)(ENTRY))-offsetof(chk_handle,pending_entry))
+
+static void chk_flush_interest(chk_event_loop *e) {
+	chk_dlist_entry    *entry;
+	chk_handle         *h;
+	chk_dlist           yielded;
+	struct epoll_event  ev = {0};
+	chk_dlist_init(&yielded);
+	while((entry = chk_dlist_pop(&e->pending))) {
+		h = PENDING_TO_HANDLE(entry);
+		if(h->shared) {
+			if(h->ready_entry.next) {
+				//还在让出列表中,处理完之后才能重新arm
+				chk_dlist_pushback(&yielded,entry);
+			} else {
+				chk_shared_return(h);
+			}
+			continue;
+		}
+		if(h->events == h->kernel_events) {
+			continue;
+		}
+		ev.data.ptr = h;
+		ev.events = h->events;
+		++e->interest_flushed;
+		if(0 != epoll_ctl(e->epfd,EPOLL_CTL_MOD,h->fd,&ev)){ 
+			CHK_SYSLOG(LOG_ERROR,"epoll_ctl() failed errno:%d",errno);
+			continue;
+		}
+		h->kernel_events = h->events;
+	}
+	while((entry = chk_dlist_pop(&yielded))) {
+		chk_dlist_pushback(&e->pending,entry);
+	}
+}
+
+/*
+*  从共享epoll取出一批就绪的handle在本loop中处理,
+*  EPOLLONESHOT保证在重新arm之前不会被其它worker取走
+*/
+
+static void chk_shared_poll(chk_event_loop *e,chk_dlist *ready_list) {
+	struct epoll_event events[CHK_SHARED_EPOLL_BATCH];
+	chk_handle        *h;
+	int32_t            i,nfds,idx;
+	idx = chk_shared_poll_enter(e->shared);
+	nfds = TEMP_FAILURE_RETRY(epoll_wait(e->shared->epfd,events,CHK_SHARED_EPOLL_BATCH,0));
+	for(i = 0; i < nfds; ++i) {
+		h = cast(chk_handle*,events[i].data.ptr);
+		chk_shared_lock(h);
+		if(h->shared_held || !h->shared) {
+			//重复的事件,持有者归还时重新arm,仍然就绪的事件会再次报告
+			chk_shared_unlock(h);
+			continue;
+		}
+		h->shared_held = 1;
+		h->loop = e;
+		chk_shared_unlock(h);
+		h->kernel_events = 0;
+		chk_dlist_pushback(&e->pending,&h->pending_entry);
+		chk_ready_handle(ready_list,h,events[i].events);
+	}
+	chk_shared_poll_leave(e->shared,idx);
+}
+
+chk_shared_epoll *chk_shared_epoll_new() {
+	chk_shared_epoll *shared = calloc(1,sizeof(*shared));
+	if(!shared) {
+		CHK_SYSLOG(LOG_ERROR,"calloc chk_shared_epoll failed");
+		return NULL;
+	}
+	if(0 > (shared->epfd = epoll_create1(EPOLL_CLOEXEC))) {
+		CHK_SYSLOG(LOG_ERROR,"epoll_create1() failed,errno:%d",errno);
+		free(shared);
+		return NULL;
+	}
+	shared->refcount = 1;
+	pthread_mutex_init(&shared->mtx,NULL);
+	chk_dlist_init(&shared->handles);
+	return shared;
+}
+
+void chk_shared_epoll_release(chk_shared_epoll *shared,chk_event_loop *e) {
+	chk_handle *h;
+	if(0 != chh_atomic_decrease_fetch(&shared->refcount)) {
+		return;
+	}
+	//最后一个引用者,通知仍在共享epoll上的handle
+	pthread_mutex_lock(&shared->mtx);
+	while((h = cast(chk_handle*,chk_dlist_pop(&shared->handles)))) {
+		pthread_mutex_unlock(&shared->mtx);
+		h->loop = e;
+		h->on_events(h,CHK_EVENT_LOOPCLOSE);
+		chk_unwatch_handle(h);
+		pthread_mutex_lock(&shared->mtx);
+	}
+	pthread_mutex_unlock(&shared->mtx);
+	close(shared->epfd);
+	pthread_mutex_destroy(&shared->mtx);
+	free(shared);
+}
+
+int32_t chk_loop_join_shared(chk_event_loop *e,chk_shared_epoll *shared) {
+	struct epoll_event ev = {0};
+	if(e->shared) {
+		return chk_error_invaild_argument;
+	}
+	ev.data.fd = shared->epfd;
+	ev.events = EPOLLIN;
+	if(0 != epoll_ctl(e->epfd,EPOLL_CTL_ADD,ev.data.fd,&ev)) {
+		CHK_SYSLOG(LOG_ERROR,"epoll_ctl() failed errno:%d",errno);
+		return chk_error_epoll_add;
+	}
+	e->shared = shared;
+	chk_atomic_increase_fetch(&shared->refcount);
+	return chk_error_ok;
+}
+
+/*
+*  loop销毁时归还持有的共享handle,让其它worker继续处理
+*/
+
+static void chk_shared_leave(chk_event_loop *e) {
+	if(!e->shared) {
+		return;
+	}
+	while(chk_dlist_pop(&e->yield));
+	chk_flush_interest(e);
+	chk_shared_epoll_release(e->shared,e);
+	e->shared = NULL;
+}
+
+int32_t chk_loop_pin_handle(chk_handle *h) {
+	struct epoll_event ev = {0};
+	chk_event_loop *e = h->loop;
+	if(!e) {
+		return chk_error_no_event_loop;
+	}
+	if(!h->shared) {
+		return chk_error_ok;
+	}
+	//在handle自身的回调中,handle已经被本loop取出,不会再被其它worker取走
+	if(0 != epoll_ctl(e->shared->epfd,EPOLL_CTL_DEL,h->fd,&ev)){ 
+		CHK_SYSLOG(LOG_ERROR,"epoll_ctl() failed errno:%d",errno);
+		return chk_error_epoll_del;
+	}
+	pthread_mutex_lock(&e->shared->mtx);
+	chk_dlist_remove(&h->entry);
+	pthread_mutex_unlock(&e->shared->mtx);
+	chk_shared_lock(h);
+	h->shared = 0;
+	h->shared_held = 0;
+	chk_shared_unlock(h);
+	chk_shared_quiesce(e->shared);
+	chk_dlist_remove(&h->pending_entry);
+	ev.data.ptr = h;
+	ev.events = h->events;
+	if(0 != epoll_ctl(e->epfd,EPOLL_CTL_ADD,h->fd,&ev)){ 
+		CHK_SYSLOG(LOG_ERROR,"epoll_ctl() failed errno:%d",errno);
+		h->events = 0;
+		h->kernel_events = 0;
+		h->loop = NULL;
+		chk_dlist_remove(&h->ready_entry);
+		return chk_error_epoll_add;
+	}
+	h->kernel_events = h->events;
+	chk_dlist_pushback(&e->handles,cast(chk_dlist_entry*,h));
+	return chk_error_ok;
+}
 
 int32_t chk_events_enable(chk_handle *h,int32_t events) {
+	if(h->shared) {
+		return shared_events_mod(h,events,0);
+	}
 	return events_mod(h,h->events | events);
 }
 
 int32_t chk_events_disable(chk_handle *h,int32_t events) {
+	if(h->shared) {
+		return shared_events_mod(h,0,events);
+	}
 	return events_mod(h,h->events & (~events));
 }
 
@@ -88,126 +463,143 @@ int32_t chk_loop_init(chk_event_loop *e) {
 		return chk_error_create_epoll;
 	}
 
-	if(chk_error_ok != chk_create_notify_channel(e->notifyfds)) {
-		CHK_SYSLOG(LOG_ERROR,"chk_create_notify_channel() failed");
+	e->efd = eventfd(0,EFD_NONBLOCK|EFD_CLOEXEC);
+	if(e->efd < 0) {
+		CHK_SYSLOG(LOG_ERROR,"eventfd() failed,errno:%d",errno);
 		close(epfd);
 		return chk_error_create_notify_channel;		
 	}		
 	e->epfd = epfd;
 	e->idle.fire_tick = 0;
-	e->tfd  = -1;
 	e->maxevents = 64;
 	e->events = calloc(1,(sizeof(*e->events)*e->maxevents));
 	if(!e->events) {
 		CHK_SYSLOG(LOG_ERROR,"create e->events failed,no memory");		
 		close(epfd);
-		chk_close_notify_channel(e->notifyfds);
+		close(e->efd);
 		return chk_error_no_memory;		
 	}
 	e->timermgr = NULL;
-	ev.data.fd = e->notifyfds[0];
+	e->shared = NULL;
+	ev.data.fd = e->efd;
 	ev.events = EPOLLIN;
 	if(0 != epoll_ctl(e->epfd,EPOLL_CTL_ADD,ev.data.fd,&ev)) {
 		CHK_SYSLOG(LOG_ERROR,"epoll_ctl() failed errno:%d",errno);
 		close(epfd);
-		chk_close_notify_channel(e->notifyfds);
+		close(e->efd);
 		free(e->events);
 		return chk_error_epoll_add;
 	}
 	e->threadid = chk_thread_current_tid();
 	chk_dlist_init(&e->handles);	
+	chk_dlist_init(&e->pending);
+	chk_dlist_init(&e->yield);
+	chk_dlist_init(&e->flush);
+	chk_mpsc_queue_init(&e->closures);
+	chk_budget_default(e);
 	return chk_error_ok;
 }
 
 void chk_loop_finalize(chk_event_loop *e) {
 	assert(e);
 	chk_handle *h;
-	if(e->tfd >= 0) {
-		close(e->tfd);
+	if(e->timermgr) {
 		chk_timermgr_del(e->timermgr);
+		e->timermgr = NULL;
 	}
 
 	while((h = cast(chk_handle*,chk_dlist_pop(&e->handles)))){
 		h->on_events(h,CHK_EVENT_LOOPCLOSE);
 		chk_unwatch_handle(h);
 	}
-	e->tfd  = -1;
+	chk_shared_leave(e);
 	close(e->epfd);
-	chk_close_notify_channel(e->notifyfds);
+	close(e->efd);
 	free(e->events);
 	chk_idle_finalize(e);
+	chk_stats_finalize(e);
+	chk_watchdog_finalize(e);
 }
 
 int32_t _loop_run(chk_event_loop *e,uint32_t ms,int once) {
 	int32_t ret = chk_error_ok;
-	int32_t i,nfds,ticktimer;
+	int32_t i,nfds,timeout,stop = 0;
 	int64_t _;
-	uint64_t t;
+	uint64_t t,tsc,wake,deadline;
 	chk_handle         *h;
-	chk_dlist           ready_list;
-	chk_dlist_entry    *read_entry;
-	chk_clouser        *c;
+	chk_dlist           ready_list[CHK_PRIORITY_COUNT];
 	struct epoll_event *tmp;	
 	do {
-		ticktimer = 0;
-		chk_dlist_init(&ready_list);
-		if(chk_list_size(&e->closures) > 0) {
-			ms = 0;
+		chk_ready_init(ready_list);
+		//上一轮(或两次run_once之间)请求的flush可能打开写监听,先于关注事件的提交
+		chk_run_flush(e);
+		chk_flush_interest(e);
+		tsc = chk_stats_tsc(e);
+		timeout = chk_loop_timeout(e,ms,once);
+		nfds = 0;
+		if((deadline = chk_busy_poll_deadline(e,timeout))) {
+			do {
+				nfds = TEMP_FAILURE_RETRY(epoll_wait(e->epfd,e->events,e->maxevents,0));
+			}while(nfds == 0 && chk_tsc() < deadline);
 		}
-		nfds = TEMP_FAILURE_RETRY(epoll_wait(e->epfd,e->events,e->maxevents,once ? ms : -1));
-		t = chk_systick64();
-		if(nfds > 0) {
-			e->status |= INLOOP;
-			for(i=0; i < nfds ; ++i) {
-				struct epoll_event *event = &e->events[i];
-				if(event->data.fd == e->notifyfds[0]) {
-					int32_t _;
-					while(TEMP_FAILURE_RETRY(read(e->notifyfds[0],&_,sizeof(_))) > 0);
-					goto loopend;	
-				}else if(event->data.fd == e->tfd) {
-					TEMP_FAILURE_RETRY(read(e->tfd,&_,sizeof(_))); 
-					ticktimer = 1;//优先处理其它事件,定时器事件最后处理
-				}else {
-					h = cast(chk_handle*,event->data.ptr);
-					h->active_evetns = event->events;
-					chk_dlist_pushback(&ready_list,&h->ready_entry);
-				}
-			}
-			while((read_entry = chk_dlist_pop(&ready_list))) {
-				h = READY_TO_HANDLE(read_entry);
-				h->on_events(h,h->active_evetns);
-				//这里之后不能访问h,因为h在on_events中可能被释放
-			}
-			if(ticktimer) chk_timer_tick(e->timermgr,chk_accurate_tick64());
-			e->status ^= INLOOP;
-			if(e->status & CLOSING) break;
-			if(nfds == e->maxevents){
-				e->maxevents <<= 2;
-				tmp = realloc(e->events,sizeof(*e->events)*e->maxevents);
-				if(NULL == tmp) {
-					CHK_SYSLOG(LOG_ERROR,"realloc() failed");
-					ret = chk_error_no_memory;
-					break;
-				}
-				e->events = tmp;
-			}				
-		}else if(nfds < 0) {
+		if(nfds == 0) {
+			nfds = TEMP_FAILURE_RETRY(epoll_wait(e->epfd,e->events,e->maxevents,timeout));
+		}
+		if(deadline) {
+			chk_busy_poll_adapt(e,deadline,nfds);
+		}
+		if(nfds < 0) {
 			CHK_SYSLOG(LOG_ERROR,"epoll_wait() failed errno:%d",errno);
 			ret = chk_error_loop_run;
 			break;
 		}
-		int cc = 0;
-		while((c = (chk_clouser*)chk_list_pop(&e->closures))) {
-			c->func(c->data);
-			chk_destroy_closure(c);
-			if(++cc > 1024) {
+		chk_stats_wakeup(e,&tsc,nfds);
+		wake = tsc;
+		t = chk_systick64();
+		e->status |= INLOOP;
+		chk_take_yield(e,ready_list);
+		for(i=0; i < nfds ; ++i) {
+			struct epoll_event *event = &e->events[i];
+			if(event->data.fd == e->efd) {
+				TEMP_FAILURE_RETRY(read(e->efd,&_,sizeof(_)));
+				//先清除notified,之后投递的closure会再次唤醒loop
+				chk_atomic_exchange(&e->notified,0);
+				stop = chk_atomic_exchange(&e->stop,0);
+			}else if(e->shared && event->data.fd == e->shared->epfd) {
+				chk_shared_poll(e,ready_list);
+			}else {
+				h = cast(chk_handle*,event->data.ptr);
+				chk_ready_handle(ready_list,h,event->events);
+			}
+		}
+		chk_dispatch_ready(e,ready_list);
+		chk_stats_phase(e,tsc,io_ns);
+		//优先处理其它事件,定时器事件最后处理
+		chk_run_timer(e);
+		chk_stats_phase(e,tsc,timer_ns);
+		e->status ^= INLOOP;
+		if(e->status & CLOSING) break;
+		if(stop) break;
+		if(nfds == e->maxevents){
+			e->maxevents <<= 2;
+			tmp = realloc(e->events,sizeof(*e->events)*e->maxevents);
+			if(NULL == tmp) {
+				CHK_SYSLOG(LOG_ERROR,"realloc() failed");
+				ret = chk_error_no_memory;
 				break;
 			}
-		}		
+			e->events = tmp;
+		}				
+		chk_run_closures(e);
+		chk_stats_phase(e,tsc,closure_ns);
+		chk_stats_lag(e,wake);		
 		chk_check_idle(e,chk_systick64() - t);	
 	}while(!once);
 
-loopend:	
+	if(!(e->status & CLOSING)) {
+		chk_run_flush(e);
+	}
+
 	if(e->status & CLOSING) {
 		chk_loop_finalize(e);
 	}	
@@ -215,45 +607,14 @@ loopend:
 }
 
 chk_timer *chk_loop_addtimer(chk_event_loop *e,uint32_t timeout,chk_timeout_cb cb,chk_ud ud) {
-	struct   itimerspec spec;
-    uint64_t tick;
-	struct   epoll_event ev = {0};   
-	if(e->tfd < 0) {
-    	e->tfd = timerfd_create(CLOCK_MONOTONIC,TFD_CLOEXEC|TFD_NONBLOCK);
-	    if(e->tfd < 0) {
-	    	CHK_SYSLOG(LOG_ERROR,"timerfd_create failed errno:%d",errno);
-	    	return NULL;
-	    }
-    	spec.it_value.tv_sec = 0;
-        spec.it_value.tv_nsec = 1*1000*1000;
-        spec.it_interval.tv_sec = 0;
-        spec.it_interval.tv_nsec = 1*1000*1000;  
-	    
-	    if(0 != timerfd_settime(e->tfd,0,&spec,0)) {
-	    	CHK_SYSLOG(LOG_ERROR,"timerfd_settime failed errno:%d",errno);
-	        close(e->tfd);
-	        e->tfd = -1;
-	        return NULL;		
-		}
-		ev.data.fd = e->tfd;
-		ev.events  = EPOLLIN;
-		if(0 != epoll_ctl(e->epfd,EPOLL_CTL_ADD,e->tfd,&ev)) {
-			CHK_SYSLOG(LOG_ERROR,"epoll_ctl failed errno:%d",errno);			
-	        close(e->tfd);
-	        e->tfd = -1;
-	        return NULL;				
-		}
+	if(!e->timermgr) {
 		e->timermgr = chk_timermgr_new();
-
 		if(!e->timermgr) {
-			CHK_SYSLOG(LOG_ERROR,"call chk_timermgr_new() failed");			
-	        close(e->tfd);
-	        e->tfd = -1;			
+			CHK_SYSLOG(LOG_ERROR,"call chk_timermgr_new() failed");
 			return NULL;
 		}
 	}
-	tick = chk_accurate_tick64();
-	return chk_timer_register(e->timermgr,timeout,cb,ud,tick); 
+	return chk_timer_register(e->timermgr,timeout,cb,ud,chk_accurate_tick64()); 
 }
 
 #endif
@@ -6,10 +6,15 @@
 # define  cast(T,P) ((T)(P))
 #endif
 
+static inline void chk_loop_wakeup(chk_event_loop *e) {
+	int32_t one = 1;
+	TEMP_FAILURE_RETRY(write(e->notifyfds[1],&one,sizeof(one)));
+}
+
 
 static int32_t _add_event(chk_event_loop *e,chk_handle *h,int32_t event) {
 	struct kevent ke;
-	EV_SET(&ke, h->fd, event, EV_ADD, 0, 0, h);
+	EV_SET(&ke, h->fd, event, (h->events & CHK_EVENT_ET) ? EV_ADD | EV_CLEAR : EV_ADD, 0, 0, h);
 	if(0 != kevent(e->kfd, &ke, 1, NULL, 0, NULL)){
 		CHK_SYSLOG(LOG_ERROR,"kevent() failed errno:%d",errno);
 		return chk_error_kevent_add;
@@ -19,6 +24,8 @@ static int32_t _add_event(chk_event_loop *e,chk_handle *h,int32_t event) {
 
 static int32_t _enable_event(chk_event_loop *e,chk_handle *h,int32_t event) {
 	struct kevent ke;
+	++e->interest_requested;
+	++e->interest_flushed;
 	EV_SET(&ke, h->fd, event,EV_ENABLE, 0, 0, h);
 	if(0 != kevent(e->kfd, &ke, 1, NULL, 0, NULL)) {
 		if(ENOENT == errno) {
@@ -34,6 +41,8 @@ static int32_t _enable_event(chk_event_loop *e,chk_handle *h,int32_t event) {
 
 static int32_t _disable_event(chk_event_loop *e,chk_handle *h,int32_t event) {
 	struct kevent ke;
+	++e->interest_requested;
+	++e->interest_flushed;
 	EV_SET(&ke, h->fd, event,EV_DISABLE, 0, 0, h);
 	if(0 != kevent(e->kfd, &ke, 1, NULL, 0, NULL)){
 		CHK_SYSLOG(LOG_ERROR,"kevent() failed errno:%d",errno);
@@ -49,9 +58,11 @@ int32_t chk_watch_handle(chk_event_loop *e,chk_handle *h,int32_t events) {
 	if(h->loop) {
 		return chk_error_duplicate_add_handle;
 	}
+	h->events = events;//_add_event根据CHK_EVENT_ET决定是否设置EV_CLEAR
 	if(events & CHK_EVENT_READ) {
 		if((ret = _add_event(e,h,EVFILT_READ)) != chk_error_ok){
 			CHK_SYSLOG(LOG_ERROR,"_add_event() failed");
+			h->events = 0;
 			return chk_error_kevent_add;
 		}
 	}
@@ -60,10 +71,10 @@ int32_t chk_watch_handle(chk_event_loop *e,chk_handle *h,int32_t events) {
 			CHK_SYSLOG(LOG_ERROR,"_add_event() failed");
 			EV_SET(&ke, h->fd, EVFILT_READ, EV_DELETE, 0, 0, NULL);
 			kevent(e->kfd, &ke, 1, NULL, 0, NULL);		
+			h->events = 0;
 			return chk_error_kevent_add;
 		}
 	}
-	h->events = events;
 	h->loop = e;
 	chk_dlist_pushback(&e->handles,cast(chk_dlist_entry*,h));
 	return chk_error_ok;	
@@ -81,6 +92,7 @@ int32_t chk_unwatch_handle(chk_handle *h) {
 	kevent(e->kfd, &ke, 1, NULL, 0, NULL);
 	h->events = 0;
 	h->loop = NULL;
+	chk_dlist_remove(&h->flush_entry);
 	chk_dlist_remove(&h->ready_entry);
 	chk_dlist_remove(&h->entry);
 	return chk_error_ok;	
@@ -138,6 +150,24 @@ int32_t chk_is_write_enable(chk_handle*h) {
 	return (h->events & CHK_EVENT_WRITE) > 0 ? 1:0;
 }
 
+//kqueue后端没有共享模式,handle总是属于注册它的loop
+int32_t chk_loop_pin_handle(chk_handle *h) {
+	return h->loop ? chk_error_ok : chk_error_no_event_loop;
+}
+
+int32_t chk_loop_shared_acquire(chk_handle *h) {
+	return 0;
+}
+
+void chk_loop_shared_handoff(chk_handle *h,int32_t state) {
+}
+
+void chk_loop_shared_lock(chk_handle *h) {
+}
+
+void chk_loop_shared_unlock(chk_handle *h) {
+}
+
 extern int32_t easy_noblock(int32_t fd,int32_t noblock); 
 
 int32_t chk_loop_init(chk_event_loop *e) {
@@ -176,6 +206,11 @@ int32_t chk_loop_init(chk_event_loop *e) {
 	}
 	e->threadid = chk_thread_current_tid();
 	chk_dlist_init(&e->handles);			
+	chk_dlist_init(&e->pending);
+	chk_dlist_init(&e->yield);
+	chk_dlist_init(&e->flush);
+	chk_mpsc_queue_init(&e->closures);
+	chk_budget_default(e);
 	return chk_error_ok;
 }
 
@@ -191,97 +226,96 @@ void chk_loop_finalize(chk_event_loop *e) {
 	chk_close_notify_channel(e->notifyfds);
 	free(e->events);
 	chk_idle_finalize(e);
+	chk_stats_finalize(e);
+	chk_watchdog_finalize(e);
 }
 
 int32_t _loop_run(chk_event_loop *e,uint32_t ms,int once) {
 	int32_t ret = chk_error_ok;
-	int32_t i,nfds,ticktimer;
+	int32_t i,nfds,timeout,stop = 0;
 	chk_handle      *h;
-	chk_dlist        ready_list;
-	chk_dlist_entry *read_entry;
+	chk_dlist        ready_list[CHK_PRIORITY_COUNT];
 	struct timespec ts,*pts;
-	uint64_t msec,t;
-	chk_clouser     *c;	
+	uint64_t t,tsc,wake,deadline;
 	struct kevent   *tmp;
 	do {
-		ticktimer = 0;
-		chk_dlist_init(&ready_list);
-		if(once || chk_list_size(&e->closures) > 0){
-			if(chk_list_size(&e->closures) > 0) {
-				ts.tv_nsec = 0;
-				ts.tv_sec  = 0;				
-			} else {			
-				msec = ms%1000;
-				ts.tv_nsec = (msec*1000*1000);
-				ts.tv_sec   = (ms/1000);
-			}
+		chk_ready_init(ready_list);
+		chk_run_flush(e);
+		timeout = chk_loop_timeout(e,ms,once);
+		if(timeout >= 0){
+			ts.tv_nsec = (timeout%1000)*1000*1000;
+			ts.tv_sec  = timeout/1000;
 			pts = &ts;
 		}
 		else {
 			pts = NULL;
 		}
 
-		nfds = TEMP_FAILURE_RETRY(kevent(e->kfd, NULL, 0, e->events,e->maxevents,pts));
-		t = chk_systick64();
-		if(nfds > 0) {
-			e->status |= INLOOP;
-			for(i=0; i < nfds ; ++i) {
-				struct kevent *event = &e->events[i];
-				if(event->udata == (void*)(int64_t)e->notifyfds[0]) {
-					int32_t _;
-					while(TEMP_FAILURE_RETRY(read(e->notifyfds[0],&_,sizeof(_))) > 0);
-					goto loopend;	
-				}else if(event->udata == e->timermgr){
-					ticktimer = 1;//优先处理其它事件,定时器事件最后处理
-				}
-				else {
-					h = cast(chk_handle*,event->udata);
-					h->active_evetns = 0;
-					if(event->filter == EVFILT_READ){
-						h->active_evetns |= CHK_EVENT_READ;
-					}
-
-					if(event->filter == EVFILT_WRITE){
-						h->active_evetns |= CHK_EVENT_WRITE;
-					}
-
-					chk_dlist_pushback(&ready_list,&h->ready_entry);
-				}
-			}
-			while((read_entry = chk_dlist_pop(&ready_list))) {
-				h = READY_TO_HANDLE(read_entry);
-				h->on_events(h,h->active_evetns);
-				//这里之后不能访问h,因为h在on_events中可能被释放
-			}			
-			if(ticktimer) chk_timer_tick(e->timermgr,chk_accurate_tick64());
-			e->status ^= INLOOP;
-			if(e->status & CLOSING) break;
-			if(nfds == e->maxevents){
-				e->maxevents <<= 2;
-				tmp = realloc(e->events,sizeof(*e->events)*e->maxevents);
-				if(NULL == tmp) {
-					CHK_SYSLOG(LOG_ERROR,"realloc() failed");
-					ret = chk_error_no_memory;
-					break;
-				}
-				e->events = tmp;
-			}				
-		}else if(nfds < 0) {
+		tsc = chk_stats_tsc(e);
+		nfds = 0;
+		if((deadline = chk_busy_poll_deadline(e,timeout))) {
+			struct timespec zero = {0,0};
+			do {
+				nfds = TEMP_FAILURE_RETRY(kevent(e->kfd, NULL, 0, e->events,e->maxevents,&zero));
+			}while(nfds == 0 && chk_tsc() < deadline);
+		}
+		if(nfds == 0) {
+			nfds = TEMP_FAILURE_RETRY(kevent(e->kfd, NULL, 0, e->events,e->maxevents,pts));
+		}
+		if(deadline) {
+			chk_busy_poll_adapt(e,deadline,nfds);
+		}
+		if(nfds < 0) {
 			CHK_SYSLOG(LOG_ERROR,"kevent() failed errno:%d",errno);
 			ret = chk_error_loop_run;
 			break;
 		}
-		int cc = 0;
-		while((c = (chk_clouser*)chk_list_pop(&e->closures))) {
-			c->func(c->data);
-			chk_destroy_closure(c);
-			if(++cc > 1024) {
+		chk_stats_wakeup(e,&tsc,nfds);
+		wake = tsc;
+		t = chk_systick64();
+		e->status |= INLOOP;
+		chk_take_yield(e,ready_list);
+		for(i=0; i < nfds ; ++i) {
+			struct kevent *event = &e->events[i];
+			if(event->udata == (void*)(int64_t)e->notifyfds[0]) {
+				int32_t _;
+				while(TEMP_FAILURE_RETRY(read(e->notifyfds[0],&_,sizeof(_))) > 0);
+				//先清除notified,之后投递的closure会再次唤醒loop
+				chk_atomic_exchange(&e->notified,0);
+				stop = chk_atomic_exchange(&e->stop,0);
+			}
+			else {
+				h = cast(chk_handle*,event->udata);
+				//同一fd的读写事件分别返回,由chk_ready_handle合并
+				chk_ready_handle(ready_list,h,event->filter == EVFILT_READ ? CHK_EVENT_READ : CHK_EVENT_WRITE);
+			}
+		}
+		chk_dispatch_ready(e,ready_list);
+		chk_stats_phase(e,tsc,io_ns);			
+		//优先处理其它事件,定时器事件最后处理
+		chk_run_timer(e);
+		chk_stats_phase(e,tsc,timer_ns);
+		e->status ^= INLOOP;
+		if(e->status & CLOSING) break;
+		if(stop) break;
+		if(nfds == e->maxevents){
+			e->maxevents <<= 2;
+			tmp = realloc(e->events,sizeof(*e->events)*e->maxevents);
+			if(NULL == tmp) {
+				CHK_SYSLOG(LOG_ERROR,"realloc() failed");
+				ret = chk_error_no_memory;
 				break;
 			}
-		}		
+			e->events = tmp;
+		}				
+		chk_run_closures(e);
+		chk_stats_phase(e,tsc,closure_ns);
+		chk_stats_lag(e,wake);		
 		chk_check_idle(e,chk_systick64() - t);	
 	}while(!once);	
-loopend:	
+	if(!(e->status & CLOSING)) {
+		chk_run_flush(e);
+	}
 	if(e->status & CLOSING) {
 		chk_loop_finalize(e);
 	}	
@@ -289,29 +323,14 @@ loopend:
 }
 
 chk_timer *chk_loop_addtimer(chk_event_loop *e,uint32_t timeout,chk_timeout_cb cb,chk_ud ud) {
-
-	uint64_t tick;
-	int32_t  flags =  EV_ADD | EV_ENABLE;
-	struct kevent change;
 	if(!e->timermgr){
 		e->timermgr = chk_timermgr_new();
 		if(!e->timermgr) {
 			CHK_SYSLOG(LOG_ERROR,"call chk_timermgr_new() failed");
 			return NULL;
 		}
-		EV_SET(&change, 1, EVFILT_TIMER,flags, NOTE_USECONDS, 1000, e->timermgr);
-		struct timespec thetime;
-  		bzero(&thetime,sizeof(thetime));
-  		if(-1 == kevent(e->kfd, &change,1, NULL , 0, &thetime)){
-  			CHK_SYSLOG(LOG_ERROR,"kevent timer failed");
-  			chk_timermgr_del(e->timermgr);
-  			e->timermgr = NULL;
-  			return NULL;
-  		}
-
 	}
-	tick = chk_accurate_tick64();
-	return chk_timer_register(e->timermgr,timeout,cb,ud,tick); 
+	return chk_timer_register(e->timermgr,timeout,cb,ud,chk_accurate_tick64()); 
 }
 
 
@@ -0,0 +1,436 @@
+#define _CORE_
+#include <assert.h>
+#include "thread/chk_thread.h"
+#include "util/chk_log.h"
+#include "util/chk_error.h"
+#include "event/chk_loop_group.h"
+#include "event/chk_event_loop_define.h"
+#include "socket/chk_stream_socket.h"
+
+#ifndef  cast
+# define  cast(T,P) ((T)(P))
+#endif
+
+typedef struct {
+	chk_loop_group *group;
+	chk_event_loop *loop;
+	chk_thread     *thread;
+	uint32_t        idx;
+}loop_slot;
+
+struct chk_loop_group {
+	uint32_t          size;
+	loop_slot        *slots;
+	chk_acceptor    **acceptors;
+	uint32_t          acceptor_count;
+	chk_loop_group_cb on_start;
+	chk_loop_group_cb on_stop;
+	chk_ud            ud;
+	int32_t          *cpus;      //每个loop绑定的cpu,NULL表示不绑定
+	uint64_t         *busy;      //上次rebalance时每个loop的忙碌时间
+	chk_mutex         mtx;       //保护slot->loop,loop线程退出时将其置空
+	int8_t            running;
+	int8_t            shared;    //所有loop共享一个epoll
+};
+
+static void *loop_routine(void *arg) {
+	loop_slot      *slot = cast(loop_slot*,arg);
+	chk_loop_group *g    = slot->group;
+	chk_event_loop *loop = slot->loop;
+
+	//loop由运行它的线程负责销毁
+	loop->threadid = chk_thread_current_tid();
+
+	if(g->on_start) {
+		g->on_start(g,loop,slot->idx,g->ud);
+	}
+
+	chk_loop_run(loop);
+
+	chk_mutex_lock(&g->mtx);
+	slot->loop = NULL;
+	chk_mutex_unlock(&g->mtx);
+
+	chk_loop_del(loop);
+
+	if(g->on_stop) {
+		g->on_stop(g,NULL,slot->idx,g->ud);
+	}
+	return NULL;
+}
+
+chk_loop_group *chk_loop_group_new(uint32_t size) {
+	uint32_t        i;
+	chk_loop_group *g;
+	if(0 == size) {
+		CHK_SYSLOG(LOG_ERROR,"size == 0");
+		return NULL;
+	}
+
+	g = calloc(1,sizeof(*g));
+	if(!g) {
+		CHK_SYSLOG(LOG_ERROR,"calloc chk_loop_group failed");
+		return NULL;
+	}
+
+	g->slots = calloc(size,sizeof(*g->slots));
+	if(!g->slots) {
+		CHK_SYSLOG(LOG_ERROR,"calloc loop_slot failed");
+		free(g);
+		return NULL;
+	}
+
+	chk_mutex_init(&g->mtx);
+	g->size = size;
+	for(i = 0; i < size; ++i) {
+		g->slots[i].group = g;
+		g->slots[i].idx   = i;
+		if(NULL == (g->slots[i].loop = chk_loop_new())) {
+			CHK_SYSLOG(LOG_ERROR,"chk_loop_new() failed");
+			chk_loop_group_del(g);
+			return NULL;
+		}
+	}
+	return g;
+}
+
+chk_loop_group *chk_loop_group_new_shared(uint32_t size) {
+#ifdef _LINUX
+	uint32_t          i;
+	chk_loop_group   *g;
+	chk_shared_epoll *shared;
+	if(NULL == (g = chk_loop_group_new(size))) {
+		return NULL;
+	}
+
+	if(NULL == (shared = chk_shared_epoll_new())) {
+		CHK_SYSLOG(LOG_ERROR,"chk_shared_epoll_new() failed");
+		chk_loop_group_del(g);
+		return NULL;
+	}
+
+	for(i = 0; i < size; ++i) {
+		if(chk_error_ok != chk_loop_join_shared(g->slots[i].loop,shared)) {
+			CHK_SYSLOG(LOG_ERROR,"chk_loop_join_shared() failed");
+			break;
+		}
+	}
+	g->shared = 1;
+	//之后共享epoll由loop持有,最后一个销毁的loop负责释放
+	chk_shared_epoll_release(shared,NULL);
+	if(i < size) {
+		chk_loop_group_del(g);
+		return NULL;
+	}
+	return g;
+#else
+	CHK_SYSLOG(LOG_ERROR,"shared epoll loop group only supported on linux");
+	return NULL;
+#endif
+}
+
+int32_t chk_loop_group_add_handle(chk_loop_group *g,chk_handle *h,chk_event_callback cb) {
+	int32_t  ret = chk_error_no_event_loop;
+#ifdef _LINUX
+	uint32_t i;
+	if(NULL == g || NULL == h) {
+		CHK_SYSLOG(LOG_ERROR,"NULL == g || NULL == h");
+		return chk_error_invaild_argument;
+	}
+
+	if(!g->shared) {
+		CHK_SYSLOG(LOG_ERROR,"chk_loop_group not shared");
+		return chk_error_invaild_argument;
+	}
+
+	chk_mutex_lock(&g->mtx);
+	for(i = 0; i < g->size; ++i) {
+		//任何一个loop都可以,handle就绪时由取到它的worker处理
+		if(g->slots[i].loop) {
+			h->shared = 1;
+			if(chk_error_ok == (ret = chk_loop_add_handle(g->slots[i].loop,h,cb))) {
+				ret = chk_loop_shared_arm(h);
+			} else {
+				h->shared = 0;
+			}
+			break;
+		}
+	}
+	chk_mutex_unlock(&g->mtx);
+#endif
+	return ret;
+}
+
+int32_t chk_loop_group_bind_cpus(chk_loop_group *g,const int32_t *cpus,uint32_t count) {
+	uint32_t i;
+	if(NULL == g || NULL == cpus || 0 == count) {
+		CHK_SYSLOG(LOG_ERROR,"NULL == g || NULL == cpus || 0 == count");
+		return chk_error_invaild_argument;
+	}
+
+	if(g->running || g->acceptor_count) {
+		CHK_SYSLOG(LOG_ERROR,"chk_loop_group already started or listening");
+		return chk_error_common;
+	}
+
+	if(!g->cpus && NULL == (g->cpus = calloc(g->size,sizeof(*g->cpus)))) {
+		CHK_SYSLOG(LOG_ERROR,"calloc() failed");
+		return chk_error_no_memory;
+	}
+
+	for(i = 0; i < g->size; ++i) {
+		g->cpus[i] = cpus[i % count];
+	}
+	return chk_error_ok;
+}
+
+/*
+*  让连接由接收它的cpu上的loop处理:优先在reuseport组上挂cBPF程序,
+*  内核不支持时退回到在每个监听套接字上设置SO_INCOMING_CPU
+*/
+
+static void steer_by_cpu(chk_loop_group *g,chk_acceptor **acceptors) {
+	uint32_t i;
+	if(chk_error_ok == easy_reuseport_cpu_steer(chk_acceptor_get_fd(acceptors[0]),g->cpus,g->size)) {
+		return;
+	}
+	for(i = 0; i < g->size; ++i) {
+		easy_set_incoming_cpu(chk_acceptor_get_fd(acceptors[i]),g->cpus[i]);
+	}
+}
+
+int32_t chk_loop_group_listen(chk_loop_group *g,chk_sockaddr *addr,chk_acceptor_cb cb,chk_ud ud) {
+	uint32_t       i;
+	chk_acceptor **tmp;
+	if(NULL == g || NULL == addr || NULL == cb) {
+		CHK_SYSLOG(LOG_ERROR,"NULL == g || NULL == addr || NULL == cb");
+		return chk_error_invaild_argument;
+	}
+
+	if(g->running) {
+		CHK_SYSLOG(LOG_ERROR,"chk_loop_group already started");
+		return chk_error_common;
+	}
+
+	tmp = realloc(g->acceptors,sizeof(*g->acceptors)*(g->acceptor_count + g->size));
+	if(!tmp) {
+		CHK_SYSLOG(LOG_ERROR,"realloc() failed");
+		return chk_error_no_memory;
+	}
+	g->acceptors = tmp;
+
+	for(i = 0; i < g->size; ++i) {
+		chk_acceptor *a = chk_listen_reuseport(g->slots[i].loop,addr,cb,ud);
+		if(!a) {
+			CHK_SYSLOG(LOG_ERROR,"chk_listen_reuseport() failed");
+			//撤销本次调用已建立的acceptor
+			while(i > 0) {
+				chk_acceptor_del(g->acceptors[g->acceptor_count + (--i)]);
+			}
+			return chk_error_listen;
+		}
+		g->acceptors[g->acceptor_count + i] = a;
+	}
+	if(g->cpus) {
+		steer_by_cpu(g,g->acceptors + g->acceptor_count);
+	}
+	g->acceptor_count += g->size;
+	return chk_error_ok;
+}
+
+int32_t chk_loop_group_start(chk_loop_group *g,chk_loop_group_cb on_start,chk_loop_group_cb on_stop,chk_ud ud) {
+	uint32_t i;
+	if(NULL == g) {
+		return chk_error_invaild_argument;
+	}
+
+	if(g->running) {
+		CHK_SYSLOG(LOG_ERROR,"chk_loop_group already started");
+		return chk_error_common;
+	}
+
+	g->on_start = on_start;
+	g->on_stop  = on_stop;
+	g->ud       = ud;
+	g->running  = 1;
+
+	for(i = 0; i < g->size; ++i) {
+		if(NULL == (g->slots[i].thread = chk_thread_new_on(loop_routine,&g->slots[i],g->cpus ? g->cpus[i] : -1))) {
+			CHK_SYSLOG(LOG_ERROR,"chk_thread_new() failed");
+			chk_loop_group_stop(g);
+			return chk_error_common;
+		}
+	}
+	return chk_error_ok;
+}
+
+void chk_loop_group_stop(chk_loop_group *g) {
+	uint32_t i;
+	if(!g || !g->running) {
+		return;
+	}
+
+	chk_mutex_lock(&g->mtx);
+	for(i = 0; i < g->size; ++i) {
+		if(g->slots[i].thread && g->slots[i].loop) {
+			chk_loop_end(g->slots[i].loop);
+		}
+	}
+	chk_mutex_unlock(&g->mtx);
+
+	for(i = 0; i < g->size; ++i) {
+		if(g->slots[i].thread) {
+			chk_thread_join(g->slots[i].thread);
+			chk_thread_del(g->slots[i].thread);
+			g->slots[i].thread = NULL;
+		}
+	}
+	g->running = 0;
+}
+
+void chk_loop_group_del(chk_loop_group *g) {
+	uint32_t i;
+	if(!g) {
+		return;
+	}
+
+	chk_loop_group_stop(g);
+
+	for(i = 0; i < g->size; ++i) {
+		//没有启动过的loop
+		if(g->slots[i].loop) {
+			chk_loop_del(g->slots[i].loop);
+			g->slots[i].loop = NULL;
+		}
+	}
+
+	for(i = 0; i < g->acceptor_count; ++i) {
+		chk_acceptor_del(g->acceptors[i]);
+	}
+
+	chk_mutex_uninit(&g->mtx);
+	free(g->cpus);
+	free(g->busy);
+	free(g->acceptors);
+	free(g->slots);
+	free(g);
+}
+
+uint32_t chk_loop_group_size(chk_loop_group *g) {
+	return g ? g->size : 0;
+}
+
+chk_event_loop *chk_loop_group_get(chk_loop_group *g,uint32_t idx) {
+	chk_event_loop *loop;
+	if(!g || idx >= g->size) {
+		return NULL;
+	}
+	chk_mutex_lock(&g->mtx);
+	loop = g->slots[idx].loop;
+	chk_mutex_unlock(&g->mtx);
+	return loop;
+}
+
+typedef struct {
+	chk_loop_group *group;
+	chk_event_loop *from;
+	uint32_t        to;
+	double          fraction;
+	uint32_t        max_moves;
+}rebalance_req;
+
+/*
+*  在from的线程中执行,group在from的线程退出之前不会被释放.
+*  目标loop可能已经退出并销毁,持有mtx取目标loop并完成投递,
+*  目标线程在mtx上等待置空slot->loop,投递完成之前不会销毁loop
+*/
+
+static void on_rebalance(chk_ud ud) {
+	rebalance_req  *req = cast(rebalance_req*,ud.v.val);
+	chk_loop_group *g   = req->group;
+	chk_event_loop *to;
+	int32_t         moved = 0;
+	chk_mutex_lock(&g->mtx);
+	if((to = g->slots[req->to].loop)) {
+		moved = chk_stream_socket_rebalance(req->from,to,req->fraction,req->max_moves);
+	}
+	chk_mutex_unlock(&g->mtx);
+	if(moved > 0) {
+		CHK_SYSLOG(LOG_INFO,"rebalance moved %d connections",moved);
+	}
+	free(req);
+}
+
+int32_t chk_loop_group_rebalance(chk_loop_group *g,uint32_t max_moves) {
+	uint32_t        i,hot = 0,cool = 0;
+	uint64_t        busy,*delta;
+	int32_t         ret = chk_error_ok;
+	rebalance_req  *req;
+	chk_event_loop *loop;
+	if(NULL == g || 0 == max_moves) {
+		return chk_error_invaild_argument;
+	}
+
+	if(g->shared || g->size < 2) {
+		return chk_error_ok;
+	}
+
+	if(NULL == (delta = calloc(g->size,sizeof(*delta)))) {
+		return chk_error_no_memory;
+	}
+
+	chk_mutex_lock(&g->mtx);
+
+	if(!g->busy && NULL == (g->busy = calloc(g->size,sizeof(*g->busy)))) {
+		ret = chk_error_no_memory;
+		goto end;
+	}
+
+	for(i = 0; i < g->size; ++i) {
+		if(NULL == (loop = g->slots[i].loop)) {
+			ret = chk_error_no_event_loop;
+			goto end;
+		}
+		if(NULL == loop->stats) {
+			ret = chk_error_loop_stats_disable;
+			goto end;
+		}
+	}
+
+	//统计值只增不减,在其它线程中读取得到的是近似值
+	for(i = 0; i < g->size; ++i) {
+		loop = g->slots[i].loop;
+		busy = loop->stats->io_ns + loop->stats->timer_ns + loop->stats->closure_ns;
+		delta[i] = busy - g->busy[i];
+		g->busy[i] = busy;
+		if(delta[i] > delta[hot]) {
+			hot = i;
+		}
+		if(delta[i] < delta[cool]) {
+			cool = i;
+		}
+	}
+
+	//相差不到25%不做调整
+	if(hot == cool || delta[hot] * 4 <= delta[cool] * 5) {
+		goto end;
+	}
+
+	if(NULL == (req = calloc(1,sizeof(*req)))) {
+		ret = chk_error_no_memory;
+		goto end;
+	}
+	//迁出两者差值的一半
+	req->group     = g;
+	req->from      = g->slots[hot].loop;
+	req->to        = cool;
+	req->fraction  = (double)(delta[hot] - delta[cool]) / (2.0 * delta[hot]);
+	req->max_moves = max_moves;
+	if(chk_error_ok != (ret = chk_loop_post_closure(g->slots[hot].loop,on_rebalance,chk_ud_make_void(req)))) {
+		free(req);
+	}
+end:
+	chk_mutex_unlock(&g->mtx);
+	free(delta);
+	return ret;
+}
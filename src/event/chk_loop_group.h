@@ -0,0 +1,117 @@
+#ifndef _CHK_LOOP_GROUP_H
+#define _CHK_LOOP_GROUP_H
+
+/*
+* 一组event_loop,每个loop运行在独立的chk_thread上
+* 通过SO_REUSEPORT在每个loop上建立监听同一地址的acceptor,新连接由内核分配,
+* 被哪个loop接受的连接就留在哪个loop上处理
+*
+* 共享模式(chk_loop_group_new_shared,仅linux epoll后端):所有loop共享一个epoll,
+* handle以EPOLLONESHOT注册,就绪的handle由空闲的worker取走,处理完后重新arm.
+* 单个连接负载偏重时不会拖住同一loop上的其它连接.同一handle的回调不会并发执行,
+* 但先后可能在不同的线程中执行.stream_socket的发送和关注事件的变更可以在任何线程中进行
+* (定时器,closure,其它socket的回调),不在持有它的worker中的发送交由取到它事件的worker排入;
+* 关闭等其它操作只能在自身的回调中进行,需要定时器等与loop绑定的资源时先调用chk_loop_pin_handle
+*/
+
+#include <stdint.h>
+#include "event/chk_event_loop.h"
+#include "socket/chk_acceptor.h"
+#include "chk_ud.h"
+
+typedef struct chk_loop_group chk_loop_group;
+
+//在loop所属线程中调用,idx为loop在group中的下标
+typedef void (*chk_loop_group_cb)(chk_loop_group*,chk_event_loop*,uint32_t idx,chk_ud ud);
+
+/**
+ * 创建包含size个event_loop的group
+ * @param size loop数量
+ */
+
+chk_loop_group *chk_loop_group_new(uint32_t size);
+
+/**
+ * 创建共享epoll模式的group,只在linux下支持,其它平台返回NULL
+ * @param size worker数量
+ */
+
+chk_loop_group *chk_loop_group_new_shared(uint32_t size);
+
+/**
+ * 把handle注册到共享模式group的共享epoll上,可以在任何线程中调用
+ * @param g 共享模式的group
+ * @param h handle
+ * @param cb 事件回调函数,在取到handle的worker线程中被调用
+ */
+
+int32_t chk_loop_group_add_handle(chk_loop_group *g,chk_handle *h,chk_event_callback cb);
+
+/**
+ * 把每个loop线程绑定到cpu上,loop的分配优先来自cpu所在的NUMA节点.
+ * 之后建立的acceptor把连接交给接收它的cpu上的loop,减少跨核的缓存失效
+ * (同一cpu上有多个loop时,该cpu上接收的连接只交给其中第一个).
+ * 必须在chk_loop_group_listen和chk_loop_group_start之前调用
+ * @param g group
+ * @param cpus cpu列表,第i个loop绑定到cpus[i % count]
+ * @param count cpus的数量
+ */
+
+int32_t chk_loop_group_bind_cpus(chk_loop_group *g,const int32_t *cpus,uint32_t count);
+
+/**
+ * 在group的每个loop上建立一个SO_REUSEPORT acceptor,必须在chk_loop_group_start之前调用
+ * cb在接受连接的loop所属线程中被调用,可通过chk_acceptor_get_loop获取该loop
+ * @param g group
+ * @param addr 监听地址
+ * @param cb 事件回调函数
+ * @param ud 用户传递数据,调用cb时传回
+ */
+
+int32_t chk_loop_group_listen(chk_loop_group *g,chk_sockaddr *addr,chk_acceptor_cb cb,chk_ud ud);
+
+/**
+ * 为每个loop创建线程并开始运行
+ * @param g group
+ * @param on_start 如果非空,在loop开始运行前于loop所属线程中调用
+ * @param on_stop 如果非空,在loop销毁之后于loop所属线程中调用
+ * @param ud 用户传递数据,调用on_start/on_stop时传回
+ */
+
+int32_t chk_loop_group_start(chk_loop_group *g,chk_loop_group_cb on_start,chk_loop_group_cb on_stop,chk_ud ud);
+
+/**
+ * 终止所有loop并等待线程结束,loop在各自线程中被销毁
+ * @param g group
+ */
+
+void chk_loop_group_stop(chk_loop_group *g);
+
+/**
+ * 销毁group,如果group仍在运行先调用chk_loop_group_stop
+ * @param g group
+ */
+
+void chk_loop_group_del(chk_loop_group *g);
+
+uint32_t chk_loop_group_size(chk_loop_group *g);
+
+/**
+ * 获取下标为idx的loop,group停止之后返回NULL
+ */
+
+chk_event_loop *chk_loop_group_get(chk_loop_group *g,uint32_t idx);
+
+/**
+ * 根据loop的忙碌时间(回调,定时器,closure的耗时,需要在每个loop上开启统计)做负载再平衡:
+ * 自上次调用以来最忙的loop比最闲的loop忙25%以上时,把最忙loop上读写最多的一部分连接
+ * 迁移到最闲的loop.迁移在最忙loop的线程中异步进行,可以在任何线程中周期性调用.
+ * 迁移的连接之后在目标loop的线程中回调,不适用于共享模式的group.
+ * 只迁移调用过chk_stream_socket_set_migratable的连接,所有者在原loop上的状态需自行迁移
+ * @param g group
+ * @param max_moves 一次最多迁移的连接数
+ */
+
+int32_t chk_loop_group_rebalance(chk_loop_group *g,uint32_t max_moves);
+
+#endif
@@ -0,0 +1,196 @@
+#include <stdlib.h>
+#include <errno.h>
+#include <signal.h>
+#include <pthread.h>
+#include <execinfo.h>
+#include "util/chk_log.h"
+#include "util/chk_time.h"
+#include "util/chk_util.h"
+#include "event/chk_loop_watchdog.h"
+#include "../config.h"
+
+#ifdef CHUCK_LUA
+#include "lua/chk_lua.h"
+#endif
+
+static struct {
+	pthread_mutex_t mtx;
+	pthread_cond_t  cond;
+	chk_dlist       probes;
+	int32_t         started;
+}watchdog = {
+	.mtx  = PTHREAD_MUTEX_INITIALIZER,
+	.cond = PTHREAD_COND_INITIALIZER,
+};
+
+static pthread_once_t watchdog_once = PTHREAD_ONCE_INIT;
+
+//正在请求记录调用栈的探针,同一时刻只有一个
+static chk_loop_probe * volatile capturing = NULL;
+
+static const char *kind_name[] = {"none","io","timer","closure"};
+
+#ifdef CHUCK_LUA
+
+static __thread chk_loop_probe *stall_probe = NULL;
+
+static __thread uint32_t stall_seq = 0;
+
+/*
+*  在loop线程执行下一条lua指令时被调用,如果仍然卡在同一个回调中就记录lua调用栈
+*/
+
+static void stall_hook(lua_State *L,lua_Debug *ar) {
+	chk_loop_probe *p = stall_probe;
+	lua_sethook(L,NULL,0,0);
+	stall_probe = NULL;
+	if(p && p->seq == stall_seq) {
+		luaL_traceback(L,L,NULL,0);
+		CHK_SYSLOG(LOG_ERROR,"loop stall lua %s",lua_tostring(L,-1));
+		lua_pop(L,1);
+	}
+}
+
+#endif
+
+static void on_watchdog_signal(int32_t sig) {
+	int32_t         err = errno;
+	chk_loop_probe *p = capturing;
+	if(p && pthread_equal(p->thread,pthread_self())) {
+		p->bt_seq  = p->seq;
+		p->bt_size = backtrace(p->bt,LOG_STACK_SIZE);
+#ifdef CHUCK_LUA
+		//lua_sethook可以在信号处理函数中安全调用
+		lua_State *L = chk_lua_running();
+		if(L && p->kind != CHK_PROBE_NONE && NULL == lua_gethook(L)) {
+			stall_probe = p;
+			stall_seq   = p->bt_seq;
+			lua_sethook(L,stall_hook,LUA_MASKCOUNT,1);
+		}
+#endif
+		chk_atomic_store_release(&p->bt_ready,1);
+	}
+	errno = err;
+}
+
+static void report(chk_loop_probe *p,uint32_t seq,uint64_t elapse) {
+	char     name[512];
+	int32_t  kind = p->kind;
+	int32_t  fd   = p->fd;
+	void    *func = p->func;
+	uint64_t deadline;
+	if(seq != chk_atomic_load_acquire(&p->seq)) {
+		//读取期间回调已经返回
+		return;
+	}
+	chk_atomic_increase_fetch(&p->stalls);
+	p->bt_ready = 0;
+	capturing = p;
+	if(0 == pthread_kill(p->thread,CHK_WATCHDOG_SIGNAL)) {
+		deadline = chk_systick64() + CHK_WATCHDOG_BT_WAIT;
+		while(!chk_atomic_load_acquire(&p->bt_ready) && chk_systick64() < deadline) {
+			chk_sleepms(1);
+		}
+	}
+	capturing = NULL;
+	if(func) {
+		chk_exp_symbol(func,name,sizeof(name));
+	} else {
+		snprintf(name,sizeof(name),"-");
+	}
+	CHK_SYSLOG(LOG_ERROR,"loop stall:%s callback blocked %llu ms,fd:%d,handler:%s",
+			   kind_name[kind],(unsigned long long)elapse,fd,name);
+	//跳过信号处理函数和信号返回的栈帧
+	if(p->bt_ready && p->bt_seq == seq && p->bt_size > 2) {
+		chk_exp_log_stack(LOG_ERROR,"loop stall stack:",p->bt + 2,p->bt_size - 2);
+	}
+}
+
+static void *watchdog_routine(void *arg) {
+	chk_dlist_entry *entry;
+	chk_loop_probe  *p;
+	uint64_t         now;
+	uint32_t         seq,interval;
+	pthread_mutex_lock(&watchdog.mtx);
+	for(;;) {
+		while(chk_dlist_empty(&watchdog.probes)) {
+			pthread_cond_wait(&watchdog.cond,&watchdog.mtx);
+		}
+		interval = (uint32_t)-1;
+		now = chk_systick64();
+		chk_dlist_foreach(&watchdog.probes,entry) {
+			p = cast(chk_loop_probe*,entry);
+			interval = MIN(interval,p->threshold);
+			seq = chk_atomic_load_acquire(&p->seq);
+			if(seq != p->last_seq || p->kind == CHK_PROBE_NONE) {
+				p->last_seq = seq;
+				p->since    = now;
+			} else if(p->reported_seq != seq && now - p->since >= p->threshold) {
+				p->reported_seq = seq;
+				report(p,seq,now - p->since);
+			}
+		}
+		pthread_mutex_unlock(&watchdog.mtx);
+		chk_sleepms(MAX(interval >> 2,1));
+		pthread_mutex_lock(&watchdog.mtx);
+	}
+	return NULL;
+}
+
+static void watchdog_init() {
+	struct sigaction act;
+	pthread_t        tid;
+	void            *bt[1];
+	chk_dlist_init(&watchdog.probes);
+	memset(&act,0,sizeof(act));
+	act.sa_handler = on_watchdog_signal;
+	act.sa_flags   = SA_RESTART;
+	sigemptyset(&act.sa_mask);
+	if(0 != sigaction(CHK_WATCHDOG_SIGNAL,&act,NULL)) {
+		CHK_SYSLOG(LOG_ERROR,"sigaction() failed errno:%d",errno);
+		return;
+	}
+	//backtrace第一次调用时会加载libgcc,不能发生在信号处理函数中
+	backtrace(bt,1);
+	if(0 != pthread_create(&tid,NULL,watchdog_routine,NULL)) {
+		CHK_SYSLOG(LOG_ERROR,"create watchdog thread failed");
+		return;
+	}
+	pthread_detach(tid);
+	watchdog.started = 1;
+}
+
+chk_loop_probe *chk_watchdog_register(uint32_t threshold) {
+	chk_loop_probe *p;
+	pthread_once(&watchdog_once,watchdog_init);
+	if(!watchdog.started) {
+		return NULL;
+	}
+	if(NULL == (p = calloc(1,sizeof(*p)))) {
+		return NULL;
+	}
+	p->thread    = pthread_self();
+	p->threshold = threshold;
+#ifdef CHUCK_LUA
+	//首次访问__thread变量可能分配内存,先在信号处理函数之外访问一次
+	stall_probe = NULL;
+	chk_lua_running();
+#endif
+	pthread_mutex_lock(&watchdog.mtx);
+	chk_dlist_pushback(&watchdog.probes,&p->entry);
+	pthread_cond_signal(&watchdog.cond);
+	pthread_mutex_unlock(&watchdog.mtx);
+	return p;
+}
+
+void chk_watchdog_unregister(chk_loop_probe *p) {
+	pthread_mutex_lock(&watchdog.mtx);
+	chk_dlist_remove(&p->entry);
+	pthread_mutex_unlock(&watchdog.mtx);
+#ifdef CHUCK_LUA
+	if(stall_probe == p) {
+		stall_probe = NULL;
+	}
+#endif
+	free(p);
+}
@@ -0,0 +1,62 @@
+#ifndef _CHK_LOOP_WATCHDOG_H
+#define _CHK_LOOP_WATCHDOG_H
+
+/*
+* loop卡顿检测(内部使用).
+* loop线程在进入/离开on_events,定时器和closure回调时更新探针,所有探针由同一个watchdog线程周期性检查,
+* 探针的seq长时间不变且处于回调中即认为loop被卡住:累加计数,通过信号让loop线程记录调用栈
+* (如果卡在lua中,再通过hook记录lua调用栈),然后写入系统日志
+*/
+
+#include <stdint.h>
+#include <pthread.h>
+#include "util/chk_list.h"
+#include "util/chk_atomic.h"
+#include "util/chk_exception.h"
+
+enum {
+	CHK_PROBE_NONE = 0,
+	CHK_PROBE_IO,
+	CHK_PROBE_TIMER,
+	CHK_PROBE_CLOSURE,
+};
+
+typedef struct chk_loop_probe {
+	chk_dlist_entry   entry;
+	pthread_t         thread;         //loop线程
+	uint32_t          threshold;      //毫秒
+	//loop线程写,watchdog线程读.seq每次进入/离开回调时加1
+	volatile uint32_t seq;
+	volatile int32_t  kind;
+	volatile int32_t  fd;
+	void * volatile   func;           //回调函数地址,io回调记录的是handle的on_events
+	uint64_t          stalls;
+	//以下字段只在watchdog线程中访问
+	uint32_t          last_seq;
+	uint64_t          since;
+	uint32_t          reported_seq;
+	//由loop线程的信号处理函数填写
+	volatile int32_t  bt_ready;
+	uint32_t          bt_seq;
+	int32_t           bt_size;
+	void             *bt[LOG_STACK_SIZE];
+}chk_loop_probe;
+
+//在loop线程中调用
+chk_loop_probe *chk_watchdog_register(uint32_t threshold);
+
+void            chk_watchdog_unregister(chk_loop_probe *p);
+
+static inline void chk_probe_enter(chk_loop_probe *p,int32_t kind,int32_t fd,void *func) {
+	p->kind = kind;
+	p->fd   = fd;
+	p->func = func;
+	chk_atomic_store_release(&p->seq,p->seq + 1);
+}
+
+static inline void chk_probe_leave(chk_loop_probe *p) {
+	p->kind = CHK_PROBE_NONE;
+	chk_atomic_store_release(&p->seq,p->seq + 1);
+}
+
+#endif
@@ -9,6 +9,12 @@
 
 static __thread char lua_errmsg[4096] = {0};
 
+static __thread lua_State *lua_running = NULL;
+
+lua_State *chk_lua_running() {
+	return lua_running;
+}
+
 static inline int __traceback (lua_State *L) {
   const char *msg = lua_tostring(L, 1);
   if(msg) luaL_traceback(L, L, msg, 1);
@@ -24,7 +30,7 @@ const char *chk_lua_pcall(lua_State *L,const char *fmt,...) {
 	int32_t ret,narg,nres,i,size,base,top;
 	chk_luaToFunctor   *_t;
 	chk_luaPushFunctor *_p;
-	lua_State          *mL;
+	lua_State          *mL,*running;
 	const char         *errmsg = NULL;		
 	lua_rawgeti(L,  LUA_REGISTRYINDEX, LUA_RIDX_MAINTHREAD);
 	mL = lua_tothread(L,-1);
@@ -86,7 +92,10 @@ arg_end:
 	base = lua_gettop(L) - narg;
 	lua_pushcfunction(L, __traceback);
 	lua_insert(L,base);	
+	running = lua_running;
+	lua_running = L;
 	ret = lua_pcall(L,narg,nres,base);
+	lua_running = running;
 	lua_remove(L,base);
 	if(ret){
 		strncpy(lua_errmsg,lua_tostring(L,-1),sizeof(lua_errmsg) - 1);
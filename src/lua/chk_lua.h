@@ -64,6 +64,9 @@ static inline void chk_push_LuaRef(lua_State *L,chk_luaRef ref) {
 */
 const char *chk_lua_pcall(lua_State *L,const char *fmt,...);
 
+//返回当前线程中正在由chk_lua_pcall执行的lua_State,没有返回NULL
+lua_State  *chk_lua_running();
+
 #define chk_Lua_PCall(__L,__FUNC,__FMT, ...)			  		 ({\
 	const char *__result;										   \
 	int __oldtop = lua_gettop(__L);							       \
@@ -6,8 +6,35 @@ void chk_loop_finalize(chk_event_loop *loop);
 
 #define EVENT_LOOP_METATABLE "lua_event_loop"
 
-#define lua_checkeventloop(L,I)	\
-	(chk_event_loop*)luaL_checkudata(L,I,EVENT_LOOP_METATABLE)
+#define EVENT_LOOP_REF_METATABLE "lua_event_loop_ref"
+
+#define LOOP_GROUP_METATABLE "lua_loop_group"
+
+int32_t luaopen_chuck(lua_State *L);
+
+//由loop_group持有的event_loop,lua中只持有其指针
+typedef struct {
+	chk_event_loop *loop;
+}lua_event_loop_ref;
+
+typedef struct {
+	chk_loop_group *group;
+	char           *script;
+	int32_t         argc;
+	char          **argv;
+	lua_State     **states;
+}lua_loop_group;
+
+static inline chk_event_loop *lua_checkeventloop(lua_State *L,int I) {
+	lua_event_loop_ref *ref = (lua_event_loop_ref*)luaL_testudata(L,I,EVENT_LOOP_REF_METATABLE);
+	if(ref) {
+		return ref->loop;
+	}
+	return (chk_event_loop*)luaL_checkudata(L,I,EVENT_LOOP_METATABLE);
+}
+
+#define lua_checkloopgroup(L,I)	\
+	(lua_loop_group*)luaL_checkudata(L,I,LOOP_GROUP_METATABLE)
 
 static int32_t lua_event_loop_gc(lua_State *L) {
 	chk_event_loop *event_loop = lua_checkeventloop(L,1);
@@ -34,6 +61,9 @@ static int32_t lua_new_event_loop(lua_State *L) {
 static int32_t lua_event_loop_run(lua_State *L) {
 	chk_event_loop *event_loop;
 	int32_t         ms,ret;
+	if(luaL_testudata(L,1,EVENT_LOOP_REF_METATABLE)) {
+		return luaL_error(L,"event_loop of loop_group is run by the group");
+	}
 	event_loop = lua_checkeventloop(L,1);
 	ms = (int32_t)luaL_optinteger(L,2,-1);
 	if(ms == -1){
@@ -111,6 +141,163 @@ static int32_t lua_event_loop_set_idle(lua_State *L) {
 	return 0;
 }
 
+static int32_t lua_event_loop_set_busy_poll(lua_State *L) {
+	chk_event_loop *event_loop = lua_checkeventloop(L,1);
+	uint32_t us = (uint32_t)luaL_optinteger(L,2,0);
+	chk_loop_set_busy_poll(event_loop,us);
+	return 0;
+}
+
+static int32_t lua_event_loop_set_watchdog(lua_State *L) {
+	chk_event_loop *event_loop = lua_checkeventloop(L,1);
+	uint32_t ms = (uint32_t)luaL_optinteger(L,2,0);
+	int32_t  ret = chk_loop_set_watchdog(event_loop,ms);
+	if(0 != ret) {
+		lua_pushstring(L,chk_get_errno_str(ret));
+		return 1;
+	}
+	return 0;
+}
+
+static int32_t lua_event_loop_stall_count(lua_State *L) {
+	chk_event_loop *event_loop = lua_checkeventloop(L,1);
+	lua_pushinteger(L,(lua_Integer)chk_loop_stall_count(event_loop));
+	return 1;
+}
+
+static int32_t lua_event_loop_enable_stats(lua_State *L) {
+	chk_event_loop *event_loop = lua_checkeventloop(L,1);
+	int8_t on = lua_isnoneornil(L,2) ? 1 : (int8_t)lua_toboolean(L,2);
+	if(0 != chk_loop_enable_stats(event_loop,on)) {
+		lua_pushstring(L,"enable_stats failed");
+		return 1;
+	}
+	return 0;
+}
+
+#define SET_STATS_FIELD(L,STATS,FIELD) do{\
+	lua_pushinteger(L,(lua_Integer)(STATS).FIELD);\
+	lua_setfield(L,-2,#FIELD);\
+}while(0)
+
+//把直方图的非空桶以{{下限(微秒),次数},...}的形式压栈
+static void push_histogram(lua_State *L,const uint64_t *hist) {
+	uint32_t i;
+	int32_t  n = 0;
+	lua_newtable(L);
+	for(i = 0; i < CHK_LOOP_LAG_BUCKETS; ++i) {
+		if(hist[i]) {
+			lua_newtable(L);
+			lua_pushinteger(L,(lua_Integer)chk_loop_stats_bucket(i));
+			lua_rawseti(L,-2,1);
+			lua_pushinteger(L,(lua_Integer)hist[i]);
+			lua_rawseti(L,-2,2);
+			lua_rawseti(L,-2,++n);
+		}
+	}
+}
+
+/*
+* 返回统计表,没有开启统计时返回nil.
+* lag为非空桶的数组{{下限(微秒),次数},...},lag_p50/lag_p99/lag_p999为对应百分位(微秒),
+* gc_pause/gc_p50/gc_p99为空闲GC模式下GC停顿的分布
+*/
+static int32_t lua_event_loop_get_stats(lua_State *L) {
+	chk_loop_stats  stats;
+	chk_event_loop *event_loop = lua_checkeventloop(L,1);
+	if(0 != chk_loop_get_stats(event_loop,&stats)) {
+		return 0;
+	}
+	lua_newtable(L);
+	SET_STATS_FIELD(L,stats,iterations);
+	SET_STATS_FIELD(L,stats,events);
+	SET_STATS_FIELD(L,stats,max_events);
+	SET_STATS_FIELD(L,stats,wait_ns);
+	SET_STATS_FIELD(L,stats,io_ns);
+	SET_STATS_FIELD(L,stats,timer_ns);
+	SET_STATS_FIELD(L,stats,closure_ns);
+	SET_STATS_FIELD(L,stats,slowest_ns);
+	SET_STATS_FIELD(L,stats,slowest_fd);
+	lua_pushinteger(L,(lua_Integer)chk_loop_stats_lag_percentile(&stats,50));
+	lua_setfield(L,-2,"lag_p50");
+	lua_pushinteger(L,(lua_Integer)chk_loop_stats_lag_percentile(&stats,99));
+	lua_setfield(L,-2,"lag_p99");
+	lua_pushinteger(L,(lua_Integer)chk_loop_stats_lag_percentile(&stats,99.9));
+	lua_setfield(L,-2,"lag_p999");
+	push_histogram(L,stats.lag);
+	lua_setfield(L,-2,"lag");
+	SET_STATS_FIELD(L,stats,gc_ns);
+	SET_STATS_FIELD(L,stats,gc_steps);
+	SET_STATS_FIELD(L,stats,gc_cycles);
+	SET_STATS_FIELD(L,stats,gc_forced);
+	lua_pushinteger(L,(lua_Integer)chk_loop_stats_gc_percentile(&stats,50));
+	lua_setfield(L,-2,"gc_p50");
+	lua_pushinteger(L,(lua_Integer)chk_loop_stats_gc_percentile(&stats,99));
+	lua_setfield(L,-2,"gc_p99");
+	push_histogram(L,stats.gc_pause);
+	lua_setfield(L,-2,"gc_pause");
+	return 1;
+}
+
+#define GET_BUDGET_FIELD(L,IDX,B,F) do{                                    \
+	lua_getfield(L,IDX,#F);                                                 \
+	if(!lua_isnil(L,-1)) (B).F = (uint32_t)luaL_checkinteger(L,-1);         \
+	lua_pop(L,1);                                                           \
+}while(0)
+
+//没有给出的字段保持原值
+static int32_t lua_event_loop_set_budget(lua_State *L) {
+	chk_loop_budget budget;
+	chk_event_loop *event_loop = lua_checkeventloop(L,1);
+	luaL_checktype(L,2,LUA_TTABLE);
+	chk_loop_get_budget(event_loop,&budget);
+	GET_BUDGET_FIELD(L,2,budget,io_count);
+	GET_BUDGET_FIELD(L,2,budget,io_us);
+	GET_BUDGET_FIELD(L,2,budget,timer_count);
+	GET_BUDGET_FIELD(L,2,budget,timer_us);
+	GET_BUDGET_FIELD(L,2,budget,closure_count);
+	GET_BUDGET_FIELD(L,2,budget,closure_us);
+	chk_loop_set_budget(event_loop,&budget);
+	return 0;
+}
+
+/*
+* event_loop:SetLuaGC({step_kb=64,budget_us=1000,force_kb=65536})开启空闲GC模式,
+* 没有给出的字段取默认值,参数为nil时恢复自动回收
+*/
+static int32_t lua_event_loop_set_lua_gc(lua_State *L) {
+	chk_loop_lua_gc gc;
+	chk_event_loop *event_loop = lua_checkeventloop(L,1);
+	if(lua_isnoneornil(L,2)) {
+		chk_loop_set_lua_gc(event_loop,L,NULL);
+		return 0;
+	}
+	luaL_checktype(L,2,LUA_TTABLE);
+	memset(&gc,0,sizeof(gc));
+	GET_BUDGET_FIELD(L,2,gc,step_kb);
+	GET_BUDGET_FIELD(L,2,gc,budget_us);
+	GET_BUDGET_FIELD(L,2,gc,force_kb);
+	if(0 != chk_loop_set_lua_gc(event_loop,L,&gc)) {
+		lua_pushstring(L,"SetLuaGC failed");
+		return 1;
+	}
+	return 0;
+}
+
+static int32_t lua_event_loop_get_budget(lua_State *L) {
+	chk_loop_budget budget;
+	chk_event_loop *event_loop = lua_checkeventloop(L,1);
+	chk_loop_get_budget(event_loop,&budget);
+	lua_newtable(L);
+	SET_STATS_FIELD(L,budget,io_count);
+	SET_STATS_FIELD(L,budget,io_us);
+	SET_STATS_FIELD(L,budget,timer_count);
+	SET_STATS_FIELD(L,budget,timer_us);
+	SET_STATS_FIELD(L,budget,closure_count);
+	SET_STATS_FIELD(L,budget,closure_us);
+	return 1;
+}
+
 static void signal_ud_dctor(chk_ud ud) {
 	chk_luaRef_release(&ud.v.lr);
 }
@@ -163,6 +350,135 @@ static int32_t lua_post_closure(lua_State *L) {
 	return  chk_loop_post_closure(event_loop,call_closure,chk_ud_make_lr(closure));	
 }
 
+static void lua_loop_group_on_start(chk_loop_group *g,chk_event_loop *loop,uint32_t idx,chk_ud ud) {
+	lua_loop_group     *lg = (lua_loop_group*)ud.v.val;
+	lua_event_loop_ref *ref;
+	lua_State          *L;
+	int32_t             i;
+
+	L = luaL_newstate();
+	if(!L) {
+		CHK_SYSLOG(LOG_ERROR,"luaL_newstate() failed");
+		chk_loop_end(loop);
+		return;
+	}
+	lg->states[idx] = L;
+	luaL_openlibs(L);
+	luaL_requiref(L,"chuck",luaopen_chuck,0);
+	lua_pop(L,1);
+
+	if(LUA_OK != luaL_loadfile(L,lg->script)) {
+		CHK_SYSLOG(LOG_ERROR,"load %s failed:%s",lg->script,lua_tostring(L,-1));
+		chk_loop_end(loop);
+		return;
+	}
+
+	ref = LUA_NEWUSERDATA(L,lua_event_loop_ref);
+	ref->loop = loop;
+	luaL_getmetatable(L, EVENT_LOOP_REF_METATABLE);
+	lua_setmetatable(L, -2);
+	lua_pushinteger(L,idx);
+	for(i = 0; i < lg->argc; ++i) {
+		lua_pushstring(L,lg->argv[i]);
+	}
+
+	if(LUA_OK != lua_pcall(L,lg->argc + 2,0,0)) {
+		CHK_SYSLOG(LOG_ERROR,"run %s failed:%s",lg->script,lua_tostring(L,-1));
+		lua_pop(L,1);
+		chk_loop_end(loop);
+	}
+}
+
+static void lua_loop_group_on_stop(chk_loop_group *g,chk_event_loop *_,uint32_t idx,chk_ud ud) {
+	lua_loop_group *lg = (lua_loop_group*)ud.v.val;
+	if(lg->states[idx]) {
+		lua_close(lg->states[idx]);
+		lg->states[idx] = NULL;
+	}
+}
+
+static void lua_loop_group_release(lua_loop_group *lg) {
+	int32_t i;
+	if(lg->group) {
+		chk_loop_group_del(lg->group);
+		lg->group = NULL;
+	}
+	for(i = 0; i < lg->argc; ++i) {
+		free(lg->argv[i]);
+	}
+	free(lg->argv);
+	free(lg->script);
+	free(lg->states);
+	lg->argv   = NULL;
+	lg->script = NULL;
+	lg->states = NULL;
+	lg->argc   = 0;
+}
+
+static int32_t lua_loop_group_gc(lua_State *L) {
+	lua_loop_group_release(lua_checkloopgroup(L,1));
+	return 0;
+}
+
+static int32_t lua_loop_group_size(lua_State *L) {
+	lua_loop_group *lg = lua_checkloopgroup(L,1);
+	lua_pushinteger(L,chk_loop_group_size(lg->group));
+	return 1;
+}
+
+/*
+* event_loop.NewGroup(size,script,...)
+* 启动size个线程,每个线程拥有独立的event_loop和lua_State,并在其中执行script,
+* script的参数为(event_loop,idx,...),script中通过socket.stream.listen(loop,addr,cb,true)
+* 以SO_REUSEPORT方式监听同一地址,script返回后由group驱动event_loop运行
+*/
+
+static int32_t lua_new_loop_group(lua_State *L) {
+	lua_loop_group *lg;
+	int32_t         i;
+	uint32_t        size   = (uint32_t)luaL_checkinteger(L,1);
+	const char     *script = luaL_checkstring(L,2);
+	int32_t         argc   = lua_gettop(L) - 2;
+
+	if(size == 0) {
+		return luaL_error(L,"argument 1 of NewGroup must > 0");
+	}
+
+	lg = LUA_NEWUSERDATA(L,lua_loop_group);
+	if(!lg) {
+		CHK_SYSLOG(LOG_ERROR,"LUA_NEWUSERDATA() failed");
+		return 0;
+	}
+
+	luaL_getmetatable(L, LOOP_GROUP_METATABLE);
+	lua_setmetatable(L, -2);
+
+	lg->script = strdup(script);
+	lg->states = calloc(size,sizeof(*lg->states));
+	lg->argv   = calloc(argc > 0 ? argc : 1,sizeof(*lg->argv));
+	if(!lg->script || !lg->states || !lg->argv) {
+		lua_loop_group_release(lg);
+		return luaL_error(L,"no memory");
+	}
+
+	for(i = 0; i < argc; ++i) {
+		lg->argv[i] = strdup(luaL_checkstring(L,3 + i));
+		lg->argc++;
+	}
+
+	if(NULL == (lg->group = chk_loop_group_new(size))) {
+		lua_loop_group_release(lg);
+		return luaL_error(L,"chk_loop_group_new() failed");
+	}
+
+	if(0 != chk_loop_group_start(lg->group,lua_loop_group_on_start,lua_loop_group_on_stop,chk_ud_make_void(lg))) {
+		lua_loop_group_release(lg);
+		return luaL_error(L,"chk_loop_group_start() failed");
+	}
+
+	return 1;
+}
+
 static void register_event_loop(lua_State *L) {
 	luaL_Reg event_loop_mt[] = {
 		{"__gc", lua_event_loop_gc},
@@ -178,6 +494,25 @@ static void register_event_loop(lua_State *L) {
 		{"AddTimer",     lua_event_loop_addtimer},
 		{"AddTimerOnce", lua_event_loop_oncetimer},
 		{"SetIdle",      lua_event_loop_set_idle},
+		{"SetBusyPoll",  lua_event_loop_set_busy_poll},
+		{"EnableStats",  lua_event_loop_enable_stats},
+		{"GetStats",     lua_event_loop_get_stats},
+		{"SetWatchdog",  lua_event_loop_set_watchdog},
+		{"StallCount",   lua_event_loop_stall_count},
+		{"SetBudget",    lua_event_loop_set_budget},
+		{"GetBudget",    lua_event_loop_get_budget},
+		{"SetLuaGC",     lua_event_loop_set_lua_gc},
+		{NULL,     NULL}
+	};
+
+	luaL_Reg loop_group_mt[] = {
+		{"__gc", lua_loop_group_gc},
+		{NULL, NULL}
+	};
+
+	luaL_Reg loop_group_methods[] = {
+		{"Stop",         lua_loop_group_gc},
+		{"Size",         lua_loop_group_size},
 		{NULL,     NULL}
 	};
 
@@ -188,8 +523,24 @@ static void register_event_loop(lua_State *L) {
 	lua_setfield(L, -2, "__index");
 	lua_pop(L, 1);
 
+	luaL_newmetatable(L, EVENT_LOOP_REF_METATABLE);
+	luaL_newlib(L, event_loop_methods);
+	lua_setfield(L, -2, "__index");
+	lua_pop(L, 1);
+
+	luaL_newmetatable(L, LOOP_GROUP_METATABLE);
+	luaL_setfuncs(L, loop_group_mt, 0);
+
+	luaL_newlib(L, loop_group_methods);
+	lua_setfield(L, -2, "__index");
+	lua_pop(L, 1);
+
 	lua_newtable(L);
 	SET_FUNCTION(L,"New",lua_new_event_loop);
+	SET_FUNCTION(L,"NewGroup",lua_new_loop_group);
+	SET_CONST(L,CHK_PRIORITY_HIGH);
+	SET_CONST(L,CHK_PRIORITY_NORMAL);
+	SET_CONST(L,CHK_PRIORITY_LOW);
 }
 
 
@@ -13,6 +13,8 @@
 
 #define SSL_CTX_METATABLE "lua_ssl_ctx"
 
+#define SOCKET_GROUP_METATABLE "lua_socket_group"
+
 typedef struct {
 	chk_acceptor *c_acceptor;
 }lua_acceptor;
@@ -20,6 +22,7 @@ typedef struct {
 typedef struct {
 	chk_stream_socket *socket;
 	chk_luaRef cb;
+	chk_luaRef water_cb;
 }lua_stream_socket;
 
 typedef struct {
@@ -31,12 +34,19 @@ typedef struct {
 	SSL_CTX *ctx;
 }lua_SSL_CTX;
 
+typedef struct {
+	chk_socket_group *group;
+}lua_socket_group;
+
 #define lua_checkacceptor(L,I)	\
 	(lua_acceptor*)luaL_checkudata(L,I,ACCEPTOR_METATABLE)
 
 #define lua_checkstreamsocket(L,I)	\
 	(lua_stream_socket*)luaL_checkudata(L,I,STREAM_SOCKET_METATABLE)
 
+#define lua_checksocketgroup(L,I)	\
+	(lua_socket_group*)luaL_checkudata(L,I,SOCKET_GROUP_METATABLE)
+
 #define lua_checkdatagramsocket(L,I)	\
 	(lua_datagram_socket*)luaL_checkudata(L,I,DGRAM_SOCKET_METATABLE)	
 
@@ -88,6 +98,74 @@ static int32_t lua_acceptor_resume(lua_State *L) {
 	return 0;
 }
 
+#define GET_ADMISSION_FIELD(L,IDX,A,F,T) do{                               \
+	lua_getfield(L,IDX,#F);                                                 \
+	if(!lua_isnil(L,-1)) (A).F = (T)luaL_checkinteger(L,-1);                \
+	lua_pop(L,1);                                                           \
+}while(0)
+
+/*
+* acceptor:SetAdmission({lag_high=50,send_bytes_high=64*1024*1024,reject=true,...}),
+* 没有给出的字段取默认值,参数为nil时关闭准入控制.失败返回错误描述
+*/
+static int32_t lua_acceptor_set_admission(lua_State *L) {
+	chk_acceptor_admission admission;
+	lua_acceptor *a = lua_checkacceptor(L,1);
+	if(!a->c_acceptor) {
+		lua_pushstring(L,"acceptor closed");
+		return 1;
+	}
+	if(lua_isnoneornil(L,2)) {
+		chk_acceptor_set_admission(a->c_acceptor,NULL);
+		return 0;
+	}
+	luaL_checktype(L,2,LUA_TTABLE);
+	memset(&admission,0,sizeof(admission));
+	GET_ADMISSION_FIELD(L,2,admission,interval,uint32_t);
+	GET_ADMISSION_FIELD(L,2,admission,lag_high,uint32_t);
+	GET_ADMISSION_FIELD(L,2,admission,lag_low,uint32_t);
+	GET_ADMISSION_FIELD(L,2,admission,send_bytes_high,uint64_t);
+	GET_ADMISSION_FIELD(L,2,admission,send_bytes_low,uint64_t);
+	lua_getfield(L,2,"reject");
+	admission.reject = (int8_t)lua_toboolean(L,-1);
+	lua_pop(L,1);
+	if(0 != chk_acceptor_set_admission(a->c_acceptor,&admission)) {
+		lua_pushstring(L,"SetAdmission failed");
+		return 1;
+	}
+	return 0;
+}
+
+#define SET_ADMISSION_FIELD(L,S,F) do{\
+	lua_pushinteger(L,(lua_Integer)(S).F);\
+	lua_setfield(L,-2,#F);\
+}while(0)
+
+//返回阈值和当前状态合并的表,没有开启准入控制时返回nil
+static int32_t lua_acceptor_get_admission(lua_State *L) {
+	chk_acceptor_admission       admission;
+	chk_acceptor_admission_state state;
+	lua_acceptor *a = lua_checkacceptor(L,1);
+	if(!a->c_acceptor || 0 != chk_acceptor_get_admission(a->c_acceptor,&admission,&state)) {
+		return 0;
+	}
+	lua_newtable(L);
+	SET_ADMISSION_FIELD(L,admission,interval);
+	SET_ADMISSION_FIELD(L,admission,lag_high);
+	SET_ADMISSION_FIELD(L,admission,lag_low);
+	SET_ADMISSION_FIELD(L,admission,send_bytes_high);
+	SET_ADMISSION_FIELD(L,admission,send_bytes_low);
+	lua_pushboolean(L,admission.reject);
+	lua_setfield(L,-2,"reject");
+	lua_pushboolean(L,state.overloaded);
+	lua_setfield(L,-2,"overloaded");
+	SET_ADMISSION_FIELD(L,state,lag);
+	SET_ADMISSION_FIELD(L,state,send_bytes);
+	SET_ADMISSION_FIELD(L,state,overload_count);
+	SET_ADMISSION_FIELD(L,state,rejected);
+	return 1;
+}
+
 static int32_t lua_listen_ssl(lua_State *L) {
 	chk_event_loop *event_loop;
 	lua_acceptor   *a;
@@ -149,7 +227,12 @@ static int32_t lua_listen(lua_State *L) {
 		return luaL_error(L,"argument 3 of listen must be lua function");
 	
 	accept_cb = chk_toluaRef(L,3);
-	acceptor  = chk_listen(event_loop,addr,lua_acceptor_cb,chk_ud_make_lr(accept_cb));
+	if(lua_toboolean(L,4)) {
+		//SO_REUSEPORT,用于loop_group中每个loop各自监听同一地址
+		acceptor = chk_listen_reuseport(event_loop,addr,lua_acceptor_cb,chk_ud_make_lr(accept_cb));
+	} else {
+		acceptor = chk_listen(event_loop,addr,lua_acceptor_cb,chk_ud_make_lr(accept_cb));
+	}
 
 	if(!acceptor) {
 		chk_luaRef_release(&accept_cb);
@@ -231,6 +314,9 @@ static int32_t lua_stream_socket_gc(lua_State *L) {
 	if(s->cb.L) {
 		chk_luaRef_release(&s->cb);
 	}
+	if(s->water_cb.L) {
+		chk_luaRef_release(&s->water_cb);
+	}
 	return 0;
 }
 
@@ -287,6 +373,8 @@ static int32_t lua_stream_socket_new(lua_State *L) {
 	fd = (int32_t)luaL_checkinteger(L,1);
 	option.recv_buffer_size = (uint32_t)luaL_optinteger(L,2,4096);
 	if(lua_islightuserdata(L,3)) option.decoder = lua_touserdata(L,3);
+	option.recv_buffer_max = (uint32_t)luaL_optinteger(L,4,0);
+	option.lazy_recv = lua_toboolean(L,5);
 	s = LUA_NEWUSERDATA(L,lua_stream_socket);
 	if(!s) {
 		CHK_SYSLOG(LOG_ERROR,"LUA_NEWUSERDATA(lua_stream_socket) failed");
@@ -320,6 +408,9 @@ static int32_t lua_stream_socket_close(lua_State *L) {
 	if(s->cb.L) {
 		chk_luaRef_release(&s->cb);
 	}	
+	if(s->water_cb.L) {
+		chk_luaRef_release(&s->water_cb);
+	}
 	chk_stream_socket_setUd(s->socket,chk_ud_make_void(NULL));
 	uint32_t delay = (uint32_t)luaL_optinteger(L,2,0);			
 	chk_stream_socket_close(s->socket,delay);	
@@ -375,6 +466,66 @@ static int32_t lua_stream_socket_send(lua_State *L) {
 	return 0;
 }
 
+/*
+*  SendKeyed(key,buff):key为整数,队列中同key还没有开始发送的buffer被替换为buff
+*/
+static int32_t lua_stream_socket_send_keyed(lua_State *L) {
+	chk_bytebuffer    *b,*o;
+	lua_stream_socket *s = lua_checkstreamsocket(L,1);
+	uint64_t           key = (uint64_t)luaL_checkinteger(L,2);
+	if(!s->socket){
+		lua_pushstring(L,"socket close");
+		return 1;
+	}
+	o = lua_checkbytebuffer(L,3);
+	b = chk_bytebuffer_clone(o);
+	if(!b) {
+		lua_pushstring(L,"send error");
+		return 1;
+	}
+
+	if(0 != chk_stream_socket_send_keyed(s->socket,key,b)){
+		lua_pushstring(L,"send error");
+		return 1;
+	}
+	return 0;
+}
+
+/*
+*  SendFile(file,offset,len):file为文件路径或io库打开的文件,len为nil或0时发送到文件末尾
+*/
+static int32_t lua_stream_socket_send_file(lua_State *L) {
+	int32_t      fd,ret;
+	luaL_Stream *stream;
+	lua_stream_socket *s = lua_checkstreamsocket(L,1);
+	if(!s->socket){
+		lua_pushstring(L,"socket close");		
+		return 1;
+	}
+	uint64_t offset = (uint64_t)luaL_optinteger(L,3,0);
+	uint64_t len    = (uint64_t)luaL_optinteger(L,4,0);
+	if(lua_type(L,2) == LUA_TSTRING) {
+		if(0 > (fd = open(lua_tostring(L,2),O_RDONLY))) {
+			lua_pushstring(L,strerror(errno));
+			return 1;
+		}
+		ret = chk_stream_socket_sendfile(s->socket,fd,offset,len);
+		close(fd);
+	} else {
+		stream = (luaL_Stream*)luaL_checkudata(L,2,LUA_FILEHANDLE);
+		if(!stream->closef) {
+			return luaL_error(L,"attempt to use a closed file");
+		}
+		fflush(stream->f);
+		ret = chk_stream_socket_sendfile(s->socket,fileno(stream->f),offset,len);
+	}
+	if(0 != ret) {
+		lua_pushstring(L,"send error");
+		return 1;
+	}
+	return 0;
+}
+
 static int32_t lua_stream_socket_send_urgent(lua_State *L) {
 	chk_bytebuffer    *b,*o;
 	lua_stream_socket *s = lua_checkstreamsocket(L,1);
@@ -450,6 +601,156 @@ static int32_t lua_stream_socket_set_nodelay(lua_State *L) {
 	return 0;
 }
 
+static int32_t lua_stream_socket_set_cork(lua_State *L) {
+	lua_stream_socket *s = lua_checkstreamsocket(L,1);
+	if(!s->socket){
+		return 0;
+	}
+	int8_t on = (int8_t)luaL_optinteger(L,2,0);
+	chk_stream_socket_cork(s->socket,on);
+	return 0;
+}
+
+static int32_t lua_stream_socket_set_busy_poll(lua_State *L) {
+	lua_stream_socket *s = lua_checkstreamsocket(L,1);
+	if(!s->socket){
+		return 0;
+	}
+	uint32_t us = (uint32_t)luaL_optinteger(L,2,0);
+	if(0 != chk_stream_socket_busy_poll(s->socket,us)) {
+		lua_pushstring(L,"SetBusyPoll failed");
+		return 1;
+	}
+	return 0;
+}
+
+/*
+*  返回读统计,read_size为非空桶的{{下限(字节),次数},...}
+*/
+static int32_t lua_stream_socket_get_recv_stats(lua_State *L) {
+	uint32_t i;
+	int32_t  n = 0;
+	chk_stream_socket_recv_stats stats;
+	lua_stream_socket *s = lua_checkstreamsocket(L,1);
+	if(!s->socket || 0 != chk_stream_socket_get_recv_stats(s->socket,&stats)){
+		return 0;
+	}
+	lua_newtable(L);
+	SET_STATS_FIELD(L,stats,reads);
+	SET_STATS_FIELD(L,stats,bytes);
+	SET_STATS_FIELD(L,stats,recv_buffer_size);
+	SET_STATS_FIELD(L,stats,grows);
+	SET_STATS_FIELD(L,stats,shrinks);
+	SET_STATS_FIELD(L,stats,held);
+	lua_newtable(L);
+	for(i = 0; i < CHK_RECV_SIZE_BUCKETS; ++i) {
+		if(stats.read_size[i]) {
+			lua_newtable(L);
+			lua_pushinteger(L,i ? (lua_Integer)1 << (i + 6) : 0);
+			lua_rawseti(L,-2,1);
+			lua_pushinteger(L,(lua_Integer)stats.read_size[i]);
+			lua_rawseti(L,-2,2);
+			lua_rawseti(L,-2,++n);
+		}
+	}
+	lua_setfield(L,-2,"read_size");
+	return 1;
+}
+
+static void lua_socket_water_callback(chk_stream_socket *s,int32_t event,chk_ud _) {
+	lua_stream_socket *lua_socket = (lua_stream_socket*)chk_stream_socket_getUd(s).v.val;
+	const char *error_str;
+	if(!lua_socket || !lua_socket->water_cb.L) {
+		return;
+	}
+	error_str = chk_Lua_PCallRef(lua_socket->water_cb,"s",event == CHK_SEND_WATER_HIGH ? "high" : "low");
+	if(error_str) CHK_SYSLOG(LOG_ERROR,"error on lua_socket_water_callback %s",error_str);
+}
+
+/*
+*  SetWatermark(high,low,cb):发送队列达到high时调用cb("high"),之后降到low时调用cb("low"),high为0时关闭
+*/
+static int32_t lua_stream_socket_set_watermark(lua_State *L) {
+	chk_luaRef cb = {0};
+	lua_stream_socket *s = lua_checkstreamsocket(L,1);
+	if(!s->socket){
+		return 0;
+	}
+	uint32_t high = (uint32_t)luaL_optinteger(L,2,0);
+	uint32_t low  = (uint32_t)luaL_optinteger(L,3,0);
+	if(high && !lua_isfunction(L,4)) 
+		return luaL_error(L,"argument 4 of SetWatermark must be lua function");
+	if(high) {
+		cb = chk_toluaRef(L,4);
+	}
+	if(0 != chk_stream_socket_set_watermark(s->socket,high,low,lua_socket_water_callback,chk_ud_make_void(NULL))) {
+		if(cb.L) {
+			chk_luaRef_release(&cb);
+		}
+		lua_pushstring(L,"SetWatermark failed");
+		return 1;
+	}
+	if(s->water_cb.L) {
+		chk_luaRef_release(&s->water_cb);
+	}
+	s->water_cb = cb;
+	return 0;
+}
+
+static int32_t lua_stream_socket_set_notsent_lowat(lua_State *L) {
+	lua_stream_socket *s = lua_checkstreamsocket(L,1);
+	if(!s->socket){
+		return 0;
+	}
+	uint32_t bytes = (uint32_t)luaL_optinteger(L,2,0);
+	if(0 != chk_stream_socket_notsent_lowat(s->socket,bytes)) {
+		lua_pushstring(L,"SetNotSentLowat failed");
+		return 1;
+	}
+	return 0;
+}
+
+static int32_t lua_stream_socket_set_zerocopy(lua_State *L) {
+	lua_stream_socket *s = lua_checkstreamsocket(L,1);
+	if(!s->socket){
+		return 0;
+	}
+	uint32_t threshold = (uint32_t)luaL_optinteger(L,2,0);
+	if(0 != chk_stream_socket_zerocopy(s->socket,threshold)) {
+		lua_pushstring(L,"SetZeroCopy failed");
+		return 1;
+	}
+	return 0;
+}
+
+static int32_t lua_stream_socket_set_priority(lua_State *L) {
+	lua_stream_socket *s = lua_checkstreamsocket(L,1);
+	if(!s->socket){
+		return 0;
+	}
+	int8_t priority = (int8_t)luaL_checkinteger(L,2);
+	if(0 != chk_loop_set_priority(cast(chk_handle*,s->socket),priority)) {
+		lua_pushstring(L,"invaild priority");
+		return 1;
+	}
+	return 0;
+}
+
+static int32_t lua_stream_socket_set_edge_trigger(lua_State *L) {
+	lua_stream_socket *s = lua_checkstreamsocket(L,1);
+	if(!s->socket){
+		return 0;
+	}
+	int8_t on = (int8_t)luaL_optinteger(L,2,1);
+	uint32_t io_budget = (uint32_t)luaL_optinteger(L,3,0);
+	uint32_t packet_budget = (uint32_t)luaL_optinteger(L,4,0);
+	if(0 != chk_stream_socket_edge_trigger(s->socket,on,io_budget,packet_budget)) {
+		lua_pushstring(L,"SetEdgeTrigger must be called before Start");
+		return 1;
+	}
+	return 0;
+}
+
 static int32_t lua_stream_socket_shutdown_write(lua_State *L) {
 	lua_stream_socket *s = lua_checkstreamsocket(L,1);
 	if(!s->socket){
@@ -731,6 +1032,82 @@ static int32_t lua_addr(lua_State *L) {
 	return 1;
 }
 
+/*
+*  socket.stream.group():广播组,Broadcast(buff)向所有成员发送同一份数据
+*/
+static int32_t lua_socket_group_new(lua_State *L) {
+	lua_socket_group *g = LUA_NEWUSERDATA(L,lua_socket_group);
+	if(!g) {
+		CHK_SYSLOG(LOG_ERROR,"LUA_NEWUSERDATA(lua_socket_group) failed");
+		return 0;
+	}
+	if(!(g->group = chk_socket_group_new())) {
+		return 0;
+	}
+	luaL_getmetatable(L, SOCKET_GROUP_METATABLE);
+	lua_setmetatable(L, -2);
+	return 1;
+}
+
+static int32_t lua_socket_group_gc(lua_State *L) {
+	lua_socket_group *g = lua_checksocketgroup(L,1);
+	if(g->group) {
+		chk_socket_group_del(g->group);
+		g->group = NULL;
+	}
+	return 0;
+}
+
+static int32_t lua_socket_group_add(lua_State *L) {
+	lua_socket_group  *g = lua_checksocketgroup(L,1);
+	lua_stream_socket *s = lua_checkstreamsocket(L,2);
+	if(!g->group) {
+		return luaL_error(L,"invaild lua_socket_group");
+	}
+	if(!s->socket) {
+		lua_pushstring(L,"socket close");
+		return 1;
+	}
+	if(0 != chk_socket_group_add(g->group,s->socket)) {
+		lua_pushstring(L,"Add failed");
+		return 1;
+	}
+	return 0;
+}
+
+static int32_t lua_socket_group_remove(lua_State *L) {
+	lua_socket_group  *g = lua_checksocketgroup(L,1);
+	lua_stream_socket *s = lua_checkstreamsocket(L,2);
+	if(!g->group) {
+		return luaL_error(L,"invaild lua_socket_group");
+	}
+	if(s->socket) {
+		chk_socket_group_remove(g->group,s->socket);
+	}
+	return 0;
+}
+
+static int32_t lua_socket_group_size(lua_State *L) {
+	lua_socket_group *g = lua_checksocketgroup(L,1);
+	lua_pushinteger(L,g->group ? chk_socket_group_size(g->group) : 0);
+	return 1;
+}
+
+static int32_t lua_socket_group_broadcast(lua_State *L) {
+	chk_bytebuffer   *b,*o;
+	lua_socket_group *g = lua_checksocketgroup(L,1);
+	if(!g->group) {
+		return luaL_error(L,"invaild lua_socket_group");
+	}
+	o = lua_checkbytebuffer(L,2);
+	b = chk_bytebuffer_clone(o);
+	if(!b || 0 != chk_socket_group_broadcast(g->group,b)) {
+		lua_pushstring(L,"broadcast error");
+		return 1;
+	}
+	return 0;
+}
+
 static void register_socket(lua_State *L) {
 	luaL_Reg acceptor_mt[] = {
 		{"__gc", lua_acceptor_gc},
@@ -740,6 +1117,8 @@ static void register_socket(lua_State *L) {
 	luaL_Reg acceptor_methods[] = {
 		{"Pause",    lua_acceptor_pause},
 		{"Resume",	 lua_acceptor_resume},
+		{"SetAdmission",lua_acceptor_set_admission},
+		{"GetAdmission",lua_acceptor_get_admission},
 		{"Close",    lua_acceptor_gc},
 		{NULL,		 NULL}
 	};
@@ -752,6 +1131,8 @@ static void register_socket(lua_State *L) {
 	luaL_Reg stream_socket_methods[] = {
 		{"Send",    	lua_stream_socket_send},
 		{"SendUrgent",	lua_stream_socket_send_urgent},
+		{"SendFile",	lua_stream_socket_send_file},
+		{"SendKeyed",	lua_stream_socket_send_keyed},
 		{"Start",   	lua_stream_socket_start},
 		{"PauseRead",   lua_stream_socket_pause_read},
 		{"ResumeRead",	lua_stream_socket_resume_read},		
@@ -759,11 +1140,33 @@ static void register_socket(lua_State *L) {
 		{"GetSockAddr", lua_stream_socket_getsockaddr},
 		{"GetPeerAddr", lua_stream_socket_getpeeraddr},	
 		{"SetNoDelay",  lua_stream_socket_set_nodelay},
+		{"SetCork",     lua_stream_socket_set_cork},
+		{"SetEdgeTrigger",lua_stream_socket_set_edge_trigger},
+		{"SetBusyPoll", lua_stream_socket_set_busy_poll},
+		{"SetZeroCopy", lua_stream_socket_set_zerocopy},
+		{"SetWatermark",lua_stream_socket_set_watermark},
+		{"SetNotSentLowat",lua_stream_socket_set_notsent_lowat},
+		{"GetRecvStats",lua_stream_socket_get_recv_stats},
+		{"SetPriority", lua_stream_socket_set_priority},
 		{"ShutDownWrite",lua_stream_socket_shutdown_write},
 		{"SetCloseCallBack",lua_stream_socket_set_close_cb},
 		{NULL,     		NULL}
 	};
 
+	luaL_Reg socket_group_mt[] = {
+		{"__gc", lua_socket_group_gc},
+		{NULL, NULL}
+	};
+
+	luaL_Reg socket_group_methods[] = {
+		{"Add",         lua_socket_group_add},
+		{"Remove",      lua_socket_group_remove},
+		{"Broadcast",   lua_socket_group_broadcast},
+		{"Size",        lua_socket_group_size},
+		{"Close",       lua_socket_group_gc},
+		{NULL,          NULL}
+	};
+
 	luaL_Reg datagram_socket_mt[] = {
 		{"__gc", lua_datagram_socket_gc},
 		{NULL, NULL}
@@ -794,6 +1197,13 @@ static void register_socket(lua_State *L) {
 	lua_setfield(L, -2, "__index");
 	lua_pop(L, 1);
 
+	luaL_newmetatable(L, SOCKET_GROUP_METATABLE);
+	luaL_setfuncs(L, socket_group_mt, 0);
+
+	luaL_newlib(L, socket_group_methods);
+	lua_setfield(L, -2, "__index");
+	lua_pop(L, 1);
+
 	luaL_newmetatable(L, DGRAM_SOCKET_METATABLE);
 	luaL_setfuncs(L, datagram_socket_mt, 0);
 
@@ -819,6 +1229,7 @@ static void register_socket(lua_State *L) {
 	SET_FUNCTION(L,"dial",lua_dail);
 	SET_FUNCTION(L,"listen",lua_listen);
 	SET_FUNCTION(L,"listen_ssl",lua_listen_ssl);
+	SET_FUNCTION(L,"group",lua_socket_group_new);
 	lua_settable(L,-3);
 
 	lua_pushstring(L,"datagram");
@@ -5,6 +5,14 @@ int32_t lua_systick(lua_State *L) {
 	return 1;
 }
 
+//单调时钟,微秒
+int32_t lua_microtick(lua_State *L) {
+	struct timespec tv;
+	clock_gettime(CLOCK_MONOTONIC,&tv);
+	lua_pushinteger(L,tv.tv_sec * (uint64_t)1000000 + tv.tv_nsec / 1000);
+	return 1;
+}
+
 int32_t lua_unixtime(lua_State *L) {
 	lua_pushinteger(L,time(NULL));
 	return 1;
@@ -14,4 +22,5 @@ static void register_time(lua_State *L) {
 	lua_newtable(L);
 	SET_FUNCTION(L,"systick",lua_systick);
 	SET_FUNCTION(L,"unixtime",lua_unixtime);
+	SET_FUNCTION(L,"microtick",lua_microtick);
 }
\ No newline at end of file
@@ -4,8 +4,11 @@
 #include "socket/chk_acceptor.h"
 #include "socket/chk_socket_helper.h"
 #include "socket/chk_acceptor_define.h"
+#include "socket/chk_stream_socket.h"
 #include "util/chk_log.h"
 #include "util/chk_error.h"
+#include "util/chk_time.h"
+#include "config.h"
 
 #ifndef  cast
 # define  cast(T,P) ((T)(P))
@@ -47,6 +50,17 @@ static void do_callback(chk_acceptor *acceptor,int32_t fd,chk_sockaddr *addr,chk
 	acceptor->cb(acceptor,fd,addr,acceptor->ud,err);
 }
 
+//SO_LINGER超时为0,close时直接发送RST,不进入TIME_WAIT
+static void fast_close(int32_t fd) {
+	struct linger l = {1,0};
+	setsockopt(fd,SOL_SOCKET,SO_LINGER,&l,sizeof(l));
+	close(fd);
+}
+
+static inline int32_t admission_reject(chk_acceptor *a) {
+	return a->admission && a->admission->state.overloaded && a->admission->cfg.reject;
+}
+
 static void process_accept(chk_handle *h,int32_t events) {
 	int32_t 	 fd;
 	int32_t      ret;
@@ -58,7 +72,11 @@ static void process_accept(chk_handle *h,int32_t events) {
 	}
     do {
 		ret = _accept(acceptor,&addr,&fd);
-		if(ret == 0)
+		if(ret == 0 && admission_reject(acceptor)) {
+			++acceptor->admission->state.rejected;
+			fast_close(fd);
+		}
+		else if(ret == 0)
 		   do_callback(acceptor,fd,&addr,acceptor->ud,0);
 		else if(ret != EAGAIN){
 		   CHK_SYSLOG(LOG_ERROR,"_accept() failed ret:%d",ret);	
@@ -75,17 +93,154 @@ int32_t chk_acceptor_pause(chk_acceptor *a) {
 	return chk_disable_read(cast(chk_handle*,a));
 }
 
+static void admission_enter(chk_acceptor *a) {
+	chk_admission_ctl *ctl = a->admission;
+	ctl->state.overloaded = 1;
+	++ctl->state.overload_count;
+	if(!ctl->cfg.reject && chk_is_read_enable(cast(chk_handle*,a))) {
+		chk_acceptor_pause(a);
+		ctl->paused = 1;
+	}
+	CHK_SYSLOG(LOG_INFO,"acceptor fd:%d overloaded,lag:%u ms,send_bytes:%llu",a->fd,ctl->state.lag,
+		(unsigned long long)ctl->state.send_bytes);
+}
+
+static void admission_leave(chk_acceptor *a) {
+	chk_admission_ctl *ctl = a->admission;
+	ctl->state.overloaded = 0;
+	if(ctl->paused) {
+		chk_acceptor_resume(a);
+		ctl->paused = 0;
+	}
+	CHK_SYSLOG(LOG_INFO,"acceptor fd:%d recovered,lag:%u ms,send_bytes:%llu",a->fd,ctl->state.lag,
+		(unsigned long long)ctl->state.send_bytes);
+}
+
+/*
+*  tick是定时器预定的触发时间,与当前时间之差就是loop没能及时回到定时器处理的延迟.
+*  loop卡住之后时间轮会补发错过的触发,同一时刻补发的只取第一次采样
+*/
+static int32_t admission_timer_cb(uint64_t tick,chk_ud ud) {
+	chk_acceptor      *a   = cast(chk_acceptor*,ud.v.val);
+	chk_admission_ctl *ctl = a->admission;
+	uint64_t           now = chk_accurate_tick64();
+	int32_t            over_lag,over_send,lag_ok,send_ok;
+
+	if(ctl->last_sample && now - ctl->last_sample < ctl->cfg.interval / 2) {
+		return 0;
+	}
+	ctl->last_sample = now;
+	ctl->state.lag = now > tick ? (uint32_t)(now - tick) : 0;
+	if(ctl->cfg.send_bytes_high) {
+		ctl->state.send_bytes = chk_stream_socket_loop_send_bytes(a->loop);
+	}
+
+	over_lag  = ctl->cfg.lag_high && ctl->state.lag >= ctl->cfg.lag_high;
+	over_send = ctl->cfg.send_bytes_high && ctl->state.send_bytes >= ctl->cfg.send_bytes_high;
+	lag_ok    = !ctl->cfg.lag_high || ctl->state.lag <= ctl->cfg.lag_low;
+	send_ok   = !ctl->cfg.send_bytes_high || ctl->state.send_bytes <= ctl->cfg.send_bytes_low;
+
+	if(!ctl->state.overloaded && (over_lag || over_send)) {
+		admission_enter(a);
+	} else if(ctl->state.overloaded && lag_ok && send_ok) {
+		admission_leave(a);
+	}
+	return 0;
+}
+
+//定时器随loop销毁或被注销时清空引用
+static void admission_timer_cleaner(chk_ud *ud) {
+	chk_acceptor *a = cast(chk_acceptor*,ud->v.val);
+	if(a->admission) {
+		a->admission->timer = NULL;
+	}
+}
+
+static void admission_release(chk_acceptor *a) {
+	chk_admission_ctl *ctl = a->admission;
+	if(!ctl) {
+		return;
+	}
+	if(ctl->timer) {
+		chk_timer_unregister(ctl->timer);
+	}
+	if(ctl->paused) {
+		chk_acceptor_resume(a);
+	}
+	a->admission = NULL;
+	free(ctl);
+}
+
+int32_t chk_acceptor_set_admission(chk_acceptor *a,const chk_acceptor_admission *admission) {
+	chk_admission_ctl *ctl;
+	if(!a) {
+		return chk_error_invaild_argument;
+	}
+
+	if(!a->loop) {
+		CHK_SYSLOG(LOG_ERROR,"acceptor not in loop");
+		return chk_error_no_event_loop;
+	}
+
+	admission_release(a);
+
+	if(!admission) {
+		return chk_error_ok;
+	}
+
+	if(NULL == (ctl = calloc(1,sizeof(*ctl)))) {
+		CHK_SYSLOG(LOG_ERROR,"calloc chk_admission_ctl failed");
+		return chk_error_no_memory;
+	}
+
+	ctl->cfg = *admission;
+	if(0 == ctl->cfg.interval) {
+		ctl->cfg.interval = CHK_ADMISSION_INTERVAL;
+	}
+	if(0 == ctl->cfg.lag_low || ctl->cfg.lag_low > ctl->cfg.lag_high) {
+		ctl->cfg.lag_low = ctl->cfg.lag_high / 2;
+	}
+	if(0 == ctl->cfg.send_bytes_low || ctl->cfg.send_bytes_low > ctl->cfg.send_bytes_high) {
+		ctl->cfg.send_bytes_low = ctl->cfg.send_bytes_high / 2;
+	}
+
+	a->admission = ctl;
+	if(NULL == (ctl->timer = chk_loop_addtimer(a->loop,ctl->cfg.interval,admission_timer_cb,chk_ud_make_void(a)))) {
+		CHK_SYSLOG(LOG_ERROR,"chk_loop_addtimer() failed");
+		a->admission = NULL;
+		free(ctl);
+		return chk_error_no_memory;
+	}
+	chk_timer_set_ud_cleaner(ctl->timer,admission_timer_cleaner);
+	return chk_error_ok;
+}
+
+int32_t chk_acceptor_get_admission(chk_acceptor *a,chk_acceptor_admission *admission,chk_acceptor_admission_state *state) {
+	if(!a || !a->admission) {
+		return chk_error_invaild_argument;
+	}
+	if(admission) {
+		*admission = a->admission->cfg;
+	}
+	if(state) {
+		*state = a->admission->state;
+	}
+	return chk_error_ok;
+}
+
 void chk_acceptor_init(chk_acceptor *a,int32_t fd,SSL_CTX *ctx,chk_ud ud) {
 	a->ud = ud;
 	a->fd = fd;
 	a->on_events  = process_accept;
 	a->handle_add = loop_add;
 	a->loop = NULL;
+	a->priority = CHK_PRIORITY_HIGH;
 	a->ctx = ctx;
 	easy_close_on_exec(fd);
 }
 
 void chk_acceptor_finalize(chk_acceptor *a) {
+	admission_release(a);
 	chk_unwatch_handle(cast(chk_handle*,a));
 	if(a->fd >= 0) {
 		close(a->fd);
@@ -143,7 +298,7 @@ int32_t chk_acceptor_start(chk_acceptor *a,chk_event_loop *loop,chk_sockaddr *ad
 	return 0;
 }
 
-static chk_acceptor *_chk_listen(chk_event_loop *loop,chk_sockaddr *addr,SSL_CTX *ctx,chk_acceptor_cb cb,chk_ud ud) {
+static chk_acceptor *_chk_listen(chk_event_loop *loop,chk_sockaddr *addr,SSL_CTX *ctx,chk_acceptor_cb cb,chk_ud ud,int32_t reuseport) {
 	int32_t       fd,family;
 	chk_acceptor *a = NULL;
 	errno = 0;
@@ -166,6 +321,12 @@ static chk_acceptor *_chk_listen(chk_event_loop *loop,chk_sockaddr *addr,SSL_CTX
 		return NULL;
 	}
 
+	if(reuseport && chk_error_ok != easy_port_reuse(fd,1)) {
+		CHK_SYSLOG(LOG_ERROR,"easy_port_reuse() failed");
+		close(fd);
+		return NULL;
+	}
+
 	a = chk_acceptor_new(fd,ctx,ud);
 
 	if(NULL == a) {
@@ -190,7 +351,17 @@ chk_acceptor *chk_listen(chk_event_loop *loop,chk_sockaddr *addr,chk_acceptor_cb
 		return NULL;
 	}
 
-	return _chk_listen(loop,addr,NULL,cb,ud);
+	return _chk_listen(loop,addr,NULL,cb,ud,0);
+}
+
+chk_acceptor *chk_listen_reuseport(chk_event_loop *loop,chk_sockaddr *addr,chk_acceptor_cb cb,chk_ud ud) {
+
+	if(NULL == loop || NULL == addr || NULL == cb) {
+		CHK_SYSLOG(LOG_ERROR,"NULL == loop || NULL == addr || NULL == cb");		
+		return NULL;
+	}
+
+	return _chk_listen(loop,addr,NULL,cb,ud,1);
 }
 
 chk_acceptor *chk_ssl_listen(chk_event_loop *loop,chk_sockaddr *addr,SSL_CTX *ctx,chk_acceptor_cb cb,chk_ud ud) {
@@ -199,7 +370,14 @@ chk_acceptor *chk_ssl_listen(chk_event_loop *loop,chk_sockaddr *addr,SSL_CTX *ct
 		return NULL;
 	}
 	
-	return _chk_listen(loop,addr,ctx,cb,ud);	
+	return _chk_listen(loop,addr,ctx,cb,ud,0);	
+}
+
+chk_event_loop *chk_acceptor_get_loop(chk_acceptor *a) {
+	if(!a) {
+		return NULL;
+	}
+	return a->loop;
 }
 
 SSL_CTX *chk_acceptor_get_ssl_ctx(chk_acceptor *a) {
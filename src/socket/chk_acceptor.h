@@ -10,6 +10,48 @@ typedef struct chk_acceptor chk_acceptor;
 
 typedef void (*chk_acceptor_cb)(chk_acceptor*,int32_t fd,chk_sockaddr*,chk_ud ud,int32_t err);
 
+/*
+* 准入控制:周期性地采样loop延迟(定时器预定的触发时间与实际执行时间之差)
+* 和loop上所有连接待发送的字节数,超过上限时进入过载状态,回落到下限以下时退出.
+* 过载期间暂停acceptor(新连接留在内核的backlog中),或者接受之后立即以RST关闭,
+* 让客户端快速失败而不是等待.
+*/
+
+typedef struct {
+	uint32_t interval;          //采样间隔(毫秒),0使用CHK_ADMISSION_INTERVAL
+	uint32_t lag_high;          //延迟(毫秒)达到该值进入过载,0不检查延迟
+	uint32_t lag_low;           //延迟回落到该值以下才退出过载,0取lag_high的一半
+	uint64_t send_bytes_high;   //待发送字节数达到该值进入过载,0不检查
+	uint64_t send_bytes_low;    //待发送字节数回落到该值以下才退出过载,0取send_bytes_high的一半
+	int8_t   reject;            //过载时不暂停,接受新连接后立即以RST关闭
+}chk_acceptor_admission;
+
+typedef struct {
+	int8_t   overloaded;        //当前是否过载
+	uint32_t lag;               //最近一次采样的延迟(毫秒)
+	uint64_t send_bytes;        //最近一次采样的待发送字节数
+	uint64_t overload_count;    //进入过载的次数
+	uint64_t rejected;          //过载期间被快速关闭的连接数
+}chk_acceptor_admission_state;
+
+/**
+ * 开启或关闭准入控制,acceptor必须已经注册到loop上,必须在loop所属线程中调用.
+ * 由准入控制暂停的acceptor在关闭准入控制时恢复
+ * @param a 接受器
+ * @param admission 阈值,NULL关闭
+ */
+
+int32_t chk_acceptor_set_admission(chk_acceptor *a,const chk_acceptor_admission *admission);
+
+/**
+ * 获取准入控制的阈值和当前状态,没有开启时返回chk_error_invaild_argument
+ * @param a 接受器
+ * @param admission 输出阈值,可以为NULL
+ * @param state 输出状态,可以为NULL
+ */
+
+int32_t chk_acceptor_get_admission(chk_acceptor *a,chk_acceptor_admission *admission,chk_acceptor_admission_state *state);
+
 /**
  * 恢复acceptor的执行
  * @param a 接受器
@@ -57,6 +99,13 @@ void chk_acceptor_del(chk_acceptor *a);
 
 chk_acceptor *chk_listen(chk_event_loop *loop,chk_sockaddr *addr,chk_acceptor_cb cb,chk_ud ud);
 
+/**
+ * 与chk_listen相同,但监听套接字设置了SO_REUSEPORT,
+ * 多个loop可以各自在同一地址上建立acceptor,由内核在它们之间分配新连接
+ */
+
+chk_acceptor *chk_listen_reuseport(chk_event_loop *loop,chk_sockaddr *addr,chk_acceptor_cb cb,chk_ud ud);
+
 chk_acceptor *chk_ssl_listen(chk_event_loop *loop,chk_sockaddr *addr,SSL_CTX *ctx,chk_acceptor_cb cb,chk_ud ud);
 
 
@@ -66,6 +115,9 @@ chk_ud chk_acceptor_get_ud(chk_acceptor *a);
 
 void chk_acceptor_set_ud(chk_acceptor *a,chk_ud ud);
 
+//获取acceptor所在的event_loop
+chk_event_loop *chk_acceptor_get_loop(chk_acceptor *a);
+
 SSL_CTX *chk_acceptor_get_ssl_ctx(chk_acceptor *a);
 
 #endif
\ No newline at end of file
@@ -4,11 +4,20 @@
 #include <openssl/err.h>
 #include "chk_ud.h"
 
+typedef struct {
+    chk_acceptor_admission       cfg;
+    chk_acceptor_admission_state state;
+    chk_timer                   *timer;     //采样定时器
+    uint64_t                     last_sample;
+    int8_t                       paused;    //acceptor由准入控制暂停
+}chk_admission_ctl;
+
 struct chk_acceptor {
     _chk_handle;
-    chk_ud          ud; 
-    chk_acceptor_cb cb;
-    SSL_CTX        *ctx;
+    chk_ud             ud; 
+    chk_acceptor_cb    cb;
+    SSL_CTX           *ctx;
+    chk_admission_ctl *admission;           //NULL表示没有开启准入控制
 };
 
 #endif
\ No newline at end of file
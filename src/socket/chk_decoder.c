@@ -60,6 +60,11 @@ chk_bytebuffer *packet_decoder_unpack(chk_decoder *_,int32_t *err) {
 			}
 		}while(pk_total);			
 	}while(0);
+	if(d->b && 0 == d->size) {
+		//数据已经全部解出,下次update从新数据的位置开始
+		chk_bytechunk_release(d->b);
+		d->b = NULL;
+	}
 	return ret;
 }
 
@@ -16,6 +16,9 @@ struct chk_decoder {
 	 * @param b 接收到的数据块链表头(数据可能被存放在多个chunk中形成链表)
 	 * @param spos 接收到的数据在b中的起始下标 
 	 * @param size 接收到的数据大小
+	 * 新数据总是紧接在之前的数据之后(在同一个chunk链表中).
+	 * 已经没有未解出的数据时应该释放对chunk的引用,惰性接收模式(option.lazy_recv)的socket
+	 * 在chunk没有被其它地方引用时才能释放接收缓冲
 	 */
 
 	void (*update)(chk_decoder *d,chk_bytechunk *b,uint32_t spos,uint32_t size);
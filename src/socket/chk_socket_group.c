@@ -0,0 +1,187 @@
+#define _CORE_
+#include <stddef.h>
+#include "util/chk_error.h"
+#include "util/chk_log.h"
+#include "socket/chk_socket_helper.h"
+#include "socket/chk_socket_group.h"
+#include "socket/chk_stream_socket_define.h"
+#include "socket/chk_socket_group_define.h"
+
+#ifndef  cast
+# define  cast(T,P) ((T)(P))
+#endif
+
+#define ENTRY_TO_MEMBER(ENTRY)                                              \
+    (chk_group_member*)(((char*)(ENTRY))-offsetof(chk_group_member,entry))
+
+/*释放一个成员对msg的引用,从头部开始释放已经没有成员引用的消息*/
+static void msg_release(chk_socket_group *g,chk_group_msg *msg) {
+	--msg->refs;
+	while((msg = g->head) && 0 == msg->refs) {
+		g->head = msg->next;
+		if(!g->head) {
+			g->tail = NULL;
+		}
+		chk_bytebuffer_del(msg->b);
+		free(msg);
+	}
+}
+
+void chk_group_member_advance(chk_group_member *m) {
+	chk_group_msg *msg = m->msg;
+	m->msg = msg == m->last ? NULL : msg->next;
+	m->pos = 0;
+	if(!m->msg) {
+		m->last = NULL;
+	}
+	msg_release(m->group,msg);
+}
+
+void chk_group_member_drop(chk_group_member *m) {
+	while(m->msg) {
+		chk_group_member_advance(m);
+	}
+}
+
+static void member_free(chk_group_member *m) {
+	chk_group_member **pp;
+	for(pp = &m->s->groups; *pp; pp = &(*pp)->next) {
+		if(*pp == m) {
+			*pp = m->next;
+			break;
+		}
+	}
+	chk_dlist_remove(&m->entry);
+	--m->group->size;
+	free(m);
+}
+
+void chk_socket_group_socket_release(chk_stream_socket *s) {
+	chk_group_member *m;
+	while((m = s->groups)) {
+		/*游标已经随send_list释放*/
+		chk_group_member_drop(m);
+		member_free(m);
+	}
+}
+
+chk_socket_group *chk_socket_group_new() {
+	chk_socket_group *g = calloc(1,sizeof(*g));
+	if(!g) {
+		CHK_SYSLOG(LOG_ERROR,"calloc chk_socket_group failed");
+		return NULL;
+	}
+	chk_dlist_init(&g->members);
+	return g;
+}
+
+void chk_socket_group_del(chk_socket_group *g) {
+	chk_dlist_entry  *entry;
+	chk_group_member *m;
+	while((entry = chk_dlist_begin(&g->members)) != chk_dlist_end(&g->members)) {
+		m = ENTRY_TO_MEMBER(entry);
+		chk_stream_socket_detach_group(m->s,m);
+		member_free(m);
+	}
+	free(g);
+}
+
+static inline chk_group_member *find_member(chk_socket_group *g,chk_stream_socket *s) {
+	chk_group_member *m;
+	for(m = s->groups; m; m = m->next) {
+		if(m->group == g) {
+			return m;
+		}
+	}
+	return NULL;
+}
+
+int32_t chk_socket_group_add(chk_socket_group *g,chk_stream_socket *s) {
+	chk_group_member *m;
+	if(!g || !s) {
+		return chk_error_invaild_argument;
+	}
+	if(s->closed) {
+		return chk_error_socket_close;
+	}
+	if(s->shared) {
+		CHK_SYSLOG(LOG_ERROR,"shared handle can't join chk_socket_group");
+		return chk_error_invaild_argument;
+	}
+	if(find_member(g,s)) {
+		return chk_error_ok;
+	}
+	if(!(m = calloc(1,sizeof(*m)))) {
+		CHK_SYSLOG(LOG_ERROR,"calloc chk_group_member failed");
+		return chk_error_no_memory;
+	}
+	m->b.flags = SEND_GROUP;
+	m->group   = g;
+	m->s       = s;
+	m->next    = s->groups;
+	s->groups  = m;
+	chk_dlist_pushback(&g->members,&m->entry);
+	++g->size;
+	return chk_error_ok;
+}
+
+int32_t chk_socket_group_remove(chk_socket_group *g,chk_stream_socket *s) {
+	chk_group_member *m;
+	if(!g || !s) {
+		return chk_error_invaild_argument;
+	}
+	if(!(m = find_member(g,s))) {
+		return chk_error_invaild_argument;
+	}
+	chk_stream_socket_detach_group(s,m);
+	member_free(m);
+	return chk_error_ok;
+}
+
+uint32_t chk_socket_group_size(chk_socket_group *g) {
+	return g->size;
+}
+
+int32_t chk_socket_group_broadcast(chk_socket_group *g,chk_bytebuffer *b) {
+	chk_dlist_entry  *entry;
+	chk_group_member *m;
+	chk_group_msg    *msg;
+
+	if(b->flags & READ_ONLY) {
+		CHK_SYSLOG(LOG_ERROR,"chk_bytebuffer is read only");
+		return chk_error_buffer_read_only;
+	}
+
+	if(b->datasize == 0) {
+		CHK_SYSLOG(LOG_ERROR,"b->datasize == 0");
+		chk_bytebuffer_del(b);
+		return chk_error_invaild_buffer;
+	}
+
+	if(!(msg = calloc(1,sizeof(*msg)))) {
+		CHK_SYSLOG(LOG_ERROR,"calloc chk_group_msg failed");
+		chk_bytebuffer_del(b);
+		return chk_error_no_memory;
+	}
+	msg->b = b;
+	b->internal = b->datasize;
+
+	chk_dlist_foreach(&g->members,entry) {
+		m = ENTRY_TO_MEMBER(entry);
+		if(chk_stream_socket_queue_group(m->s,m,msg)) {
+			++msg->refs;
+		}
+	}
+
+	if(0 == msg->refs) {
+		chk_bytebuffer_del(b);
+		free(msg);
+	} else if(g->tail) {
+		/*游标按next遍历,排入之后才链接,排入时不会访问*/
+		g->tail->next = msg;
+		g->tail = msg;
+	} else {
+		g->head = g->tail = msg;
+	}
+	return chk_error_ok;
+}
@@ -0,0 +1,50 @@
+#ifndef _CHK_SOCKET_GROUP_H
+#define _CHK_SOCKET_GROUP_H
+
+/*
+* 广播组:一次广播的消息只保存一份,以引用计数的方式排入所有成员的发送队列,
+* 成员在本轮循环结束时一次写出.组和它的成员只能在同一个线程中使用
+*/
+
+#include "socket/chk_stream_socket.h"
+
+typedef struct chk_socket_group chk_socket_group;
+
+chk_socket_group *chk_socket_group_new();
+
+/**
+ * 删除组,成员中还没有发送的消息转为普通buffer继续发送
+ * @param g 组
+ */
+
+void chk_socket_group_del(chk_socket_group *g);
+
+/**
+ * 加入组,socket关闭(释放)时自动退出.迁移到其它loop之前socket会退出所有的组.
+ * 组只能在一个线程中使用,共享模式group上的socket回调在不同的worker中执行,不能加入
+ * @param g 组
+ * @param s stream_socket
+ */
+
+int32_t chk_socket_group_add(chk_socket_group *g,chk_stream_socket *s);
+
+/**
+ * 退出组,已经排入的消息仍会发送
+ * @param g 组
+ * @param s stream_socket
+ */
+
+int32_t chk_socket_group_remove(chk_socket_group *g,chk_stream_socket *s);
+
+uint32_t chk_socket_group_size(chk_socket_group *g);
+
+/**
+ * 向所有成员发送b,与chk_stream_socket_send保持顺序.成员的游标之后排入了单播的buffer时,
+ * 该成员改为发送b的拷贝(共享chunk)
+ * @param g 组
+ * @param b 要发送的buffer,调用之后由组管理
+ */
+
+int32_t chk_socket_group_broadcast(chk_socket_group *g,chk_bytebuffer *b);
+
+#endif
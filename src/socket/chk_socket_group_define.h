@@ -0,0 +1,59 @@
+#ifdef _CORE_
+
+#include "util/chk_list.h"
+#include "util/chk_bytechunk.h"
+
+struct chk_stream_socket;
+
+/*
+*  广播的消息,组内所有成员共享同一份.按广播顺序链接,refs为还没有发送完它的成员数,
+*  refs为0的消息到达链表头部时释放
+*/
+typedef struct chk_group_msg {
+    struct chk_group_msg *next;
+    uint32_t              refs;
+    chk_bytebuffer       *b;
+}chk_group_msg;
+
+/*
+*  成员的发送游标,以SEND_GROUP标记的chk_bytebuffer开头排入成员的send_list,
+*  依次发送[msg,last]范围内的消息.每个成员只有一个游标,随成员一起分配
+*/
+typedef struct chk_group_member {
+    chk_bytebuffer            b;              //flags = SEND_GROUP,datasize/internal保持为0
+    chk_dlist_entry           entry;          //组的成员列表
+    struct chk_group_member  *next;           //同一socket加入的其它组
+    struct chk_socket_group  *group;
+    struct chk_stream_socket *s;
+    chk_group_msg            *msg;            //NULL表示没有待发送的消息,游标不在send_list中
+    chk_group_msg            *last;
+    uint32_t                  pos;            //msg中已经发送的字节数
+}chk_group_member;
+
+struct chk_socket_group {
+    chk_dlist      members;
+    uint32_t       size;
+    chk_group_msg *head;                      //最早的消息
+    chk_group_msg *tail;
+};
+
+/*
+*  stream_socket与socket_group之间的内部接口,都只能在socket所属的线程中调用
+*/
+
+//把msg排入成员的发送队列,返回1表示游标引用了msg,返回0表示以拷贝发送或socket已经关闭
+int32_t chk_stream_socket_queue_group(struct chk_stream_socket *s,chk_group_member *m,chk_group_msg *msg);
+
+//成员离开组,游标中还没有发送的消息转为send_list中同一位置的普通buffer
+void    chk_stream_socket_detach_group(struct chk_stream_socket *s,chk_group_member *m);
+
+//游标发送完当前的消息,移到下一条
+void    chk_group_member_advance(chk_group_member *m);
+
+//丢弃游标中还没有发送的消息(socket释放)
+void    chk_group_member_drop(chk_group_member *m);
+
+//socket释放时退出所有的组
+void    chk_socket_group_socket_release(struct chk_stream_socket *s);
+
+#endif
@@ -2,6 +2,10 @@
 #include "util/chk_error.h"
 #include "util/chk_log.h"
 
+#ifdef _LINUX
+#include <linux/filter.h>
+#endif
+
 #ifndef  cast
 # define  cast(T,P) ((T)(P))
 #endif
@@ -64,6 +68,81 @@ int32_t easy_addr_reuse(int32_t fd,int32_t yes) {
     return chk_error_ok;    
 }
 
+int32_t easy_port_reuse(int32_t fd,int32_t yes) {
+#ifdef SO_REUSEPORT
+    if(setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &yes, sizeof(yes))){
+        CHK_SYSLOG(LOG_ERROR,"setsockopt(SOL_SOCKET,SO_REUSEPORT) failed errno:%s",strerror(errno)); 
+        return chk_error_setsockopt;
+    }
+    return chk_error_ok;
+#else
+    CHK_SYSLOG(LOG_ERROR,"SO_REUSEPORT not support");
+    return chk_error_setsockopt;
+#endif
+}
+
+/*
+*  cBPF程序:读取处理该连接的cpu(软中断所在cpu),返回cpus中与之相同的下标,
+*  没有匹配时返回越界的下标,内核回退到哈希分配
+*/
+int32_t easy_reuseport_cpu_steer(int32_t fd,const int32_t *cpus,uint32_t count) {
+#if defined(_LINUX) && defined(SO_ATTACH_REUSEPORT_CBPF)
+    struct sock_filter *code;
+    struct sock_fprog   prog;
+    uint32_t            i,n = 0;
+    int32_t             ret = chk_error_ok;
+    if(!cpus || 0 == count || count > BPF_MAXINSNS/2 - 1) {
+        return chk_error_invaild_argument;
+    }
+    if(NULL == (code = calloc(count*2 + 2,sizeof(*code)))) {
+        return chk_error_no_memory;
+    }
+    code[n++] = (struct sock_filter)BPF_STMT(BPF_LD|BPF_W|BPF_ABS,SKF_AD_OFF + SKF_AD_CPU);
+    for(i = 0; i < count; ++i) {
+        code[n++] = (struct sock_filter)BPF_JUMP(BPF_JMP|BPF_JEQ|BPF_K,(uint32_t)cpus[i],0,1);
+        code[n++] = (struct sock_filter)BPF_STMT(BPF_RET|BPF_K,i);
+    }
+    code[n++] = (struct sock_filter)BPF_STMT(BPF_RET|BPF_K,0xffffffff);
+    prog.len    = n;
+    prog.filter = code;
+    if(setsockopt(fd,SOL_SOCKET,SO_ATTACH_REUSEPORT_CBPF,&prog,sizeof(prog))){
+        CHK_SYSLOG(LOG_ERROR,"setsockopt(SOL_SOCKET,SO_ATTACH_REUSEPORT_CBPF) failed errno:%s",strerror(errno)); 
+        ret = chk_error_setsockopt;
+    }
+    free(code);
+    return ret;
+#else
+    CHK_SYSLOG(LOG_ERROR,"SO_ATTACH_REUSEPORT_CBPF not support");
+    return chk_error_setsockopt;
+#endif
+}
+
+int32_t easy_set_incoming_cpu(int32_t fd,int32_t cpu) {
+#ifdef SO_INCOMING_CPU
+    if(setsockopt(fd,SOL_SOCKET,SO_INCOMING_CPU,&cpu,sizeof(cpu))){
+        CHK_SYSLOG(LOG_ERROR,"setsockopt(SOL_SOCKET,SO_INCOMING_CPU) failed errno:%s",strerror(errno)); 
+        return chk_error_setsockopt;
+    }
+    return chk_error_ok;
+#else
+    CHK_SYSLOG(LOG_ERROR,"SO_INCOMING_CPU not support");
+    return chk_error_setsockopt;
+#endif
+}
+
+int32_t easy_get_incoming_cpu(int32_t fd) {
+#ifdef SO_INCOMING_CPU
+    int32_t   cpu = -1;
+    socklen_t len = sizeof(cpu);
+    if(getsockopt(fd,SOL_SOCKET,SO_INCOMING_CPU,&cpu,&len)){
+        return -1;
+    }
+    return cpu;
+#else
+    return -1;
+#endif
+}
+
 int32_t easy_noblock(int32_t fd,int32_t noblock) {
     int32_t flags;
     if((flags = fcntl(fd, F_GETFL, 0)) == -1){
@@ -40,6 +40,24 @@ int32_t easy_bind(int32_t fd,chk_sockaddr *addr);
 
 int32_t easy_addr_reuse(int32_t fd,int32_t yes);
 
+//设置SO_REUSEPORT,多个套接字可以监听同一地址,由内核在它们之间分配连接
+int32_t easy_port_reuse(int32_t fd,int32_t yes);
+
+/**
+ * 给fd所在的SO_REUSEPORT组挂上cBPF程序,按连接被接收的cpu选择监听套接字:
+ * 在cpus[i]上接收的连接交给组内下标为i(第i个开始监听)的套接字,其它cpu上的连接按哈希分配
+ * @param fd 组内任意一个监听套接字
+ * @param cpus 组内每个套接字对应的cpu
+ * @param count cpus的数量
+ */
+int32_t easy_reuseport_cpu_steer(int32_t fd,const int32_t *cpus,uint32_t count);
+
+//设置SO_INCOMING_CPU,监听套接字上设置时内核优先把在该cpu上接收的连接分配给它
+int32_t easy_set_incoming_cpu(int32_t fd,int32_t cpu);
+
+//返回最后处理fd接收数据的cpu,失败返回-1
+int32_t easy_get_incoming_cpu(int32_t fd);
+
 int32_t easy_noblock(int32_t fd,int32_t noblock); 
 
 int32_t easy_close_on_exec(int32_t fd);
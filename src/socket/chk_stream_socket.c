@@ -5,8 +5,19 @@
 #include "socket/chk_socket_helper.h"
 #include "socket/chk_stream_socket.h"
 #include "event/chk_event_loop.h"
+#include "event/chk_event_loop_define.h"
 #include "socket/chk_stream_socket_define.h"
+#include "socket/chk_socket_group.h"
+#include "socket/chk_socket_group_define.h"
 
+#ifdef _LINUX
+#include <linux/errqueue.h>
+#include <sys/sendfile.h>
+#endif
+
+#if defined(_LINUX) && defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+#define CHK_ZEROCOPY
+#endif
 
 #ifndef  cast
 # define  cast(T,P) ((T)(P))
@@ -15,6 +26,75 @@
 uint32_t chunkcount  = 0;
 uint32_t buffercount = 0;
 
+/*
+*  发送用的iovec数组,每线程一个.填充(prepare_send)之后立即在同一线程中写出,
+*  所以不需要每个socket持有一份
+*/
+static __thread struct iovec t_wsendbuf[MAX_WBAF];
+
+/*
+*  stream_socket对象池,每线程一个.socket可能在另一个线程(迁移之后)释放,
+*  放回释放线程的池中,每线程只缓存MAX_FREE_STREAM_SOCKET个,多余的直接free
+*/
+typedef struct socket_pool {
+	chk_list_entry *head;
+	uint32_t        size;
+}socket_pool;
+
+static pthread_key_t   socket_pool_key;
+static pthread_once_t  socket_pool_once = PTHREAD_ONCE_INIT;
+static __thread socket_pool *t_socket_pool = NULL;
+
+static void socket_pool_destructor(void *ud) {
+	socket_pool    *pool = cast(socket_pool*,ud);
+	chk_list_entry *n;
+	while((n = pool->head)) {
+		pool->head = n->next;
+		free(n);
+	}
+	free(pool);
+	t_socket_pool = NULL;
+}
+
+static void socket_pool_key_create() {
+	pthread_key_create(&socket_pool_key,socket_pool_destructor);
+}
+
+static inline socket_pool *get_socket_pool() {
+	if(!t_socket_pool) {
+		pthread_once(&socket_pool_once,socket_pool_key_create);
+		t_socket_pool = calloc(1,sizeof(*t_socket_pool));
+		if(t_socket_pool) {
+			pthread_setspecific(socket_pool_key,t_socket_pool);
+		}
+	}
+	return t_socket_pool;
+}
+
+static inline chk_stream_socket *alloc_socket() {
+	chk_list_entry *n;
+	socket_pool    *pool = get_socket_pool();
+	if(pool && (n = pool->head)) {
+		pool->head = n->next;
+		--pool->size;
+		memset(n,0,sizeof(chk_stream_socket));
+		return cast(chk_stream_socket*,n);
+	}
+	return calloc(1,sizeof(chk_stream_socket));
+}
+
+static inline void free_socket(chk_stream_socket *s) {
+	chk_list_entry *n = cast(chk_list_entry*,s);
+	socket_pool    *pool = get_socket_pool();
+	if(pool && pool->size < MAX_FREE_STREAM_SOCKET) {
+		n->next = pool->head;
+		pool->head = n;
+		++pool->size;
+	} else {
+		free(s);
+	}
+}
+
 /*status*/
 enum{
 	SOCKET_RCLOSE    	 = 1 << 1,  /*本端读关闭,写等剩余包发完关闭*/
@@ -76,6 +156,77 @@ static inline int32_t send_list_empty(chk_stream_socket *s) {
 	return 0;
 }
 
+static inline int32_t is_send_group(chk_bytebuffer *b) {
+	return b && (b->flags & SEND_GROUP);
+}
+
+/*消息中从pos开始的数据所在的chunk,pos转换为chunk内的下标*/
+static inline chk_bytechunk *group_msg_seek(chk_group_msg *msg,uint32_t *pos) {
+	chk_bytechunk *chunk = msg->b->head;
+	*pos += msg->b->spos;
+	while(chunk && *pos >= chunk->cap) {
+		*pos -= chunk->cap;
+		chunk = chunk->next;
+	}
+	return chunk;
+}
+
+/*
+*  把组游标中待发送的消息从t_wsendbuf[i]开始填入,one_msg非0时只填当前消息的剩余部分.
+*  返回填充之后的iovec数量
+*/
+static int32_t prepare_send_group(chk_stream_socket *s,chk_group_member *m,int32_t i,uint32_t *send_size,int32_t one_msg) {
+	chk_group_msg *msg;
+	chk_bytechunk *chunk;
+	uint32_t       pos,datasize,size,sent = m->pos;
+	for(msg = m->msg; msg && i < MAX_WBAF && *send_size < MAX_SEND_SIZE; msg = msg->next) {
+		pos      = sent;
+		chunk    = group_msg_seek(msg,&pos);
+		datasize = msg->b->datasize - sent;
+		while(i < MAX_WBAF && chunk && datasize && *send_size < MAX_SEND_SIZE) {
+			t_wsendbuf[i].iov_base = chunk->data + pos;
+			size = MIN(chunk->cap - pos,datasize);
+			size = MIN(size,MAX_SEND_SIZE - *send_size);
+			datasize   -= size;
+			*send_size += size;
+			t_wsendbuf[i].iov_len = size;
+			++i;
+			if(s->ssl.ssl) {
+				return i;
+			}
+			chunk = chunk->next;
+			pos = 0;
+		}
+		if(one_msg || msg == m->last) {
+			break;
+		}
+		sent = 0;
+	}
+	return i;
+}
+
+/*组游标发送了bytes字节,返回游标消耗的字节数,游标中的消息全部发送完时出列*/
+static uint32_t update_send_group(chk_stream_socket *s,chk_group_member *m,uint32_t bytes) {
+	uint32_t used = 0,remain;
+	while(m->msg && bytes) {
+		remain = m->msg->b->datasize - m->pos;
+		if(bytes < remain) {
+			m->pos += bytes;
+			used   += bytes;
+			break;
+		}
+		bytes -= remain;
+		used  += remain;
+		chk_group_member_advance(m);
+	}
+	if(!m->msg) {
+		chk_list_pop(&s->send_list);
+	}
+	return used;
+}
+
+static void send_entry_del(chk_stream_socket *s,chk_bytebuffer *b);
+
 /*数据发送成功之后更新buffer list信息*/
 static inline void update_send_list(chk_stream_socket *s,int32_t _bytes) {
 	chk_bytebuffer *b;
@@ -90,11 +241,15 @@ static inline void update_send_list(chk_stream_socket *s,int32_t _bytes) {
 	}
 	for(;bytes;) {
 		b = cast(chk_bytebuffer*,chk_list_begin(list));
+		if(b->flags & SEND_GROUP) {
+			bytes -= update_send_group(s,cast(chk_group_member*,b),bytes);
+			continue;
+		}
 		if(bytes >= b->datasize) {
 			/*一个buffer已经发送完毕,将其出列并删除*/
 			chk_list_pop(list);
 			bytes -= b->datasize;
-			chk_bytebuffer_del(b);
+			send_entry_del(s,b);
 		}else {
 			/*只完成一个buffer中部分数据的发送*/
 			for(;bytes;) {
@@ -114,13 +269,232 @@ static inline void update_send_list(chk_stream_socket *s,int32_t _bytes) {
 	}
 }
 
-/*准备缓冲用于发起写请求*/
+/*
+*  chk_stream_socket_sendfile排入send_list的文件段,以SEND_FILE标记的chk_bytebuffer开头,
+*  其datasize/internal保持为0,待发送的范围记录在offset/remain中
+*/
+typedef struct {
+	chk_bytebuffer b;
+	int32_t        fd;          //dup得到的描述符,文件段发送完毕后关闭
+	int8_t         use_read;    //sendfile不可用,以pread读入buffer再发送
+	uint64_t       offset;
+	uint64_t       remain;
+	uint64_t       sent;
+}send_file;
+
+static inline int32_t is_send_file(chk_bytebuffer *b) {
+	return b && (b->flags & SEND_FILE);
+}
+
+/*
+*  chk_stream_socket_send_keyed排入send_list的buffer,数据从调用者的buffer转移过来.
+*  同key的新buffer到达时如果它还没有开始发送(internal == datasize),以新的数据替换
+*/
+typedef struct chk_keyed_buffer {
+	chk_bytebuffer           b;
+	uint64_t                 key;
+	struct chk_keyed_buffer *hnext;       //索引中同一个桶的下一个
+}keyed_buffer;
+
+#define KEYED_INIT_BUCKETS 16
+
+static inline uint32_t keyed_hash(uint64_t key,uint32_t mask) {
+	return cast(uint32_t,(key * 0x9E3779B97F4A7C15ULL) >> 32) & mask;
+}
+
+static keyed_buffer *keyed_find(chk_coalesce *c,uint64_t key) {
+	keyed_buffer *k;
+	if(!c->buckets) {
+		return NULL;
+	}
+	for(k = c->buckets[keyed_hash(key,c->mask)]; k; k = k->hnext) {
+		if(k->key == key) {
+			return k;
+		}
+	}
+	return NULL;
+}
+
+/*key数超过桶数时桶数加倍,扩张失败时继续使用原来的桶*/
+static int32_t keyed_insert(chk_coalesce *c,keyed_buffer *k) {
+	keyed_buffer **buckets,*n;
+	uint32_t       i,h,count;
+	if(!c->buckets || c->size > c->mask) {
+		count = c->buckets ? (c->mask + 1) * 2 : KEYED_INIT_BUCKETS;
+		if(!(buckets = calloc(count,sizeof(*buckets)))) {
+			if(!c->buckets) {
+				return -1;
+			}
+		} else {
+			for(i = 0; c->buckets && i <= c->mask; ++i) {
+				while((n = c->buckets[i])) {
+					c->buckets[i] = n->hnext;
+					h = keyed_hash(n->key,count - 1);
+					n->hnext = buckets[h];
+					buckets[h] = n;
+				}
+			}
+			free(c->buckets);
+			c->buckets = buckets;
+			c->mask    = count - 1;
+		}
+	}
+	h = keyed_hash(k->key,c->mask);
+	k->hnext = c->buckets[h];
+	c->buckets[h] = k;
+	++c->size;
+	return 0;
+}
+
+static void keyed_remove(chk_coalesce *c,keyed_buffer *k) {
+	keyed_buffer **pp;
+	if(!c->buckets) {
+		return;
+	}
+	for(pp = &c->buckets[keyed_hash(k->key,c->mask)]; *pp; pp = &(*pp)->hnext) {
+		if(*pp == k) {
+			*pp = k->hnext;
+			k->hnext = NULL;
+			--c->size;
+			return;
+		}
+	}
+}
+
+/*把b的数据转移到k,原来的数据被释放,b被删除(b可以是交接用的keyed_buffer)*/
+static void keyed_take(keyed_buffer *k,chk_bytebuffer *b) {
+	chk_bytebuffer_finalize(&k->b);
+	k->b.head       = b->head;
+	k->b.tail       = b->tail;
+	k->b.spos       = b->spos;
+	k->b.datasize   = b->datasize;
+	k->b.internal   = b->datasize;
+	k->b.append_pos = b->append_pos;
+	k->b.flags      = SEND_KEYED | (b->flags & NEED_COPY_ON_WRITE);
+	b->head = NULL;
+	if(b->flags & SEND_KEYED) {
+		free(b);
+	} else {
+		chk_bytebuffer_del(b);
+	}
+}
+
+static void send_entry_del(chk_stream_socket *s,chk_bytebuffer *b) {
+	if(b->flags & SEND_FILE) {
+		close(cast(send_file*,b)->fd);
+		free(b);
+	} else if(b->flags & SEND_KEYED) {
+		/*inbox中交接的keyed_buffer还不在索引中*/
+		if(s->coalesce) {
+			keyed_remove(s->coalesce,cast(keyed_buffer*,b));
+		}
+		chk_bytebuffer_finalize(b);
+		free(b);
+	} else if(b->flags & SEND_GROUP) {
+		/*游标属于组成员,只释放它引用的消息*/
+		chk_group_member_drop(cast(chk_group_member*,b));
+	} else {
+		chk_bytebuffer_del(b);
+	}
+}
+
+/*
+*  返回接下来要发送的文件段,已经开始发送的文件段必须发送完才能插入urgent_list中的数据
+*/
+static inline send_file *front_file(chk_stream_socket *s) {
+	chk_bytebuffer *b = cast(chk_bytebuffer*,chk_list_begin(&s->send_list));
+	if(!is_send_file(b)) {
+		return NULL;
+	}
+	if(chk_list_empty(&s->urgent_list) || cast(send_file*,b)->sent > 0) {
+		return cast(send_file*,b);
+	}
+	return NULL;
+}
+
+static inline int32_t file_use_read(chk_stream_socket *s,send_file *f) {
+#ifdef _LINUX
+	return f->use_read || s->ssl.ssl;
+#else
+	return 1;
+#endif
+}
+
+/*
+*  文件段已发送(或读入buffer)bytes字节,全部完成时出列
+*/
+static void update_send_file(chk_stream_socket *s,send_file *f,uint32_t bytes) {
+	f->offset += bytes;
+	f->remain -= bytes;
+	f->sent   += bytes;
+	if(0 == f->remain) {
+		chk_list_pop(&s->send_list);
+		send_entry_del(s,cast(chk_bytebuffer*,f));
+	}
+}
+
+/*
+*  ssl或sendfile不可用时,从文件段读取一块数据作为普通buffer放到send_list头部.
+*  internal置0使其被当作已开始发送的buffer,发送完之前不会插入urgent_list中的数据
+*/
+static int32_t load_file_block(chk_stream_socket *s,send_file *f) {
+	chk_bytechunk  *chunk;
+	chk_bytebuffer *b;
+	int32_t         bytes;
+	uint32_t        size = cast(uint32_t,MIN(f->remain,MAX_SEND_SIZE));
+	if(!(chunk = chk_bytechunk_new(NULL,size))) {
+		CHK_SYSLOG(LOG_ERROR,"chk_bytechunk_new() failed size:%u",size);
+		errno = ENOMEM;
+		return -1;
+	}
+	bytes = TEMP_FAILURE_RETRY(pread(f->fd,chunk->data,size,cast(off_t,f->offset)));
+	if(bytes <= 0) {
+		if(bytes == 0) {
+			CHK_SYSLOG(LOG_ERROR,"fd:%d file shorter than requested,remain:%llu",s->fd,cast(unsigned long long,f->remain));
+			errno = EIO;
+		}
+		chk_bytechunk_release(chunk);
+		return -1;
+	}
+	b = chk_bytebuffer_new_bychunk(chunk,0,cast(uint32_t,bytes));
+	chk_bytechunk_release(chunk);
+	if(!b) {
+		CHK_SYSLOG(LOG_ERROR,"chk_bytebuffer_new_bychunk() failed");
+		errno = ENOMEM;
+		return -1;
+	}
+	update_send_file(s,f,cast(uint32_t,bytes));
+	b->internal = 0;
+	s->send_bytes += b->datasize;
+	chk_list_pushfront(&s->send_list,cast(chk_list_entry*,b));
+	return 0;
+}
+
+#ifdef _LINUX
+static int32_t do_sendfile(chk_stream_socket *s,send_file *f,uint32_t size) {
+	off_t   offset = cast(off_t,f->offset);
+	int32_t bytes;
+	errno = 0;
+	bytes = TEMP_FAILURE_RETRY(sendfile(s->fd,f->fd,&offset,size));
+	if(bytes == 0) {
+		CHK_SYSLOG(LOG_ERROR,"fd:%d file shorter than requested,remain:%llu",s->fd,cast(unsigned long long,f->remain));
+		errno = EIO;
+	}
+	return bytes;
+}
+#endif
+
+/*准备缓冲用于发起写请求,队首是需要读入的文件段时先读入一块,失败返回-1*/
 static inline int32_t prepare_send(chk_stream_socket *s) {
 	int32_t          i = 0;
 	chk_bytebuffer  *b;
 	chk_bytechunk   *chunk;
 	uint32_t    datasize,size,pos,send_size;
+	send_file  *f;
 	send_size = 0;
+	if((f = front_file(s)) && file_use_read(s,f) && 0 != load_file_block(s,f)) {
+		return -1;
+	}
 	b = cast(chk_bytebuffer*,chk_list_begin(&s->send_list));
 
 	do{
@@ -129,6 +503,13 @@ static inline int32_t prepare_send(chk_stream_socket *s) {
 			/*没有urgent buffer需要发送*/
 			break;
 		}
+		if(is_send_group(b)) {
+			if(0 == cast(chk_group_member*,b)->pos) {
+				break;
+			}
+			/*先把游标中只发送了部分的消息发送出去*/
+			return prepare_send_group(s,cast(chk_group_member*,b),0,&send_size,1);
+		}
 		if(!b || b->internal == b->datasize){
 			/*send list中没有只完成部分发送的buffer*/
 			break;
@@ -138,11 +519,11 @@ static inline int32_t prepare_send(chk_stream_socket *s) {
 		chunk = b->head;
 		datasize = b->datasize;
 		while(i < MAX_WBAF && chunk && datasize) {
-			s->wsendbuf[i].iov_base = chunk->data + pos;
+			t_wsendbuf[i].iov_base = chunk->data + pos;
 			size = MIN(chunk->cap - pos,datasize);
 			datasize    -= size;
 			send_size   += size;
-			s->wsendbuf[i].iov_len = size;
+			t_wsendbuf[i].iov_len = size;
 			++i;
 
 			if(s->ssl.ssl) {
@@ -161,17 +542,26 @@ static inline int32_t prepare_send(chk_stream_socket *s) {
 	}else
 		s->sending_urgent = 0;
 
-	while(b && i < MAX_WBAF && send_size < MAX_SEND_SIZE) {
+	/*文件段之前的buffer先发送,文件段留到下一次写*/
+	while(b && !is_send_file(b) && i < MAX_WBAF && send_size < MAX_SEND_SIZE) {
+		if(is_send_group(b)) {
+			i = prepare_send_group(s,cast(chk_group_member*,b),i,&send_size,0);
+			if(s->ssl.ssl) {
+				break;
+			}
+			b = cast(chk_bytebuffer*,cast(chk_list_entry*,b)->next);
+			continue;
+		}
 		pos   = b->spos;
 		chunk = b->head;
 		datasize = b->datasize;
 		while(i < MAX_WBAF && chunk && datasize) {
-			s->wsendbuf[i].iov_base = chunk->data + pos;
+			t_wsendbuf[i].iov_base = chunk->data + pos;
 			size = MIN(chunk->cap - pos,datasize);
 			size = MIN(size,MAX_SEND_SIZE - send_size);
 			datasize    -= size;
 			send_size   += size;
-			s->wsendbuf[i].iov_len = size;
+			t_wsendbuf[i].iov_len = size;
 			++i;
 			if(s->ssl.ssl) {
 				break;
@@ -185,12 +575,151 @@ static inline int32_t prepare_send(chk_stream_socket *s) {
 	return i;
 }
 
+static inline int32_t zc_pending(chk_stream_socket *s) {
+	return s->zc && !chk_list_empty(&s->zc->pending);
+}
+
+/*没有待发送的数据,也没有等待完成通知的zerocopy发送*/
+static inline int32_t send_done(chk_stream_socket *s) {
+	return send_list_empty(s) && !zc_pending(s);
+}
+
+#ifdef CHK_ZEROCOPY
+
+typedef struct {
+	chk_list_entry entry;
+	uint32_t       seq;
+	uint32_t       count;
+	int8_t         done;
+	chk_bytechunk *chunks[];
+}zc_hold;
+
+/*
+*  引用刚以MSG_ZEROCOPY发送出去的bytes字节所在的chunk,遍历方式与update_send_list相同,
+*  所以必须在update_send_list之前调用.每个iovec对应一个chunk片段,h预留了bc个位置
+*/
+static void zc_hold_chunks(chk_stream_socket *s,zc_hold *h,uint32_t bytes,int32_t bc) {
+	chk_bytebuffer *b;
+	chk_bytechunk  *chunk;
+	uint32_t        pos,remain,size;
+	h->seq   = s->zc->next_seq++;
+	h->count = 0;
+	h->done  = 0;
+	b = cast(chk_bytebuffer*,chk_list_begin(s->sending_urgent ? &s->urgent_list : &s->send_list));
+	while(bytes && b) {
+		chunk  = b->head;
+		pos    = b->spos;
+		remain = MIN(bytes,b->datasize);
+		bytes -= remain;
+		while(remain && chunk && h->count < cast(uint32_t,bc)) {
+			size = MIN(chunk->cap - pos,remain);
+			h->chunks[h->count++] = chk_bytechunk_retain(chunk);
+			remain -= size;
+			chunk = chunk->next;
+			pos = 0;
+		}
+		b = cast(chk_bytebuffer*,cast(chk_list_entry*,b)->next);
+	}
+	chk_list_pushback(&s->zc->pending,cast(chk_list_entry*,h));
+	++s->zc->sends;
+}
+
+static void zc_release_hold(zc_hold *h) {
+	uint32_t i;
+	for(i = 0; i < h->count; ++i) {
+		chk_bytechunk_release(h->chunks[i]);
+	}
+	free(h);
+}
+
+/*标记[lo,hi]区间内的发送已完成,TCP的通知通常按序到达,从队首释放已完成的发送*/
+static void zc_complete(chk_stream_socket *s,uint32_t lo,uint32_t hi) {
+	chk_list_entry *e;
+	zc_hold        *h;
+	for(e = chk_list_begin(&s->zc->pending); e; e = e->next) {
+		h = cast(zc_hold*,e);
+		if(cast(int32_t,h->seq - lo) >= 0 && cast(int32_t,hi - h->seq) >= 0) {
+			h->done = 1;
+		}
+	}
+	while((h = cast(zc_hold*,chk_list_begin(&s->zc->pending))) && h->done) {
+		chk_list_pop(&s->zc->pending);
+		zc_release_hold(h);
+	}
+}
+
+/*从错误队列中读取完成通知*/
+static void zc_reap(chk_stream_socket *s) {
+	struct msghdr             msg;
+	struct cmsghdr           *cm;
+	struct sock_extended_err *serr;
+	char                      control[128];
+	while(zc_pending(s)) {
+		memset(&msg,0,sizeof(msg));
+		msg.msg_control    = control;
+		msg.msg_controllen = sizeof(control);
+		if(0 > TEMP_FAILURE_RETRY(recvmsg(s->fd,&msg,MSG_ERRQUEUE | MSG_DONTWAIT))) {
+			break;
+		}
+		for(cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg,cm)) {
+			if(!((cm->cmsg_level == SOL_IP && cm->cmsg_type == IP_RECVERR) ||
+			     (cm->cmsg_level == SOL_IPV6 && cm->cmsg_type == IPV6_RECVERR))) {
+				continue;
+			}
+			serr = cast(struct sock_extended_err*,CMSG_DATA(cm));
+			if(serr->ee_errno != 0 || serr->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+				continue;
+			}
+			if(serr->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+				/*内核做了拷贝(例如发往本机),zerocopy只有额外开销,之后退回拷贝发送*/
+				if(0 == s->zc->copied++) {
+					CHK_SYSLOG(LOG_INFO,"fd:%d MSG_ZEROCOPY fall back to copy",s->fd);
+				}
+				s->zc->threshold = 0;
+			}
+			zc_complete(s,serr->ee_info,serr->ee_data);
+		}
+	}
+	if(!zc_pending(s) && send_list_empty(s) && (s->status & SOCKET_RCLOSE)) {
+		s->status |= SOCKET_WCLOSE;
+	}
+}
+
+/*
+*  以MSG_ZEROCOPY发送,成功时在更新发送列表之前引用发送的chunk.
+*  记录分配失败或optmem不足(ENOBUFS)时退回拷贝发送
+*/
+static int32_t zc_write(chk_stream_socket *s,int32_t bc) {
+	struct msghdr msg;
+	int32_t       bytes;
+	zc_hold      *h = malloc(sizeof(*h) + sizeof(chk_bytechunk*) * bc);
+	if(!h) {
+		return TEMP_FAILURE_RETRY(writev(s->fd,&t_wsendbuf[0],bc));
+	}
+	memset(&msg,0,sizeof(msg));
+	msg.msg_iov    = &t_wsendbuf[0];
+	msg.msg_iovlen = bc;
+	bytes = TEMP_FAILURE_RETRY(sendmsg(s->fd,&msg,MSG_ZEROCOPY));
+	if(bytes > 0) {
+		zc_hold_chunks(s,h,cast(uint32_t,bytes),bc);
+		return bytes;
+	}
+	free(h);
+	if(bytes < 0 && errno == ENOBUFS) {
+		errno = 0;
+		return TEMP_FAILURE_RETRY(writev(s->fd,&t_wsendbuf[0],bc));
+	}
+	return bytes;
+}
+
+#endif
+
 /*准备缓冲用于读*/
 static inline int32_t prepare_recv(chk_stream_socket *s) {
 	chk_bytechunk  *chunk;
 	int32_t         i = 0;
 	uint32_t        recv_size,pos,recv_buffer_size;
-	recv_buffer_size = s->option.recv_buffer_size;
+	recv_buffer_size = s->recv_stats.recv_buffer_size;
 	if(!s->next_recv_buf) {
 		s->next_recv_buf = chk_bytechunk_new(NULL,recv_buffer_size);
 		if(!s->next_recv_buf){
@@ -222,6 +751,130 @@ static inline int32_t prepare_recv(chk_stream_socket *s) {
 	return i;
 }
 
+/*
+*  惰性接收模式每线程的临时缓冲.大块读取时chunk直接交给socket,下次使用时重新分配
+*/
+static pthread_key_t   recv_scratch_key;
+static pthread_once_t  recv_scratch_once = PTHREAD_ONCE_INIT;
+static __thread chk_bytechunk *t_recv_scratch = NULL;
+
+static void recv_scratch_destructor(void *ud) {
+	if(t_recv_scratch) {
+		chk_bytechunk_release(t_recv_scratch);
+		t_recv_scratch = NULL;
+	}
+}
+
+static void recv_scratch_key_create() {
+	pthread_key_create(&recv_scratch_key,recv_scratch_destructor);
+}
+
+static inline int32_t prepare_lazy_recv(chk_stream_socket *s) {
+	if(!t_recv_scratch) {
+		pthread_once(&recv_scratch_once,recv_scratch_key_create);
+		if(!(t_recv_scratch = chk_bytechunk_new(NULL,CHK_RECV_SCRATCH_SIZE))) {
+			CHK_SYSLOG(LOG_ERROR,"chk_bytechunk_new() failed size:%d",CHK_RECV_SCRATCH_SIZE);
+			return -1;
+		}
+		pthread_setspecific(recv_scratch_key,t_recv_scratch);
+	}
+	s->wrecvbuf[0].iov_base = t_recv_scratch->data;
+	s->wrecvbuf[0].iov_len  = t_recv_scratch->cap;
+	return 1;
+}
+
+/*
+*  把读入临时缓冲的bytes字节接到socket的接收chunk链上,布局与普通模式相同:
+*  先填满上次剩余的空间,余下的放入新chunk(超过临时缓冲一半时直接使用临时缓冲,否则按大小拷贝).
+*  完成后next_recv_buf/next_recv_pos指向新数据的起始位置
+*/
+static int32_t lazy_recv_commit(chk_stream_socket *s,uint32_t bytes) {
+	chk_bytechunk *tail = s->next_recv_buf;
+	chk_bytechunk *c;
+	char          *data = t_recv_scratch->data;
+	uint32_t       size;
+	if(tail && s->next_recv_pos < tail->cap) {
+		size = MIN(tail->cap - s->next_recv_pos,bytes);
+		memcpy(tail->data + s->next_recv_pos,data,size);
+		if(0 == (bytes -= size)) {
+			return 0;
+		}
+		data += size;
+	}
+	if(data == t_recv_scratch->data && bytes > t_recv_scratch->cap / 2) {
+		c = t_recv_scratch;
+		t_recv_scratch = NULL;
+		pthread_setspecific(recv_scratch_key,NULL);
+	} else if(!(c = chk_bytechunk_new(data,bytes))) {
+		CHK_SYSLOG(LOG_ERROR,"chk_bytechunk_new() failed size:%u",bytes);
+		return -1;
+	}
+	if(!tail) {
+		s->next_recv_buf = c;
+		s->next_recv_pos = 0;
+	} else {
+		tail->next = c;
+		if(s->next_recv_pos >= tail->cap) {
+			s->next_recv_buf = chk_bytechunk_retain(c);
+			s->next_recv_pos = 0;
+			chk_bytechunk_release(tail);
+		}
+	}
+	return 0;
+}
+
+/*
+*  惰性接收模式下,接收chunk只被socket自己引用(解包器没有残留数据,回调也没有保留buffer)时释放
+*/
+static inline void lazy_recv_idle(chk_stream_socket *s) {
+	if(s->option.lazy_recv && s->next_recv_buf && 1 == s->next_recv_buf->refcount) {
+		chk_bytechunk_release(s->next_recv_buf);
+		s->next_recv_buf = NULL;
+		s->next_recv_pos = 0;
+	}
+}
+
+static inline uint32_t recv_size_bucket(uint32_t bytes) {
+	uint32_t i = 0;
+	bytes >>= 7;
+	while(bytes && i < CHK_RECV_SIZE_BUCKETS - 1) {
+		bytes >>= 1;
+		++i;
+	}
+	return i;
+}
+
+/*
+*  记录一次读取.开启自适应时,读满提供的缓冲说明缓冲偏小,之后分配的chunk倍增直到recv_buffer_max;
+*  连续CHK_RECV_SHRINK_WINDOW次读取都不超过当前大小的1/4时减半,不低于option.recv_buffer_size.
+*  已经分配的chunk不受影响
+*/
+static inline void recv_adapt(chk_stream_socket *s,uint32_t bytes,uint32_t provided) {
+	chk_stream_socket_recv_stats *stats = &s->recv_stats;
+	++stats->reads;
+	stats->bytes += bytes;
+	++stats->read_size[recv_size_bucket(bytes)];
+	if(s->option.recv_buffer_max <= s->option.recv_buffer_size) {
+		return;
+	}
+	if(bytes >= provided && bytes >= stats->recv_buffer_size && stats->recv_buffer_size < s->option.recv_buffer_max) {
+		stats->recv_buffer_size <<= 1;
+		++stats->grows;
+		s->recv_window_reads = 0;
+		s->recv_window_max = 0;
+		return;
+	}
+	s->recv_window_max = MAX(s->recv_window_max,bytes);
+	if(++s->recv_window_reads >= CHK_RECV_SHRINK_WINDOW) {
+		if(s->recv_window_max <= stats->recv_buffer_size / 4 && stats->recv_buffer_size > s->option.recv_buffer_size) {
+			stats->recv_buffer_size >>= 1;
+			++stats->shrinks;
+		}
+		s->recv_window_reads = 0;
+		s->recv_window_max = 0;
+	}
+}
+
 /*数据接收完成,更新接收缓冲信息*/
 static inline int32_t update_next_recv_pos(chk_stream_socket *s,int32_t bytes) {
 	uint32_t       size;
@@ -232,12 +885,16 @@ static inline int32_t update_next_recv_pos(chk_stream_socket *s,int32_t bytes) {
 		s->next_recv_pos += size;
 		bytes -= size;
 		if(s->next_recv_pos >= head->cap) {
-			s->next_recv_pos = 0;
 			head = s->next_recv_buf;			
+			if(!head->next && s->option.lazy_recv) {
+				/*惰性接收模式在下一次读取时再接上新的chunk*/
+				break;
+			}
+			s->next_recv_pos = 0;
 			if(!head->next){
-				head->next = chk_bytechunk_new(NULL,s->option.recv_buffer_size);
+				head->next = chk_bytechunk_new(NULL,s->recv_stats.recv_buffer_size);
 				if(!head->next){
-					CHK_SYSLOG(LOG_ERROR,"chk_bytechunk_new() failed recv_buffer_size:%d",s->option.recv_buffer_size);						
+					CHK_SYSLOG(LOG_ERROR,"chk_bytechunk_new() failed recv_buffer_size:%d",s->recv_stats.recv_buffer_size);						
 					return -1;
 				}
 			}
@@ -250,6 +907,9 @@ static inline int32_t update_next_recv_pos(chk_stream_socket *s,int32_t bytes) {
 
 static void release_socket(chk_stream_socket *s) {
 	chk_bytebuffer  *b;
+#ifdef CHK_ZEROCOPY
+	zc_hold         *h;
+#endif
 	chk_decoder *d = s->option.decoder;	
 	chk_unwatch_handle(cast(chk_handle*,s));	
 	if(s->next_recv_buf) chk_bytechunk_release(s->next_recv_buf);
@@ -257,9 +917,35 @@ static void release_socket(chk_stream_socket *s) {
 	if(s->delay_close_timer) chk_timer_unregister(s->delay_close_timer);
 	
 	while((b = cast(chk_bytebuffer*,chk_list_pop(&s->send_list))))
-		chk_bytebuffer_del(b);
+		send_entry_del(s,b);
 	while((b = cast(chk_bytebuffer*,chk_list_pop(&s->urgent_list))))
 		chk_bytebuffer_del(b);
+	if(s->inbox) {
+		while((b = cast(chk_bytebuffer*,chk_list_pop(s->inbox))))
+			send_entry_del(s,b);
+		free(s->inbox);
+	}
+	if(s->groups) {
+		chk_socket_group_socket_release(s);
+	}
+
+#ifdef CHK_ZEROCOPY
+	if(s->zc) {
+		/*
+		* 关闭时仍未完成的zerocopy发送:先收取已到达的通知,剩余的chunk只能提前释放,
+		* 需要保证数据完整时应延迟关闭(chk_stream_socket_close的delay)
+		*/
+		zc_reap(s);
+		while((h = cast(zc_hold*,chk_list_pop(&s->zc->pending))))
+			zc_release_hold(h);
+	}
+#endif
+	free(s->zc);
+	free(s->water);
+	if(s->coalesce) {
+		free(s->coalesce->buckets);
+		free(s->coalesce);
+	}
 
 	if(s->fd >= 0) { 
 		close(s->fd);
@@ -273,11 +959,14 @@ static void release_socket(chk_stream_socket *s) {
        	SSL_free(s->ssl.ssl);
 	}
 
+	free(s->addr_local);
+	free(s->addr_peer);
+
 	if(s->close_callback.close_callback) {
 		s->close_callback.close_callback(s,s->close_callback.ud);
 	}
 
-	free(s);
+	free_socket(s);
 }
 
 static int32_t delay_close_timer_cb(uint64_t tick,chk_ud ud) {
@@ -309,8 +998,10 @@ void chk_stream_socket_close(chk_stream_socket *s,uint32_t delay) {
 
 	s->closed = 1;
 	s->status |= SOCKET_RCLOSE;
-	if(!(s->status & SOCKET_WCLOSE) && delay > 0 && !send_list_empty(s) && s->loop) {
+	if(!(s->status & SOCKET_WCLOSE) && delay > 0 && !send_done(s) && s->loop) {
 		chk_disable_read(cast(chk_handle*,s));
+		/*共享epoll上的socket之后可能由其它worker处理,先固定到当前loop,保证定时器和剩余的写事件在同一线程*/
+		chk_loop_pin_handle(cast(chk_handle*,s));
 		/*数据还没发送完,设置delay豪秒超时等待数据发送出去*/
 		s->delay_close_timer = chk_loop_addtimer(s->loop,delay,delay_close_timer_cb,chk_ud_make_void(s));
 	} else {
@@ -360,6 +1051,8 @@ static int32_t loop_add(chk_event_loop *e,chk_handle *h,chk_event_callback cb) {
 		flags = CHK_EVENT_READ | CHK_EVENT_WRITE;
 	else
 		flags = CHK_EVENT_READ;	
+	if(s->option.edge_trigger)
+		flags |= CHK_EVENT_ET;
 	if(chk_error_ok == (ret = chk_watch_handle(e,h,flags))) {
 		easy_noblock(h->fd,1);
 		s->cb = cast(chk_stream_socket_cb,cb);
@@ -379,10 +1072,19 @@ static int32_t ssl_again(int32_t ssl_error) {
 	}
 }
 
+static inline uint32_t iovec_size(struct iovec *iov,int32_t bc) {
+	uint32_t size = 0;
+	int32_t  i;
+	for(i = 0; i < bc; ++i) {
+		size += iov[i].iov_len;
+	}
+	return size;
+}
+
 static int32_t do_write(chk_stream_socket *s,int32_t bc) {
 	errno = 0;
 	if(s->ssl.ssl) {
-		int32_t bytes_transfer = TEMP_FAILURE_RETRY(SSL_write(s->ssl.ssl,s->wsendbuf[0].iov_base,s->wsendbuf[0].iov_len));
+		int32_t bytes_transfer = TEMP_FAILURE_RETRY(SSL_write(s->ssl.ssl,t_wsendbuf[0].iov_base,t_wsendbuf[0].iov_len));
 		int ssl_error = SSL_get_error(s->ssl.ssl,bytes_transfer);
 		if(bytes_transfer <= 0 && ssl_again(ssl_error)){
 			errno = EAGAIN;
@@ -391,44 +1093,110 @@ static int32_t do_write(chk_stream_socket *s,int32_t bc) {
 		return bytes_transfer;
 	}
 	else{
-		return TEMP_FAILURE_RETRY(writev(s->fd,&s->wsendbuf[0],bc));
+#ifdef CHK_ZEROCOPY
+		/*组消息被多个成员共享,不能为一个成员持有到完成通知*/
+		if(s->zc && s->zc->threshold && !s->groups && iovec_size(t_wsendbuf,bc) >= s->zc->threshold) {
+			return zc_write(s,bc);
+		}
+#endif
+		return TEMP_FAILURE_RETRY(writev(s->fd,&t_wsendbuf[0],bc));
 	}
 }
 
 
-static void process_write(chk_stream_socket *s) {
-	int32_t bc,bytes;
-	bc = prepare_send(s);
-	
-	if(bc <= 0) {
-		return;
+static void write_failed(chk_stream_socket *s) {
+	s->status |= SOCKET_WCLOSE;
+	s->write_error = errno;
+	if(!(s->status & SOCKET_RCLOSE)){
+		if(chk_is_write_enable(cast(chk_handle*,s))){
+			chk_disable_write(cast(chk_handle*,s));
+		}
+		shutdown(s->fd,SHUT_RD);//触发read返回0
+		CHK_SYSLOG(LOG_ERROR,"fd:%d writev() failed errno:%s",s->fd,strerror(errno));
 	}
+}
+
+/*
+* drain为0(水平触发模式)每次事件只发起一次写.
+* drain非0时一直写到内核发送缓冲满(或出错),写满预算时返回,边缘触发模式让出handle,下一轮循环继续.
+* 队首是文件段时以sendfile发送,ssl或sendfile不可用时由prepare_send读入buffer发送
+*/
+static void process_write(chk_stream_socket *s,int32_t drain) {
+	int32_t    bc,bytes;
+	uint32_t   size,total = 0;
+	send_file *f;
+	for(;;) {
+		f = front_file(s);
+		if(f && file_use_read(s,f)) {
+			f = NULL;
+		}
+#ifdef _LINUX
+		if(f) {
+			size  = cast(uint32_t,MIN(f->remain,0x7ffff000));
+			bytes = do_sendfile(s,f,size);
+			if(bytes < 0 && (errno == EINVAL || errno == ENOSYS)) {
+				/*文件不支持sendfile,改为读入buffer发送*/
+				f->use_read = 1;
+				continue;
+			}
+		} else
+#endif
+		{
+			bc = prepare_send(s);
+			
+			if(bc < 0) {
+				write_failed(s);
+				return;
+			}
 
-	if((bytes = do_write(s,bc)) > 0) {
-		s->send_bytes -= bytes;
-		update_send_list(s,bytes);
-		/*没有数据需要发送了,停止写监听*/
-		if(send_list_empty(s)) { 
-			if(s->status & SOCKET_RCLOSE) {
-				s->status |= SOCKET_WCLOSE;
+			if(bc == 0) {
+				return;
+			}
+			size  = iovec_size(t_wsendbuf,bc);
+			bytes = do_write(s,bc);
+		}
+
+		if(bytes > 0) {
+			s->io_bytes += bytes;
+			if(f) {
+				update_send_file(s,f,cast(uint32_t,bytes));
 			} else {
-				if(s->status & SOCKET_WCLOSE) {
-					shutdown(s->fd,SHUT_WR);
+				s->send_bytes -= bytes;
+				update_send_list(s,bytes);
+			}
+			/*没有数据需要发送了,停止写监听*/
+			if(send_list_empty(s)) { 
+				if(s->status & SOCKET_RCLOSE) {
+					/*还有zerocopy发送未完成时,由zc_reap在完成通知全部到达后设置*/
+					if(!zc_pending(s)) {
+						s->status |= SOCKET_WCLOSE;
+					}
+				} else {
+					if(s->status & SOCKET_WCLOSE) {
+						shutdown(s->fd,SHUT_WR);
+					}
+					if(chk_is_write_enable(cast(chk_handle*,s))){
+						chk_disable_write(cast(chk_handle*,s));
+					}
 				}
-				if(chk_is_write_enable(cast(chk_handle*,s))){
-					chk_disable_write(cast(chk_handle*,s));
+				return;
+			}
+			if(!drain || cast(uint32_t,bytes) < size) {
+				/*只写入部分数据说明发送缓冲已满,等待下一次可写事件*/
+				return;
+			}
+			total += bytes;
+			if(total >= s->option.io_budget) {
+				if(s->option.edge_trigger) {
+					chk_loop_yield_handle(cast(chk_handle*,s),CHK_EVENT_WRITE);
 				}
+				return;
 			}
-		}
-	} else if(errno != EAGAIN) {
-		s->status |= SOCKET_WCLOSE;
-		s->write_error = errno;
-		if(!(s->status & SOCKET_RCLOSE)){
-			if(chk_is_write_enable(cast(chk_handle*,s))){
-				chk_disable_write(cast(chk_handle*,s));
+		} else {
+			if(errno != EAGAIN) {
+				write_failed(s);
 			}
-			shutdown(s->fd,SHUT_RD);//触发read返回0
-			CHK_SYSLOG(LOG_ERROR,"fd:%d writev() failed errno:%s",s->fd,strerror(errno));
+			return;
 		}
 	}
 }
@@ -449,8 +1217,13 @@ static int32_t do_read(chk_stream_socket *s,int32_t bc) {
 	}
 }
 
+/*
+* 水平触发模式每次事件只发起一次读.
+* 边缘触发模式一直读到接收缓冲为空,读满字节或包数预算时让出handle,下一轮循环继续
+*/
 static void process_read(chk_stream_socket *s) {
 	int32_t bc,bytes,unpackerr;
+	uint32_t total = 0,packets = 0;
 	chk_decoder *decoder;
 	chk_bytebuffer *b;
 
@@ -468,19 +1241,29 @@ static void process_read(chk_stream_socket *s) {
 			CHK_SYSLOG(LOG_ERROR,"ssl handshake error");
 		}
 	} else {
-		bc = prepare_recv(s);
-		if(bc <= 0) {
-			s->cb(s,NULL,chk_error_no_memory);
-			chk_loop_remove_handle((chk_handle*)s);	
-		} else {
+		for(;;) {
+			bc = s->option.lazy_recv ? prepare_lazy_recv(s) : prepare_recv(s);
+			if(bc <= 0) {
+				s->cb(s,NULL,chk_error_no_memory);
+				chk_loop_remove_handle((chk_handle*)s);
+				return;
+			}
 			bytes = do_read(s,bc);
 			if(bytes > 0) {
+				s->io_bytes += bytes;
+				recv_adapt(s,cast(uint32_t,bytes),iovec_size(s->wrecvbuf,bc));
+				if(s->option.lazy_recv && 0 != lazy_recv_commit(s,cast(uint32_t,bytes))) {
+					s->cb(s,NULL,chk_error_no_memory);
+					chk_loop_remove_handle((chk_handle*)s);
+					return;
+				}
 				decoder = s->option.decoder;
 				decoder->update(decoder,s->next_recv_buf,s->next_recv_pos,bytes);
 				for(;;) {
 					unpackerr = 0;
 					b = decoder->unpack(decoder,&unpackerr);
 					if(b) {
+						++packets;
 						s->cb(s,b,chk_error_ok);
 						chk_bytebuffer_del(b);
 						if(s->status & SOCKET_RCLOSE) { 
@@ -500,6 +1283,22 @@ static void process_read(chk_stream_socket *s) {
 						break;
 					}
 				}
+				lazy_recv_idle(s);
+				if(!s->option.edge_trigger || cast(uint32_t,bytes) < iovec_size(s->wrecvbuf,bc)) {
+					/*边缘触发时没有读满缓冲说明接收缓冲已经读空*/
+					return;
+				}
+				if(!s->loop || s->migrate_to || !chk_is_read_enable(cast(chk_handle*,s))) {
+					/*在回调中被移出loop,请求了迁移或暂停了读*/
+					return;
+				}
+				total += bytes;
+				if(total >= s->option.io_budget || packets >= s->option.packet_budget) {
+					chk_loop_yield_handle(cast(chk_handle*,s),CHK_EVENT_READ);
+					return;
+				}
+			} else if(errno == EAGAIN) {
+				return;
 			} else if(bytes == 0) {
 				chk_disable_read(cast(chk_handle*,s));
 				if(s->write_error != 0) {
@@ -512,20 +1311,134 @@ static void process_read(chk_stream_socket *s) {
 					s->cb(s,NULL,chk_error_eof);
 					chk_disable_read((chk_handle*)s);
 				}
+				return;
 			} else {
 				s->status |= (SOCKET_RCLOSE | SOCKET_WCLOSE);
 				CHK_SYSLOG(LOG_ERROR,"read failed fd:%d,errno:%s",s->fd,strerror(errno)); 
 				s->cb(s,NULL,chk_error_stream_read);			
 				chk_loop_remove_handle((chk_handle*)s);
+				return;
 			}
 		}
 	}
 }
 
+#ifdef TCP_CORK
+#	define CHK_TCP_CORK TCP_CORK
+#elif defined(TCP_NOPUSH)
+#	define CHK_TCP_CORK TCP_NOPUSH
+#endif
+
+static inline int32_t set_tcp_cork(chk_stream_socket *s,int optval) {
+#ifdef CHK_TCP_CORK
+	return setsockopt(s->fd,IPPROTO_TCP,CHK_TCP_CORK,&optval,(socklen_t)(sizeof optval));
+#else
+	return -1;
+#endif
+}
+
+/*队列中的数据需要多次写才能发完:超过一次writev的上限,包含文件段,或者ssl的多个buffer*/
+static int32_t flush_need_cork(chk_stream_socket *s) {
+	chk_list_entry *entry;
+	uint32_t        count = 0;
+	if(s->send_bytes > MAX_SEND_SIZE || (!chk_list_empty(&s->urgent_list) && !chk_list_empty(&s->send_list))) {
+		return 1;
+	}
+	chk_list_foreach(&s->send_list,entry) {
+		if(is_send_file(cast(chk_bytebuffer*,entry)) || (s->ssl.ssl && ++count > 1)) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+/*
+*  cork模式在本轮循环结束时写出排入的数据,一直写到发送完,发送缓冲满或用完预算,剩余的数据等待可写事件.
+*  需要多次写时打开TCP_CORK,各次写的数据合并成完整的报文段,写完之后关闭TCP_CORK立即推送剩余部分
+*/
+static void flush_write(chk_stream_socket *s) {
+	int32_t corked;
+	if(send_list_empty(s) || chk_is_write_enable(cast(chk_handle*,s))) {
+		return;
+	}
+	corked = flush_need_cork(s) && 0 == set_tcp_cork(s,1);
+	process_write(s,1);
+	if(corked) {
+		set_tcp_cork(s,0);
+	}
+	if(!s->write_error && !send_list_empty(s) && !chk_is_write_enable(cast(chk_handle*,s))) {
+		enable_write(s);
+	}
+}
+
+/*cork模式把写推迟到本轮循环结束,否则打开写监听*/
+static inline void defer_write(chk_stream_socket *s) {
+	if(s->option.cork) {
+		chk_loop_defer_flush(cast(chk_handle*,s));
+	} else {
+		enable_write(s);
+	}
+}
+
 static uint32_t send_bytes_low_water = 64*1024;
 
+static uint32_t default_high_water_mark = 64*1024*1024;
+
+/*发送队列越过水位时返回需要通知的事件,否则返回0*/
+static inline int32_t water_event(chk_stream_socket *s) {
+	if(!s->water) {
+		return 0;
+	}
+	if(!s->water->over) {
+		return s->send_bytes >= s->high_water_mark ? CHK_SEND_WATER_HIGH : 0;
+	}
+	return s->send_bytes <= s->water->low ? CHK_SEND_WATER_LOW : 0;
+}
+
+/*
+*  水位回调只在on_events中(SOCKET_INLOOP)触发,回调中关闭socket是安全的.
+*  事件回调之外越过水位时请求本轮循环结束时的flush
+*/
+static inline void water_defer(chk_stream_socket *s) {
+	if(s->loop && !(s->status & SOCKET_INLOOP) && water_event(s)) {
+		chk_loop_defer_flush(cast(chk_handle*,s));
+	}
+}
+
+static void water_notify(chk_stream_socket *s) {
+	int32_t event;
+	if(!s->closed && (event = water_event(s))) {
+		s->water->over = event == CHK_SEND_WATER_HIGH;
+		s->water->cb(s,event,s->water->ud);
+	}
+}
+
+/*
+*  共享epoll上的socket,回调先后在不同的worker中执行.持有者之外的线程(定时器,closure,
+*  其它socket的回调)不能直接操作发送队列,把发送交到inbox,由取到socket事件的worker
+*  在回调开始时排入发送队列.返回非0表示已经交出,*ret为返回给调用者的值
+*/
+static int32_t shared_handoff(chk_stream_socket *s,chk_bytebuffer *b,int32_t *ret) {
+	int32_t state = chk_loop_shared_acquire(cast(chk_handle*,s));
+	if(!state) {
+		return 0;
+	}
+	if(!s->inbox && !(s->inbox = calloc(1,sizeof(*s->inbox)))) {
+		chk_loop_shared_unlock(cast(chk_handle*,s));
+		CHK_SYSLOG(LOG_ERROR,"calloc inbox failed");
+		send_entry_del(s,b);
+		*ret = chk_error_no_memory;
+		return 1;
+	}
+	chk_list_pushback(s->inbox,cast(chk_list_entry*,b));
+	chk_loop_shared_handoff(cast(chk_handle*,s),state);
+	*ret = chk_error_ok;
+	return 1;
+}
+
 static int32_t _chk_stream_socket_send(chk_stream_socket *s,int32_t urgent,chk_bytebuffer *b) {
 	chk_list *send_list = NULL;
+	int32_t   ret;
 
 	if(b->flags & READ_ONLY) {
 		CHK_SYSLOG(LOG_ERROR,"chk_bytebuffer is read only");		
@@ -544,6 +1457,16 @@ static int32_t _chk_stream_socket_send(chk_stream_socket *s,int32_t urgent,chk_b
 		return chk_error_socket_close;
 	}
 
+	if(s->shared) {
+		if(urgent) {
+			b->flags |= SEND_URGENT;
+		}
+		if(shared_handoff(s,b,&ret)) {
+			return ret;
+		}
+		b->flags &= ~SEND_URGENT;
+	}
+
 	if(urgent){
 		send_list = &s->urgent_list;
 	}else {
@@ -555,14 +1478,16 @@ static int32_t _chk_stream_socket_send(chk_stream_socket *s,int32_t urgent,chk_b
 	s->send_bytes += b->datasize;
 	chk_list_pushback(send_list,cast(chk_list_entry*,b));
 	if(s->loop){
-		if(s->send_bytes >= send_bytes_low_water || (s->no_delay && old_send_bytes == 0)) {
-			process_write(s);
+		if(s->send_bytes >= send_bytes_low_water || (s->no_delay && !s->option.cork && old_send_bytes == 0)) {
+			process_write(s,s->option.edge_trigger);
 			if(errno == EAGAIN || (errno == 0 && !chk_list_empty(send_list))) {
 				enable_write(s);
 			} else {
 				return chk_error_stream_write;
 			}
 
+			water_defer(s);
+
 			if(s->send_bytes >= s->high_water_mark) {
 				//接收方接收不过来
 				return chk_error_highwater_mark;
@@ -570,14 +1495,94 @@ static int32_t _chk_stream_socket_send(chk_stream_socket *s,int32_t urgent,chk_b
 
 		} else {
 			if(!chk_is_write_enable(cast(chk_handle*,s))){
-				enable_write(s);			
+				defer_write(s);
 			}
+			water_defer(s);
 		}
 	}
 
 	return chk_error_ok;
 }
 
+/*
+*  组消息排入成员的send_list:游标不在队列中时排到队尾;游标已经在队尾时扩展它的范围;
+*  游标之后排入了其它buffer时,为了保持发送顺序以拷贝发送
+*/
+int32_t chk_stream_socket_queue_group(chk_stream_socket *s,chk_group_member *m,chk_group_msg *msg) {
+	chk_bytebuffer *b;
+	int32_t         ret = 1;
+	if(s->closed || (s->status & SOCKET_WCLOSE)) {
+		return 0;
+	}
+	if(!m->msg) {
+		m->msg  = m->last = msg;
+		m->pos  = 0;
+		chk_list_pushback(&s->send_list,cast(chk_list_entry*,&m->b));
+	} else if(s->send_list.tail == cast(chk_list_entry*,&m->b)) {
+		m->last = msg;
+	} else {
+		if(!(b = chk_bytebuffer_clone(msg->b))) {
+			CHK_SYSLOG(LOG_ERROR,"chk_bytebuffer_clone() failed");
+			return 0;
+		}
+		b->internal = b->datasize;
+		chk_list_pushback(&s->send_list,cast(chk_list_entry*,b));
+		ret = 0;
+	}
+	s->send_bytes += msg->b->datasize;
+	if(s->loop) {
+		if(!chk_is_write_enable(cast(chk_handle*,s))) {
+			/*组内所有成员在本轮循环结束时写出*/
+			chk_loop_defer_flush(cast(chk_handle*,s));
+		}
+		water_defer(s);
+	}
+	return ret;
+}
+
+/*游标中还没有发送的消息以拷贝替换,留在send_list中原来的位置*/
+void chk_stream_socket_detach_group(chk_stream_socket *s,chk_group_member *m) {
+	chk_list        list;
+	chk_list_entry *entry;
+	chk_bytebuffer *b;
+	chk_bytechunk  *chunk;
+	chk_group_msg  *msg;
+	uint32_t        pos,size;
+	if(!m->msg) {
+		return;
+	}
+	list = s->send_list;
+	chk_list_init(&s->send_list);
+	while((entry = chk_list_pop(&list))) {
+		if(entry != cast(chk_list_entry*,&m->b)) {
+			chk_list_pushback(&s->send_list,entry);
+			continue;
+		}
+		for(msg = m->msg,pos = m->pos;; msg = msg->next,pos = 0) {
+			size = msg->b->datasize - pos;
+			if(pos > 0) {
+				/*只发送了部分的消息,internal为0使它在urgent_list之前发送完*/
+				chunk = group_msg_seek(msg,&pos);
+				if((b = chk_bytebuffer_new_bychunk(chunk,pos,size))) {
+					b->internal = 0;
+				}
+			} else if((b = chk_bytebuffer_clone(msg->b))) {
+				b->internal = b->datasize;
+			}
+			if(b) {
+				chk_list_pushback(&s->send_list,cast(chk_list_entry*,b));
+			} else {
+				CHK_SYSLOG(LOG_ERROR,"detach group message failed size:%u",size);
+				s->send_bytes -= size;
+			}
+			if(msg == m->last) {
+				break;
+			}
+		}
+	}
+	chk_group_member_drop(m);
+}
+
 int32_t chk_stream_socket_send(chk_stream_socket *s,chk_bytebuffer *b) {
 	return _chk_stream_socket_send(s,0,b);
 }
@@ -586,26 +1591,329 @@ int32_t chk_stream_socket_send_urgent(chk_stream_socket *s,chk_bytebuffer *b) {
 	return _chk_stream_socket_send(s,1,b);
 }
 
+/*
+*  b是调用者的buffer,或者共享socket交接时数据已经转移过去的keyed_buffer
+*/
+static int32_t queue_keyed(chk_stream_socket *s,uint64_t key,chk_bytebuffer *b) {
+	keyed_buffer *k;
+
+	if(!s->coalesce && !(s->coalesce = calloc(1,sizeof(*s->coalesce)))) {
+		CHK_SYSLOG(LOG_ERROR,"calloc chk_coalesce failed");
+		send_entry_del(s,b);
+		return chk_error_no_memory;
+	}
+
+	if((k = keyed_find(s->coalesce,key))) {
+		if(k->b.internal == k->b.datasize) {
+			/*还没有开始发送,在原来的位置替换成新的数据,已经在等待写*/
+			s->send_bytes = s->send_bytes - k->b.datasize + b->datasize;
+			keyed_take(k,b);
+			++s->coalesce->replaced;
+			water_defer(s);
+			return chk_error_ok;
+		}
+		/*已经开始发送的buffer保持完整,之后同key的buffer排在队尾*/
+		keyed_remove(s->coalesce,k);
+	}
+
+	if(b->flags & SEND_KEYED) {
+		k = cast(keyed_buffer*,b);
+	} else if(!(k = calloc(1,sizeof(*k)))) {
+		CHK_SYSLOG(LOG_ERROR,"calloc keyed_buffer failed");
+		chk_bytebuffer_del(b);
+		return chk_error_no_memory;
+	} else {
+		k->key = key;
+		keyed_take(k,b);
+	}
+	if(0 != keyed_insert(s->coalesce,k)) {
+		CHK_SYSLOG(LOG_ERROR,"calloc coalesce buckets failed");
+		chk_bytebuffer_finalize(&k->b);
+		free(k);
+		return chk_error_no_memory;
+	}
+	return _chk_stream_socket_send(s,0,cast(chk_bytebuffer*,k));
+}
+
+int32_t chk_stream_socket_send_keyed(chk_stream_socket *s,uint64_t key,chk_bytebuffer *b) {
+	keyed_buffer *k;
+	int32_t       ret;
+
+	if(b->flags & READ_ONLY) {
+		CHK_SYSLOG(LOG_ERROR,"chk_bytebuffer is read only");
+		return chk_error_buffer_read_only;
+	}
+
+	if(b->datasize == 0 || s->closed || (s->status & SOCKET_WCLOSE)) {
+		/*交给_chk_stream_socket_send报告错误*/
+		return _chk_stream_socket_send(s,0,b);
+	}
+
+	if(s->shared) {
+		/*可能需要交给持有者,带上key*/
+		if(!(k = calloc(1,sizeof(*k)))) {
+			CHK_SYSLOG(LOG_ERROR,"calloc keyed_buffer failed");
+			chk_bytebuffer_del(b);
+			return chk_error_no_memory;
+		}
+		k->key = key;
+		keyed_take(k,b);
+		b = cast(chk_bytebuffer*,k);
+		if(shared_handoff(s,b,&ret)) {
+			return ret;
+		}
+	}
+	return queue_keyed(s,key,b);
+}
+
+static void queue_file(chk_stream_socket *s,send_file *f) {
+	chk_list_pushback(&s->send_list,cast(chk_list_entry*,f));
+	if(s->loop && !chk_is_write_enable(cast(chk_handle*,s))) {
+		defer_write(s);
+	}
+}
+
+int32_t chk_stream_socket_sendfile(chk_stream_socket *s,int32_t fd,uint64_t offset,uint64_t len) {
+	struct stat st;
+	send_file  *f;
+	int32_t     ret;
+
+	if(s->closed || (s->status & SOCKET_WCLOSE)) {
+		CHK_SYSLOG(LOG_ERROR,"chk_stream_socket close");
+		return chk_error_socket_close;
+	}
+
+	if(len == 0) {
+		if(0 != fstat(fd,&st)) {
+			CHK_SYSLOG(LOG_ERROR,"fstat() failed errno:%s",strerror(errno));
+			return chk_error_invaild_argument;
+		}
+		len = cast(uint64_t,st.st_size) > offset ? cast(uint64_t,st.st_size) - offset : 0;
+	}
+
+	if(len == 0) {
+		CHK_SYSLOG(LOG_ERROR,"nothing to send,offset:%llu",cast(unsigned long long,offset));
+		return chk_error_invaild_argument;
+	}
+
+	if(!(f = calloc(1,sizeof(*f)))) {
+		CHK_SYSLOG(LOG_ERROR,"calloc send_file failed");
+		return chk_error_no_memory;
+	}
+
+	if(0 > (f->fd = dup(fd))) {
+		CHK_SYSLOG(LOG_ERROR,"dup() failed errno:%s",strerror(errno));
+		free(f);
+		return chk_error_invaild_argument;
+	}
+
+	f->b.flags = SEND_FILE;
+	f->offset  = offset;
+	f->remain  = len;
+	if(s->shared && shared_handoff(s,cast(chk_bytebuffer*,f),&ret)) {
+		return ret;
+	}
+	queue_file(s,f);
+	return chk_error_ok;
+}
+
+/*
+*  在取到socket事件的worker中,把其它线程交来的发送按交来的顺序排入发送队列
+*/
+static void shared_drain(chk_stream_socket *s) {
+	chk_list        inbox;
+	chk_bytebuffer *b;
+	chk_loop_shared_lock(cast(chk_handle*,s));
+	inbox = *s->inbox;
+	chk_list_init(s->inbox);
+	chk_loop_shared_unlock(cast(chk_handle*,s));
+	while((b = cast(chk_bytebuffer*,chk_list_pop(&inbox)))) {
+		if(s->closed || (s->status & SOCKET_WCLOSE)) {
+			send_entry_del(s,b);
+		} else if(b->flags & SEND_FILE) {
+			queue_file(s,cast(send_file*,b));
+		} else if(b->flags & SEND_KEYED) {
+			queue_keyed(s,cast(keyed_buffer*,b)->key,b);
+		} else if(b->flags & SEND_URGENT) {
+			b->flags ^= SEND_URGENT;
+			_chk_stream_socket_send(s,1,b);
+		} else {
+			_chk_stream_socket_send(s,0,b);
+		}
+	}
+}
+
+/*
+*  在目标loop的线程中重新注册,send_list/urgent_list,接收缓冲和解包器的状态都留在socket上
+*/
+static void migrate_arrive(chk_ud ud) {
+	int32_t            ret;
+	chk_stream_socket *s = cast(chk_stream_socket*,ud.v.val);
+	chk_event_loop    *e = s->migrate_to;
+	s->migrate_to = NULL;
+	if(chk_error_ok != (ret = chk_watch_handle(e,cast(chk_handle*,s),s->migrate_events))) {
+		CHK_SYSLOG(LOG_ERROR,"chk_watch_handle() failed:%d",ret);
+		s->cb(s,NULL,ret);
+	}
+}
+
+static int32_t migrate(chk_stream_socket *s,chk_event_loop *target) {
+	int32_t         ret;
+	chk_event_loop *source = s->loop;
+	s->migrate_events = s->events;
+	/*组只能在所属的线程中访问,迁移前退出所有的组*/
+	while(s->groups) {
+		chk_socket_group_remove(s->groups->group,s);
+	}
+	if(s->flush_entry.next) {
+		/*等待本轮flush的数据改为在目标loop上等待可写事件*/
+		s->migrate_events |= CHK_EVENT_WRITE;
+	}
+	if(chk_error_ok != (ret = chk_unwatch_handle(cast(chk_handle*,s)))) {
+		return ret;
+	}
+	s->migrate_to = target;
+	//投递之后socket属于目标loop,本线程不能再访问
+	if(chk_error_ok != (ret = chk_loop_post_closure(target,migrate_arrive,chk_ud_make_void(s)))) {
+		CHK_SYSLOG(LOG_ERROR,"chk_loop_post_closure() failed:%d",ret);
+		s->migrate_to = NULL;
+		chk_watch_handle(source,cast(chk_handle*,s),s->migrate_events);
+	}
+	return ret;
+}
+
 static void on_events(chk_handle *h,int32_t events) {
 	chk_stream_socket *s = cast(chk_stream_socket*,h);
 
 	s->status |= SOCKET_INLOOP;
+	if(s->inbox && s->inbox->head && events != CHK_EVENT_LOOPCLOSE) {
+		shared_drain(s);
+	}
 	if(events == CHK_EVENT_LOOPCLOSE) {
 		s->cb(s,NULL,chk_error_loop_close);
+	} else if(events == CHK_EVENT_FLUSH) {
+		flush_write(s);
 	} else {
+#ifdef CHK_ZEROCOPY
+		/*完成通知使fd在错误队列上就绪(EPOLLERR),先回收*/
+		if(zc_pending(s)) {
+			zc_reap(s);
+		}
+#endif
 		if(events & CHK_EVENT_READ){
 			process_read(s);
 		}		
 		if(events & CHK_EVENT_WRITE){
-			process_write(s);
+			process_write(s,s->option.edge_trigger);
 		}			
 	}
+	if(events != CHK_EVENT_LOOPCLOSE) {
+		water_notify(s);
+	}
 	s->status ^= SOCKET_INLOOP;
 	if(s->closed && (s->status & SOCKET_WCLOSE) && (s->status & SOCKET_RCLOSE)) {
 		release_socket(s);		
+	} else if(s->migrate_to) {
+		/*回调中请求的迁移在回调返回之后执行*/
+		chk_event_loop *target = s->migrate_to;
+		s->migrate_to = NULL;
+		if(s->loop && !s->closed) {
+			migrate(s,target);
+		}
 	}
 }
 
+int32_t chk_stream_socket_migrate(chk_stream_socket *s,chk_event_loop *loop) {
+	if(!loop) {
+		return chk_error_invaild_argument;
+	}
+	if(!s->loop) {
+		return chk_error_no_event_loop;
+	}
+	if(s->closed) {
+		return chk_error_socket_close;
+	}
+	if(s->shared) {
+		CHK_SYSLOG(LOG_ERROR,"shared handle can't be migrated");
+		return chk_error_invaild_argument;
+	}
+	if(loop == s->loop) {
+		return chk_error_ok;
+	}
+	if(s->status & SOCKET_INLOOP) {
+		s->migrate_to = loop;
+		return chk_error_ok;
+	}
+	return migrate(s,loop);
+}
+
+static int32_t compare_io_bytes(const void *a,const void *b) {
+	uint64_t l = (*cast(chk_stream_socket* const*,a))->io_bytes;
+	uint64_t r = (*cast(chk_stream_socket* const*,b))->io_bytes;
+	return l < r ? 1 : (l > r ? -1 : 0);
+}
+
+/*
+*  按读写字节数从大到小挑选连接,迁移的字节数合计不超过from上总字节数的fraction,
+*  单个超出剩余额度的连接被跳过,避免把热点整个搬到目标loop上
+*/
+int32_t chk_stream_socket_rebalance(chk_event_loop *from,chk_event_loop *to,double fraction,uint32_t max_moves) {
+	chk_dlist_entry    *entry;
+	chk_stream_socket **sockets,*s;
+	uint32_t            i,count = 0,moved = 0;
+	uint64_t            total = 0,budget,moved_bytes = 0;
+	if(!from || !to || from == to) {
+		return 0;
+	}
+	chk_dlist_foreach(&from->handles,entry) {
+		if(cast(chk_handle*,entry)->on_events == on_events) {
+			++count;
+		}
+	}
+	if(0 == count || NULL == (sockets = calloc(count,sizeof(*sockets)))) {
+		return 0;
+	}
+	count = 0;
+	chk_dlist_foreach(&from->handles,entry) {
+		if(cast(chk_handle*,entry)->on_events == on_events) {
+			s = cast(chk_stream_socket*,entry);
+			total += s->io_bytes;
+			sockets[count++] = s;
+		}
+	}
+	qsort(sockets,count,sizeof(*sockets),compare_io_bytes);
+	budget = (uint64_t)(total * fraction);
+	for(i = 0; i < count; ++i) {
+		s = sockets[i];
+		//不允许迁移的连接计入总量,但不迁移
+		if(moved < max_moves && s->migratable && s->io_bytes > 0 && moved_bytes + s->io_bytes <= budget && !s->closed) {
+			moved_bytes += s->io_bytes;
+			s->io_bytes = 0;
+			if(chk_error_ok == chk_stream_socket_migrate(s,to)) {
+				++moved;
+			}
+		} else {
+			s->io_bytes = 0;
+		}
+	}
+	free(sockets);
+	return moved;
+}
+
+uint64_t chk_stream_socket_loop_send_bytes(chk_event_loop *loop) {
+	chk_dlist_entry *entry;
+	uint64_t         bytes = 0;
+	if(!loop) {
+		return 0;
+	}
+	chk_dlist_foreach(&loop->handles,entry) {
+		if(cast(chk_handle*,entry)->on_events == on_events) {
+			bytes += cast(chk_stream_socket*,entry)->send_bytes;
+		}
+	}
+	return bytes;
+}
+
 int32_t chk_stream_socket_init(chk_stream_socket *s,int32_t fd,const chk_stream_socket_option *op) {
 	assert(s);
 	easy_close_on_exec(fd);
@@ -614,8 +1922,12 @@ int32_t chk_stream_socket_init(chk_stream_socket *s,int32_t fd,const chk_stream_
 	s->handle_add = loop_add;
 	s->option = *op;
 	s->option.recv_buffer_size = MAX(1024,chk_size_of_pow2(s->option.recv_buffer_size));
+	if(s->option.recv_buffer_max) s->option.recv_buffer_max = chk_size_of_pow2(s->option.recv_buffer_max);
+	s->recv_stats.recv_buffer_size = s->option.recv_buffer_size;
+	if(!s->option.io_budget) s->option.io_budget = STREAM_IO_BUDGET;
+	if(!s->option.packet_budget) s->option.packet_budget = STREAM_PACKET_BUDGET;
 	s->loop   = NULL;
-	s->high_water_mark = 64 * 1024 * 1024;
+	s->high_water_mark = default_high_water_mark;
 	s->send_bytes = 0;
 	if(!s->option.decoder) { 
 		if(NULL == (s->option.decoder = cast(chk_decoder*,default_decoder_new()))) {
@@ -627,13 +1939,13 @@ int32_t chk_stream_socket_init(chk_stream_socket *s,int32_t fd,const chk_stream_
 }
 
 chk_stream_socket *chk_stream_socket_new(int32_t fd,const chk_stream_socket_option *op) {
-	chk_stream_socket *s = calloc(1,sizeof(*s));
+	chk_stream_socket *s = alloc_socket();
 	if(!s) {
 		CHK_SYSLOG(LOG_ERROR,"calloc chk_stream_socket failed");			
 		return NULL;
 	}
 	if(0 != chk_stream_socket_init(s,fd,op)) {
-		free(s);
+		free_socket(s);
 		return NULL;
 	}
 	return s;
@@ -771,32 +2083,57 @@ int32_t chk_ssl_accept(chk_stream_socket *s,SSL_CTX *ctx) {
 	}
 }
 
-int32_t chk_stream_socket_getsockaddr(chk_stream_socket *s,chk_sockaddr *addr) {
-	if(NULL == s || NULL == addr) {
-		CHK_SYSLOG(LOG_ERROR,"NULL == s || NULL == addr");		
-		return -1;
-	}
-
-	if(s->addr_local.addr_type == SOCK_ADDR_NONE) {
-		socklen_t len = sizeof(s->addr_local);
-		if(0 != getsockname(s->fd,(struct sockaddr*)&s->addr_local,&len)) {
+/*
+*  第一次获取时调用getsockname/getpeername,按地址的实际长度缓存
+*/
+static int32_t get_addr(chk_stream_socket *s,chk_addr_cache **cache,int32_t peer,chk_sockaddr *addr) {
+	chk_sockaddr    tmp;
+	chk_addr_cache *c = *cache;
+	if(!c) {
+		socklen_t len = sizeof(tmp);
+		memset(&tmp,0,sizeof(tmp));
+		if(peer) {
+			if(0 != getpeername(s->fd,(struct sockaddr*)&tmp,&len)) {
+				CHK_SYSLOG(LOG_ERROR,"getpeername failed");
+				return -1;
+			}
+		} else if(0 != getsockname(s->fd,(struct sockaddr*)&tmp,&len)) {
 			CHK_SYSLOG(LOG_ERROR,"getsockname failed");
 			return -1;
 		}
 
-		if(s->addr_local.in.sin_family == AF_INET) {
-			s->addr_local.addr_type = SOCK_ADDR_IPV4;
-		} else if(s->addr_local.in6.sin6_family == AF_INET6) {
-			s->addr_local.addr_type = SOCK_ADDR_IPV6;
-		} else if(s->addr_local.un.sun_family == AF_LOCAL) {
-			s->addr_local.addr_type = SOCK_ADDR_UN;			
+		if(tmp.in.sin_family == AF_INET) {
+			tmp.addr_type = SOCK_ADDR_IPV4;
+		} else if(tmp.in6.sin6_family == AF_INET6) {
+			tmp.addr_type = SOCK_ADDR_IPV6;
+		} else if(tmp.un.sun_family == AF_LOCAL) {
+			tmp.addr_type = SOCK_ADDR_UN;			
 		} else {		
 			return -1;
 		}
+
+		len = MIN(len,sizeof(tmp.un));
+		if(!(c = malloc(sizeof(*c) + len))) {
+			CHK_SYSLOG(LOG_ERROR,"malloc chk_addr_cache failed");
+			return -1;
+		}
+		c->addr_type = tmp.addr_type;
+		c->len = len;
+		memcpy(c->addr,&tmp,len);
+		*cache = c;
 	}
-	*addr = s->addr_local;
+	memset(addr,0,sizeof(*addr));
+	memcpy(addr,c->addr,c->len);
+	addr->addr_type = c->addr_type;
 	return 0;
+}
 
+int32_t chk_stream_socket_getsockaddr(chk_stream_socket *s,chk_sockaddr *addr) {
+	if(NULL == s || NULL == addr) {
+		CHK_SYSLOG(LOG_ERROR,"NULL == s || NULL == addr");		
+		return -1;
+	}
+	return get_addr(s,&s->addr_local,0,addr);
 }
 
 int32_t chk_stream_socket_getpeeraddr(chk_stream_socket *s,chk_sockaddr *addr) {
@@ -804,26 +2141,11 @@ int32_t chk_stream_socket_getpeeraddr(chk_stream_socket *s,chk_sockaddr *addr) {
 		CHK_SYSLOG(LOG_ERROR,"NULL == s || NULL == addr");		
 		return -1;
 	}
+	return get_addr(s,&s->addr_peer,1,addr);
+}
 
-	if(s->addr_peer.addr_type == SOCK_ADDR_NONE) {
-		socklen_t len = sizeof(s->addr_peer);
-		if(0 != getpeername(s->fd,(struct sockaddr*)&s->addr_peer,&len)) {
-			CHK_SYSLOG(LOG_ERROR,"getpeername failed");
-			return -1;
-		}
-
-		if(s->addr_peer.in.sin_family == AF_INET) {
-			s->addr_peer.addr_type = SOCK_ADDR_IPV4;
-		} else if(s->addr_peer.in6.sin6_family == AF_INET6) {
-			s->addr_peer.addr_type = SOCK_ADDR_IPV6;
-		} else if(s->addr_peer.un.sun_family == AF_LOCAL) {
-			s->addr_peer.addr_type = SOCK_ADDR_UN;			
-		} else {		
-			return -1;
-		}
-	}
-	*addr = s->addr_peer;
-	return 0;
+void chk_stream_socket_set_migratable(chk_stream_socket *s,int8_t on) {
+	s->migratable = on ? 1 : 0;
 }
 
 void chk_stream_socket_nodelay(chk_stream_socket *s,int8_t on) {
@@ -832,6 +2154,137 @@ void chk_stream_socket_nodelay(chk_stream_socket *s,int8_t on) {
   s->no_delay = optval;
 }
 
+void chk_stream_socket_cork(chk_stream_socket *s,int8_t on) {
+	s->option.cork = on > 0 ? 1:0;
+}
+
+int32_t chk_stream_socket_busy_poll(chk_stream_socket *s,uint32_t us) {
+#ifdef SO_BUSY_POLL
+	int optval = (int)us;
+	if(0 != setsockopt(s->fd,SOL_SOCKET,SO_BUSY_POLL,&optval,(socklen_t)(sizeof optval))) {
+		CHK_SYSLOG(LOG_ERROR,"setsockopt(SO_BUSY_POLL) failed fd:%d,errno:%s",s->fd,strerror(errno));
+		return chk_error_setsockopt;
+	}
+	return chk_error_ok;
+#else
+	return chk_error_setsockopt;
+#endif
+}
+
+int32_t chk_stream_socket_get_recv_stats(chk_stream_socket *s,chk_stream_socket_recv_stats *stats) {
+	chk_bytechunk *chunk;
+	if(!s || !stats) {
+		return chk_error_invaild_argument;
+	}
+	*stats = s->recv_stats;
+	stats->held = 0;
+	for(chunk = s->next_recv_buf; chunk; chunk = chunk->next) {
+		stats->held += chunk->cap;
+	}
+	return chk_error_ok;
+}
+
+int32_t chk_stream_socket_zerocopy(chk_stream_socket *s,uint32_t threshold) {
+#ifdef CHK_ZEROCOPY
+	int optval = 1;
+	if(s->ssl.ssl || s->ssl.ctx) {
+		CHK_SYSLOG(LOG_ERROR,"MSG_ZEROCOPY not supported on ssl socket");
+		return chk_error_invaild_argument;
+	}
+
+	if(0 == threshold) {
+		if(s->zc) {
+			s->zc->threshold = 0;//等待中的发送仍需回收,状态保留到socket释放
+		}
+		return chk_error_ok;
+	}
+
+	if(!s->zc) {
+		if(0 != setsockopt(s->fd,SOL_SOCKET,SO_ZEROCOPY,&optval,(socklen_t)(sizeof optval))) {
+			CHK_SYSLOG(LOG_ERROR,"setsockopt(SO_ZEROCOPY) failed fd:%d,errno:%s",s->fd,strerror(errno));
+			return chk_error_setsockopt;
+		}
+		if(NULL == (s->zc = calloc(1,sizeof(*s->zc)))) {
+			CHK_SYSLOG(LOG_ERROR,"calloc chk_zerocopy failed");
+			return chk_error_no_memory;
+		}
+		chk_list_init(&s->zc->pending);
+	}
+	s->zc->threshold = threshold;
+	return chk_error_ok;
+#else
+	return chk_error_setsockopt;
+#endif
+}
+
+int32_t chk_stream_socket_set_watermark(chk_stream_socket *s,uint32_t high,uint32_t low,chk_stream_socket_water_cb cb,chk_ud ud) {
+	if(0 == high) {
+		free(s->water);
+		s->water = NULL;
+		s->high_water_mark = default_high_water_mark;
+		return chk_error_ok;
+	}
+
+	if(!cb || low >= high) {
+		CHK_SYSLOG(LOG_ERROR,"invaild watermark high:%u,low:%u",high,low);
+		return chk_error_invaild_argument;
+	}
+
+	if(!s->water && NULL == (s->water = calloc(1,sizeof(*s->water)))) {
+		CHK_SYSLOG(LOG_ERROR,"calloc chk_send_water failed");
+		return chk_error_no_memory;
+	}
+	s->high_water_mark = high;
+	s->water->low = low;
+	s->water->cb  = cb;
+	s->water->ud  = ud;
+	water_defer(s);
+	return chk_error_ok;
+}
+
+int32_t chk_stream_socket_notsent_lowat(chk_stream_socket *s,uint32_t bytes) {
+#ifdef TCP_NOTSENT_LOWAT
+	int optval = (int)bytes;//0使用net.ipv4.tcp_notsent_lowat
+	if(0 != setsockopt(s->fd,IPPROTO_TCP,TCP_NOTSENT_LOWAT,&optval,(socklen_t)(sizeof optval))) {
+		CHK_SYSLOG(LOG_ERROR,"setsockopt(TCP_NOTSENT_LOWAT) failed fd:%d,errno:%s",s->fd,strerror(errno));
+		return chk_error_setsockopt;
+	}
+	return chk_error_ok;
+#else
+	return chk_error_setsockopt;
+#endif
+}
+
+int32_t chk_stream_socket_zerocopy_stats(chk_stream_socket *s,uint64_t *sends,uint64_t *copied,uint32_t *pending) {
+	if(!s->zc) {
+		return chk_error_invaild_argument;
+	}
+	if(sends) *sends = s->zc->sends;
+	if(copied) *copied = s->zc->copied;
+	if(pending) *pending = cast(uint32_t,chk_list_size(&s->zc->pending));
+	return chk_error_ok;
+}
+
+int32_t chk_stream_socket_coalesce_stats(chk_stream_socket *s,uint64_t *replaced,uint32_t *keys) {
+	if(!s->coalesce) {
+		return chk_error_invaild_argument;
+	}
+	if(replaced) *replaced = s->coalesce->replaced;
+	if(keys) *keys = s->coalesce->size;
+	return chk_error_ok;
+}
+
+int32_t chk_stream_socket_edge_trigger(chk_stream_socket *s,int8_t on,uint32_t io_budget,uint32_t packet_budget) {
+	if(s->loop) {
+		CHK_SYSLOG(LOG_ERROR,"chk_stream_socket_edge_trigger() must be called before chk_loop_add_handle()");
+		return chk_error_invaild_argument;
+	}
+	s->option.edge_trigger = on > 0 ? 1:0;
+	s->option.io_budget = io_budget ? io_budget : STREAM_IO_BUDGET;
+	s->option.packet_budget = packet_budget ? packet_budget : STREAM_PACKET_BUDGET;
+	return chk_error_ok;
+}
+
 int32_t chk_stream_socket_set_close_callback(chk_stream_socket *s,void (*cb)(chk_stream_socket*,chk_ud),chk_ud ud) {
 	if(!s->close_callback.close_callback) {
 		s->close_callback.close_callback = cb;
@@ -26,11 +26,40 @@ typedef struct chk_stream_socket_option chk_stream_socket_option;
 
 typedef void (*chk_stream_socket_cb)(chk_stream_socket*,chk_bytebuffer*,int32_t error);
 
+enum {
+	CHK_SEND_WATER_HIGH = 1,                 //发送队列达到高水位
+	CHK_SEND_WATER_LOW  = 2,                 //达到高水位之后发送队列降到低水位
+};
+
+typedef void (*chk_stream_socket_water_cb)(chk_stream_socket*,int32_t event,chk_ud ud);
+
 struct chk_stream_socket_option {
 	uint32_t     recv_buffer_size;       //接收缓冲大小
 	chk_decoder *decoder;
+	int8_t       edge_trigger;           //以边缘触发方式监听,每次事件读(写)到EAGAIN或用完预算为止
+	uint32_t     io_budget;              //边缘触发时每次事件读(写)的字节预算,0使用STREAM_IO_BUDGET
+	uint32_t     packet_budget;          //边缘触发时每次事件回调的包数预算,0使用STREAM_PACKET_BUDGET
+	uint32_t     recv_buffer_max;        //接收缓冲自适应的上限,大于recv_buffer_size时开启,recv_buffer_size作为下限
+	int8_t       lazy_recv;              //惰性接收:先读入线程的临时缓冲,只有数据在回调之后仍被引用时才保留按大小分配的chunk
+	int8_t       cork;                   //cork模式,见chk_stream_socket_cork
 };
 
+#define CHK_RECV_SIZE_BUCKETS 16
+
+/*
+* 连接的读统计,read_size[i]为单次读取字节数在[2^(i+6),2^(i+7))内的次数,
+* 首桶包括更小的读取,末桶包括更大的读取
+*/
+typedef struct chk_stream_socket_recv_stats {
+	uint64_t     reads;
+	uint64_t     bytes;
+	uint32_t     recv_buffer_size;       //当前分配接收chunk的大小
+	uint32_t     grows;
+	uint32_t     shrinks;
+	uint32_t     held;                   //socket持有的接收chunk的总容量,惰性接收模式空闲时为0
+	uint32_t     read_size[CHK_RECV_SIZE_BUCKETS];
+}chk_stream_socket_recv_stats;
+
 /**
  * 创建stream_socket
  * @param fd 文件描述符
@@ -97,6 +126,72 @@ chk_ud chk_stream_socket_getUd(chk_stream_socket *s);
 
 int32_t chk_stream_socket_getfd(chk_stream_socket *s);
 
+/**
+ * 把文件fd中[offset,offset+len)的数据排入send_list,与chk_stream_socket_send的buffer按顺序发送.
+ * linux下以sendfile发送,ssl连接或sendfile不可用时每次pread一块数据再发送.
+ * fd被dup,调用返回后可以关闭.文件数据不计入send_bytes,发送完之前文件不能被截短
+ * @param s stream_socket
+ * @param fd 文件描述符
+ * @param offset 起始偏移
+ * @param len 发送的字节数,0表示发送到文件末尾
+ */
+
+int32_t chk_stream_socket_sendfile(chk_stream_socket *s,int32_t fd,uint64_t offset,uint64_t len);
+
+/**
+ * 以合并方式发送:send_list中同key的buffer还没有开始发送时,以b的数据替换它(保持原来的位置),
+ * 已经开始发送的buffer保持完整,b排在队尾.用于状态更新一类只需要最新值的数据,
+ * 对端接收慢时收到更少更新的消息,发送队列的大小不超过key数乘以消息大小
+ * @param s stream_socket
+ * @param key 合并的key
+ * @param b 待发送缓冲,调用之后b不能再被别处使用
+ */
+
+int32_t chk_stream_socket_send_keyed(chk_stream_socket *s,uint64_t key,chk_bytebuffer *b);
+
+/**
+ * 获取合并发送被替换掉的buffer数和send_list中带key的buffer数,没有使用合并发送时返回错误
+ */
+
+int32_t chk_stream_socket_coalesce_stats(chk_stream_socket *s,uint64_t *replaced,uint32_t *keys);
+
+/**
+ * 把socket迁移到另一个loop:从当前loop移除,通过closure在目标loop的线程中重新注册,
+ * 待发送的send_list/urgent_list,已接收未解包的数据和解包器状态都被保留.
+ * 必须在socket所在loop的线程中调用,在socket自身的回调中调用时迁移在回调返回后进行.
+ * 调用成功之后只能在目标loop的线程中访问socket,共享epoll group中的socket不能迁移
+ * @param s stream_socket
+ * @param loop 目标loop
+ */
+
+int32_t chk_stream_socket_migrate(chk_stream_socket *s,chk_event_loop *loop);
+
+/**
+ * 允许或禁止chk_stream_socket_rebalance迁移该socket,默认不允许.
+ * 迁移只移动socket自身的状态,所有者在原loop上的定时器等状态需要由所有者自己迁移,
+ * 依赖这类状态的socket(例如redis client)不应设置
+ * @param s stream_socket
+ * @param on 非0表示允许
+ */
+
+void chk_stream_socket_set_migratable(chk_stream_socket *s,int8_t on);
+
+/**
+ * 把from上最繁忙(上次调用之后读写字节数最多)的连接迁移到to,迁移的字节数合计不超过
+ * from上所有连接字节数的fraction,最多迁移max_moves个,调用后所有连接的计数清零.
+ * 只迁移通过chk_stream_socket_set_migratable允许迁移的连接.
+ * 必须在from的线程中调用,返回迁移的连接数
+ */
+
+int32_t chk_stream_socket_rebalance(chk_event_loop *from,chk_event_loop *to,double fraction,uint32_t max_moves);
+
+/**
+ * 返回loop上所有stream_socket待发送的字节数之和,需要遍历loop上的handle,
+ * 适合周期性采样而不是在每个请求中调用.必须在loop的线程中调用
+ */
+
+uint64_t chk_stream_socket_loop_send_bytes(chk_event_loop *loop);
+
 /**
  * 暂停事件处理(移除读监听)
  * @param s stream_socket
@@ -122,6 +217,81 @@ int32_t chk_stream_socket_getpeeraddr(chk_stream_socket *s,chk_sockaddr *addr);
 
 void chk_stream_socket_nodelay(chk_stream_socket *s,int8_t on);
 
+/**
+ * 设置cork模式:发送的数据先排入队列,在本轮循环结束(等待下一批事件之前)合并成一次writev写出,
+ * 一次写不完(超过MAX_SEND_SIZE或包含文件段)时以TCP_CORK合并成完整的报文段.
+ * 排队的数据达到64KB时仍然立即发送,开启后nodelay不再立即发送第一个buffer
+ * @param s stream_socket
+ * @param on 非0开启
+ */
+
+void chk_stream_socket_cork(chk_stream_socket *s,int8_t on);
+
+/**
+ * 设置SO_BUSY_POLL(仅linux),套接字无数据时内核在网卡队列上轮询至多us微秒.
+ * 超过net.core.busy_read的值需要CAP_NET_ADMIN权限
+ * @param s stream_socket
+ * @param us 轮询时间(微秒),0关闭
+ */
+
+int32_t chk_stream_socket_busy_poll(chk_stream_socket *s,uint32_t us);
+
+/**
+ * 获取连接的读统计和当前的接收chunk大小
+ */
+
+int32_t chk_stream_socket_get_recv_stats(chk_stream_socket *s,chk_stream_socket_recv_stats *stats);
+
+/**
+ * 开启MSG_ZEROCOPY发送(仅linux TCP,不支持ssl):一次写的数据不少于threshold字节时以MSG_ZEROCOPY发送,
+ * 发送涉及的chunk一直被引用到内核的完成通知到达,小的写仍然拷贝.内核报告做了拷贝(例如对端在本机)时
+ * 自动退回拷贝发送.关闭socket时仍有未完成的发送,剩余chunk会被提前释放,需要延迟关闭保证数据完整
+ * @param s stream_socket
+ * @param threshold 使用MSG_ZEROCOPY的最小字节数,0关闭
+ */
+
+int32_t chk_stream_socket_zerocopy(chk_stream_socket *s,uint32_t threshold);
+
+/**
+ * 设置发送队列的水位回调:排队的字节数(不包括文件段)达到high时以CHK_SEND_WATER_HIGH回调,
+ * 之后降到low或以下时以CHK_SEND_WATER_LOW回调,两者交替出现.回调在socket的事件回调之后
+ * 或本轮循环结束时触发,可以在其中发送或关闭socket.high同时作为send返回chk_error_highwater_mark的阈值
+ * @param s stream_socket
+ * @param high 高水位,0关闭回调并恢复默认的high_water_mark
+ * @param low 低水位,必须小于high
+ * @param cb 回调
+ * @param ud 传给回调的用户数据
+ */
+
+int32_t chk_stream_socket_set_watermark(chk_stream_socket *s,uint32_t high,uint32_t low,chk_stream_socket_water_cb cb,chk_ud ud);
+
+/**
+ * 设置TCP_NOTSENT_LOWAT:内核中未发送的数据少于bytes时才报告可写,
+ * 其余数据留在socket的发送队列中,由水位回调反映真实的积压
+ * @param s stream_socket
+ * @param bytes 内核中未发送数据的上限,0恢复系统默认
+ */
+
+int32_t chk_stream_socket_notsent_lowat(chk_stream_socket *s,uint32_t bytes);
+
+/**
+ * 获取MSG_ZEROCOPY的发送次数,内核做了拷贝的通知次数和等待完成通知的发送数,没有开启时返回错误
+ */
+
+int32_t chk_stream_socket_zerocopy_stats(chk_stream_socket *s,uint64_t *sends,uint64_t *copied,uint32_t *pending);
+
+/**
+ * 设置边缘触发模式,必须在chk_loop_add_handle之前调用
+ * 边缘触发模式下每次事件一直读(写)到EAGAIN,读(写)的字节数或回调的包数达到预算时
+ * 让出本轮处理,loop在下一轮循环继续处理该socket,避免繁忙的连接饿死其它连接
+ * @param s stream_socket
+ * @param on 非0开启
+ * @param io_budget 每次事件读(写)的字节预算,0使用默认值
+ * @param packet_budget 每次事件回调的包数预算,0使用默认值
+ */
+
+int32_t chk_stream_socket_edge_trigger(chk_stream_socket *s,int8_t on,uint32_t io_budget,uint32_t packet_budget);
+
 int32_t chk_stream_socket_set_close_callback(chk_stream_socket *s,void (*cb)(chk_stream_socket*,chk_ud),chk_ud ud);
 
 #endif
\ No newline at end of file
@@ -5,15 +5,56 @@
 
 struct chk_stream_socket;
 
+/*
+*  MSG_ZEROCOPY发送的状态,只在开启时分配.每次以MSG_ZEROCOPY成功发送都占用一个序号(与内核的计数一致),
+*  发送涉及的chunk被引用到内核的完成通知(序号区间)从错误队列中读出为止
+*/
+typedef struct chk_zerocopy {
+    uint32_t             threshold;             //一次写不少于该字节数时使用MSG_ZEROCOPY,0表示关闭
+    uint32_t             next_seq;              //下一次MSG_ZEROCOPY发送的序号
+    chk_list             pending;               //等待完成通知的发送
+    uint64_t             sends;                 //MSG_ZEROCOPY发送的次数
+    uint64_t             copied;                //内核报告实际做了拷贝的通知次数
+}chk_zerocopy;
+
 typedef struct {
     chk_ud ud;
     void (*close_callback)(chk_stream_socket*,chk_ud);
 }close_cb_st;
 
+/*
+*  发送队列的水位回调,只在设置时分配.高水位保存在socket的high_water_mark
+*/
+typedef struct chk_send_water {
+    uint32_t                   low;
+    int8_t                     over;            //已经通知了高水位,等待降到低水位
+    chk_stream_socket_water_cb cb;
+    chk_ud                     ud;
+}chk_send_water;
+
+/*
+*  合并发送的索引,只在使用chk_stream_socket_send_keyed时分配.
+*  key到send_list中该key最新的buffer,按key的hash分桶链接
+*/
+typedef struct chk_coalesce {
+    uint32_t                 size;
+    uint32_t                 mask;              //桶数-1
+    struct chk_keyed_buffer **buckets;
+    uint64_t                 replaced;          //被替换掉没有发送的buffer数
+}chk_coalesce;
+
+/*
+*  getsockname/getpeername的结果,第一次获取时按地址的实际长度分配
+*/
+typedef struct {
+    int32_t              addr_type;
+    socklen_t            len;
+    char                 addr[];
+}chk_addr_cache;
+
 struct chk_stream_socket {
 	_chk_handle;
 	chk_stream_socket_option option;
-	struct iovec         wsendbuf[MAX_WBAF];
     struct iovec         wrecvbuf[2];
     uint32_t             status;
     uint32_t             next_recv_pos;
@@ -34,11 +75,23 @@ struct chk_stream_socket {
     int8_t               sending_urgent;        //标识当前是否正在发送urgent_list中的buffer
     int8_t               no_delay;
     int8_t               closed;
+    int8_t               migratable;            //允许chk_stream_socket_rebalance迁移
     struct ssl_ctx       ssl;
-    chk_sockaddr         addr_local;
-    chk_sockaddr         addr_peer;
+    chk_addr_cache      *addr_local;
+    chk_addr_cache      *addr_peer;
     close_cb_st          close_callback;
     int                  write_error;
+    uint64_t             io_bytes;              //上次rebalance之后读写的字节数
+    chk_event_loop      *migrate_to;            //迁移的目标loop,非NULL表示正在迁移
+    int32_t              migrate_events;        //迁移前关注的事件,在目标loop上恢复
+    chk_zerocopy        *zc;                    //NULL表示没有开启MSG_ZEROCOPY
+    chk_send_water      *water;                 //NULL表示没有设置水位回调
+    struct chk_group_member *groups;            //加入的socket_group
+    chk_coalesce        *coalesce;              //NULL表示没有使用合并发送
+    chk_list            *inbox;                 //共享模式下持有者之外的线程交来的发送,只在需要时分配
+    chk_stream_socket_recv_stats recv_stats;
+    uint32_t             recv_window_reads;     //接收缓冲自适应:当前窗口的读取次数
+    uint32_t             recv_window_max;       //接收缓冲自适应:当前窗口内单次读取的最大字节数
 };
 
 #endif
\ No newline at end of file
@@ -1,8 +1,16 @@
+#ifdef _LINUX
+//pthread_attr_setaffinity_np,CPU_SET
+# define _GNU_SOURCE
+#endif
 #include <stdlib.h>
+#include <errno.h>
+#include <sched.h>
 #include <sys/types.h>
 #include <sys/syscall.h>  
 #include "thread/chk_thread.h"
 #include "thread/chk_sync.h"
+#include "util/chk_log.h"
+#include "util/chk_error.h"
 
 #ifdef _LINUX
 # define gettid() syscall(__NR_gettid)  
@@ -16,6 +24,10 @@
 # define  cast(T,P) ((T)(P))
 #endif
 
+#if defined(_LINUX) && !defined(MPOL_LOCAL)
+# define MPOL_LOCAL 4
+#endif
+
 struct chk_thread {
 	pthread_t       threadid;
     pid_t           tid;   
@@ -28,11 +40,25 @@ typedef struct {
 	chk_mutex       mtx;
 	chk_condition   cond;
 	chk_thread     *t;
+	int32_t         cpu;
 }argum;
 
 __thread chk_thread *tthread = NULL;
 __thread pid_t       tid = 0;
 
+/*
+*  线程已经绑定在cpu上,内存策略设为MPOL_LOCAL后新分配的页来自当前cpu所在的节点,
+*  不受之后在其它cpu上短暂运行的影响.内核不支持NUMA时忽略
+*/
+
+static void local_mempolicy() {
+#ifdef _LINUX
+	if(0 != syscall(SYS_set_mempolicy,MPOL_LOCAL,NULL,0)) {
+		CHK_SYSLOG(LOG_DEBUG,"set_mempolicy(MPOL_LOCAL) failed errno:%d",errno);
+	}
+#endif
+}
+
 static void *start_routine(void *_) {
 	void *ret;
 	argum *starg = cast(argum*,_);
@@ -40,6 +66,9 @@ static void *start_routine(void *_) {
 	void*(*routine)(void*) = starg->routine;
 	tthread = starg->t;
 	tid = tthread->tid = gettid();
+	if(starg->cpu >= 0) {
+		local_mempolicy();
+	}
 	chk_mutex_lock(&starg->mtx);
 	if(!starg->running) {
 		starg->running = 1;
@@ -60,11 +89,31 @@ void chk_thread_del(chk_thread *t) {
 }
 
 chk_thread *chk_thread_new(void *(*routine)(void*),void *ud) {
+	return chk_thread_new_on(routine,ud,-1);
+}
+
+chk_thread *chk_thread_new_on(void *(*routine)(void*),void *ud,int32_t cpu) {
 	pthread_attr_t   attr;
 	argum 			 starg;
 	chk_thread *     t;
 	pthread_attr_init(&attr);
 	pthread_attr_setdetachstate(&attr,PTHREAD_CREATE_JOINABLE);
+#ifdef _LINUX
+	if(cpu >= 0 && cpu < CPU_SETSIZE) {
+		cpu_set_t set;
+		CPU_ZERO(&set);
+		CPU_SET(cpu,&set);
+		//在线程开始运行之前绑定,线程栈和最初的分配都在cpu所在的节点上
+		if(0 != pthread_attr_setaffinity_np(&attr,sizeof(set),&set)) {
+			CHK_SYSLOG(LOG_ERROR,"pthread_attr_setaffinity_np() failed cpu:%d",cpu);
+			cpu = -1;
+		}
+	} else {
+		cpu = -1;
+	}
+#else
+	cpu = -1;
+#endif
 
 	if(!tthread) {
 		//主线程
@@ -77,6 +126,7 @@ chk_thread *chk_thread_new(void *(*routine)(void*),void *ud) {
 	starg.arg     = ud;
 	starg.running = 0;
 	starg.t       = t;
+	starg.cpu     = cpu;
 	chk_mutex_init(&starg.mtx);
 	chk_condition_init(&starg.cond,&starg.mtx);
 	pthread_create(&t->threadid,&attr,start_routine,&starg);
@@ -98,6 +148,26 @@ void *chk_thread_join(chk_thread *t) {
 	return result;
 }
 
+int32_t chk_thread_bind_cpu(int32_t cpu) {
+#ifdef _LINUX
+	cpu_set_t set;
+	if(cpu < 0 || cpu >= CPU_SETSIZE) {
+		return chk_error_invaild_argument;
+	}
+	CPU_ZERO(&set);
+	CPU_SET(cpu,&set);
+	if(0 != pthread_setaffinity_np(pthread_self(),sizeof(set),&set)) {
+		CHK_SYSLOG(LOG_ERROR,"pthread_setaffinity_np() failed cpu:%d",cpu);
+		return chk_error_invaild_argument;
+	}
+	local_mempolicy();
+	return chk_error_ok;
+#else
+	CHK_SYSLOG(LOG_ERROR,"cpu affinity not support");
+	return chk_error_common;
+#endif
+}
+
 pid_t chk_thread_tid(chk_thread *t) {
 	return t->tid;
 }
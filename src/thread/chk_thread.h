@@ -9,6 +9,16 @@ typedef struct chk_thread chk_thread;
 //创建线程,当新线程开始运行后函数才返回
 chk_thread  *chk_thread_new(void *(*routine)(void*),void *ud);
 
+/**
+ * 创建绑定到cpu上运行的线程,线程在开始运行前完成绑定,并优先从cpu所在的NUMA节点分配内存
+ * @param cpu 绑定的cpu,小于0时与chk_thread_new相同
+ */
+
+chk_thread  *chk_thread_new_on(void *(*routine)(void*),void *ud,int32_t cpu);
+
+//把当前线程绑定到cpu上,并优先从cpu所在的NUMA节点分配内存
+int32_t      chk_thread_bind_cpu(int32_t cpu);
+
 void        *chk_thread_join(chk_thread*);
 
 void         chk_thread_del(chk_thread*);
@@ -11,7 +11,17 @@
 
 #define chk_atomic_fetch_decrease(PTR) __sync_fetch_and_sub(PTR,1)
 
+#define chk_atomic_add_fetch(PTR,N) __sync_add_and_fetch(PTR,N)
+
+#define chk_atomic_sub_fetch(PTR,N) __sync_sub_and_fetch(PTR,N)
+
 #define chk_fence __sync_synchronize
 
+#define chk_atomic_exchange(PTR,NEW) __atomic_exchange_n((PTR),(NEW),__ATOMIC_ACQ_REL)
+
+#define chk_atomic_load_acquire(PTR) __atomic_load_n((PTR),__ATOMIC_ACQUIRE)
+
+#define chk_atomic_store_release(PTR,VAL) __atomic_store_n((PTR),(VAL),__ATOMIC_RELEASE)
+
 
 #endif
\ No newline at end of file
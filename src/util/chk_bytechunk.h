@@ -24,6 +24,10 @@ enum {
     CREATE_BY_NEW      = 1,       
     NEED_COPY_ON_WRITE = 1 << 1,
     READ_ONLY          = 1 << 2,   
+    SEND_URGENT        = 1 << 3,       //共享模式stream_socket交接中,排入urgent_list的buffer
+    SEND_FILE          = 1 << 4,       //stream_socket发送队列中的文件段,不含chunk
+    SEND_GROUP         = 1 << 5,       //stream_socket发送队列中socket_group的发送游标,不含chunk
+    SEND_KEYED         = 1 << 6,       //stream_socket发送队列中带合并key的buffer
 };
 
 enum {
@@ -66,7 +66,9 @@
 	XX(53,chk_error_unpack)    												\
 	XX(54,chk_error_dgram_read)												\
 	XX(55,chk_error_dgram_set_boradcast)                                    \
-	XX(56,chk_error_dgram_boradcast_flag)
+	XX(56,chk_error_dgram_boradcast_flag)                                   \
+	XX(57,chk_error_loop_stats_disable)                                     \
+	XX(58,chk_error_not_loop_thread)
 
 enum 
   {
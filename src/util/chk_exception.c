@@ -12,7 +12,7 @@ static const char *segfault   = "segfault";
 
 static __thread chk_expn_thd *_exception_st = NULL;
 
-static void _log_stack(int32_t logLev,int32_t start,const char *prefix,void **bt);
+static void _log_stack(int32_t logLev,int32_t start,const char *prefix,void **bt,size_t btsz);
 
 void chk_exp_log_exption_stack() {
 	char    buff[256] = {0};
@@ -23,7 +23,7 @@ void chk_exp_log_exption_stack() {
                  segfault,expthd->addr);
     else
     	snprintf(buff,sizeof(buff) - 1," [exception:%s]",expthd->exception);	
-	_log_stack(LOG_ERROR,3,buff,expthd->bt);
+	_log_stack(LOG_ERROR,3,buff,expthd->bt,expthd->sz);
 }
 
 static void exception_throw(chk_expn_frame *frame,const char *exception,siginfo_t* info) {
@@ -94,7 +94,11 @@ void chk_exp_rethrow(chk_expn_frame *frame) {
 }
 
 void chk_exp_log_call_stack(const char *discription) {
-	_log_stack(LOG_DEBUG,2,discription,NULL);
+	_log_stack(LOG_DEBUG,2,discription,NULL,0);
+}
+
+void chk_exp_log_stack(int32_t logLev,const char *prefix,void **bt,int32_t size) {
+	_log_stack(logLev,0,prefix,bt,size);
 }
 
 #ifndef _MACH
@@ -251,7 +255,23 @@ static int32_t getdetail(char *str,char *output,int32_t size) {
 #endif
 }
 
-static void _log_stack(int32_t logLev,int32_t start,const char *prefix,void **bt) {
+int32_t chk_exp_symbol(void *addr,char *output,int32_t size) {
+	int32_t ret;
+	char    buf[1024];
+	char  **strings = backtrace_symbols(&addr,1);
+	if(!strings) {
+		return -1;
+	}
+	if(0 == (ret = getdetail(strings[0],buf,sizeof(buf)))) {
+		snprintf(output,size,"%s %s",strings[0],buf);
+	} else {
+		snprintf(output,size,"%s",strings[0]);
+	}
+	free(strings);
+	return ret;
+}
+
+static void _log_stack(int32_t logLev,int32_t start,const char *prefix,void **bt,size_t btsz) {
 	char**                  strings;
 	size_t                  sz;
 	int32_t                 i,f;
@@ -266,7 +286,7 @@ static void _log_stack(int32_t logLev,int32_t start,const char *prefix,void **bt
     if(!logbuf) return;
     size = chk_log_prefix(logbuf,logLev);
 	if(bt){
-		sz      = chk_exp_get_thread_expn()->sz;
+		sz      = btsz;
 		strings = backtrace_symbols(bt, sz);
 	}else{
 		sz      = backtrace(_bt, LOG_STACK_SIZE);
@@ -46,6 +46,12 @@ void chk_exp_log_call_stack(const char *discription);
 //日志记录异常调用栈
 void chk_exp_log_exption_stack();
 
+//日志记录由backtrace()获取的调用栈(可以是其它线程获取的)
+void chk_exp_log_stack(int32_t logLev,const char *prefix,void **bt,int32_t size);
+
+//获取地址对应的符号和源码位置(格式与调用栈日志相同),无法解析源码位置时只输出符号并返回-1
+int32_t chk_exp_symbol(void *addr,char *output,int32_t size);
+
 void chk_exp_throw(const char *exp);
 
 void chk_exp_rethrow(chk_expn_frame *frame);
@@ -0,0 +1,75 @@
+#ifndef _CHK_MPSC_QUEUE_H
+#define _CHK_MPSC_QUEUE_H
+
+/*
+* 无锁多生产者单消费者侵入式队列(Dmitry Vyukov)
+* push可在任意线程调用,pop/empty只能在唯一的消费者线程调用
+*/
+
+#include <stddef.h>
+#include "util/chk_atomic.h"
+
+typedef struct chk_mpsc_node chk_mpsc_node;
+
+struct chk_mpsc_node {
+	chk_mpsc_node *next;
+};
+
+typedef struct {
+	chk_mpsc_node *head;   //生产者端
+	chk_mpsc_node *tail;   //消费者端
+	chk_mpsc_node  stub;
+}chk_mpsc_queue;
+
+static inline void chk_mpsc_queue_init(chk_mpsc_queue *q) {
+	q->stub.next = NULL;
+	q->head = q->tail = &q->stub;
+}
+
+static inline void chk_mpsc_queue_push(chk_mpsc_queue *q,chk_mpsc_node *n) {
+	chk_mpsc_node *prev;
+	n->next = NULL;
+	prev = chk_atomic_exchange(&q->head,n);
+	//prev与n之间短暂断开,消费者此时看到的队列为空直到下面的store完成
+	chk_atomic_store_release(&prev->next,n);
+}
+
+/*
+* 如果生产者正处于push的中间状态返回NULL,此时chk_mpsc_queue_empty返回0,
+* 调用者应在稍后再次pop
+*/
+
+static inline chk_mpsc_node *chk_mpsc_queue_pop(chk_mpsc_queue *q) {
+	chk_mpsc_node *tail = q->tail;
+	chk_mpsc_node *next = chk_atomic_load_acquire(&tail->next);
+	if(tail == &q->stub) {
+		if(NULL == next) {
+			return NULL;
+		}
+		q->tail = tail = next;
+		next = chk_atomic_load_acquire(&tail->next);
+	}
+
+	if(next) {
+		q->tail = next;
+		return tail;
+	}
+
+	if(tail != chk_atomic_load_acquire(&q->head)) {
+		return NULL;
+	}
+
+	chk_mpsc_queue_push(q,&q->stub);
+	next = chk_atomic_load_acquire(&tail->next);
+	if(next) {
+		q->tail = next;
+		return tail;
+	}
+	return NULL;
+}
+
+static inline int32_t chk_mpsc_queue_empty(chk_mpsc_queue *q) {
+	return q->tail == &q->stub && chk_atomic_load_acquire(&q->head) == &q->stub;
+}
+
+#endif
@@ -1,8 +1,16 @@
 #define _CORE_
+#include <pthread.h>
 #include "util/chk_util.h"
 #include "util/chk_signal.h"
 #include "util/chk_error.h"
+#include "util/chk_log.h"
+#include "thread/chk_thread.h"
 #include "event/chk_event_loop.h"
+#include "event/chk_event_loop_define.h"
+
+#ifdef _LINUX
+#include <sys/signalfd.h>
+#endif
 
 #ifndef  cast
 # define  cast(T,P) ((T)(P))
@@ -10,6 +18,41 @@
 
 #define MAX_SIGNAL_SIZE 64
 
+#ifdef _LINUX
+
+/*
+* Linux下被watch的信号在loop线程中被阻塞,每个loop一个signalfd,一次读取所有到达的信号.
+* 其它没有阻塞该信号的线程收到信号时,信号处理函数只把信号转发给loop线程(在那里被阻塞,由signalfd读出),
+* 信号处理函数中不再加锁,也不需要每个信号一对管道
+*/
+
+#define SIGNALFD_BATCH 16
+
+typedef struct chk_signalfd chk_signalfd;
+
+struct chk_signalfd {
+	_chk_handle;
+	sigset_t      mask;
+	pthread_t     thread;  //loop线程
+	chk_signalfd *next;
+};
+
+typedef struct {
+	chk_signalfd *sfd;
+    int32_t signo;
+    signal_cb cb;
+    chk_ud    ud;
+    void (*ud_dctor)(chk_ud);
+}chk_signal_handler;
+
+static chk_signalfd *signalfds = NULL;
+
+//信号处理函数只读取以下两个数组
+static volatile int32_t signal_watched[MAX_SIGNAL_SIZE] = {0};
+static pthread_t        signal_threads[MAX_SIGNAL_SIZE];
+
+#else
+
 typedef struct {
 	_chk_handle;
     int32_t notify_fd;
@@ -19,11 +62,197 @@ typedef struct {
     void (*ud_dctor)(chk_ud);
 }chk_signal_handler;
 
+#endif
+
 static chk_signal_handler* signal_handlers[MAX_SIGNAL_SIZE] = {NULL};
 static int32_t lock = 0;
 #define LOCK() while (__sync_lock_test_and_set(&lock,1)) {}
 #define UNLOCK() __sync_lock_release(&lock);
 
+#ifdef _LINUX
+
+static void on_signal(int32_t signo,siginfo_t* info,void *ptr) {
+    int32_t err = errno; //save the old errno
+    if(signal_watched[signo]) {
+    	pthread_kill(signal_threads[signo],signo);
+    }
+    errno = err; //restore the old errno
+}
+
+static int32_t loop_add(chk_event_loop *e,chk_handle *h,chk_event_callback cb) {
+	return chk_watch_handle(e,h,CHK_EVENT_READ);
+}
+
+//must surround by LOCK() and UNLOCK()
+static void release_signalfd(chk_signalfd *sfd) {
+	chk_signalfd **pp;
+	for(pp = &signalfds; *pp; pp = &(*pp)->next) {
+		if(*pp == sfd) {
+			*pp = sfd->next;
+			break;
+		}
+	}
+	chk_unwatch_handle(cast(chk_handle*,sfd));
+	close(sfd->fd);
+	free(sfd);
+}
+
+//must surround by LOCK() and UNLOCK()
+static void release_signal_handler(chk_signal_handler *handler) {
+	sigset_t         set;
+	struct timespec  zero = {0,0};
+	chk_signalfd    *sfd = handler->sfd;
+	int32_t          signo = handler->signo;
+	signal_watched[signo] = 0;
+	signal(signo,SIG_DFL);
+	sigdelset(&sfd->mask,signo);
+	if(pthread_equal(sfd->thread,pthread_self())) {
+		//丢弃已经到达但还没有读取的信号,然后解除阻塞
+		sigemptyset(&set);
+		sigaddset(&set,signo);
+		while(sigtimedwait(&set,NULL,&zero) == signo);
+		pthread_sigmask(SIG_UNBLOCK,&set,NULL);
+	}
+	//sfd保留到loop关闭,之后watch其它信号时复用
+	signalfd(sfd->fd,&sfd->mask,0);
+	if(handler->ud_dctor) handler->ud_dctor(handler->ud);
+	signal_handlers[signo] = NULL;
+	free(handler);
+}
+
+static void on_events(chk_handle *h,int32_t events) {
+	int32_t                  i,n,signo;
+	struct signalfd_siginfo  infos[SIGNALFD_BATCH];
+	chk_signal_handler      *handler;
+	chk_signalfd            *sfd = cast(chk_signalfd*,h);
+	if(events == CHK_EVENT_LOOPCLOSE) {
+		LOCK();
+		for(signo = 0; signo < MAX_SIGNAL_SIZE; ++signo) {
+			handler = signal_handlers[signo];
+			if(handler && handler->sfd == sfd) {
+				release_signal_handler(handler);
+			}
+		}
+		release_signalfd(sfd);
+		UNLOCK();
+		return;
+	}
+	do {
+		n = TEMP_FAILURE_RETRY(read(sfd->fd,infos,sizeof(infos)));
+		if(n <= 0) {
+			break;
+		}
+		n /= sizeof(infos[0]);
+		for(i = 0; i < n; ++i) {
+			signo = infos[i].ssi_signo;
+			//回调中可能unwatch信号,所以每次都重新查找
+			handler = signo < MAX_SIGNAL_SIZE ? signal_handlers[signo] : NULL;
+			if(handler && handler->cb) {
+				handler->cb(handler->ud);
+			}
+		}
+	}while(n == SIGNALFD_BATCH);
+}
+
+//must surround by LOCK() and UNLOCK()
+static chk_signalfd *get_signalfd(chk_event_loop *loop) {
+	chk_signalfd *sfd;
+	for(sfd = signalfds; sfd; sfd = sfd->next) {
+		if(sfd->loop == loop) {
+			return sfd;
+		}
+	}
+	if(NULL == (sfd = calloc(1,sizeof(*sfd)))) {
+		return NULL;
+	}
+	sigemptyset(&sfd->mask);
+	if(0 > (sfd->fd = signalfd(-1,&sfd->mask,SFD_NONBLOCK | SFD_CLOEXEC))) {
+		CHK_SYSLOG(LOG_ERROR,"signalfd() failed errno:%d",errno);
+		free(sfd);
+		return NULL;
+	}
+	sfd->on_events = on_events;
+	sfd->handle_add = loop_add;
+	sfd->thread = pthread_self();
+	if(0 != chk_loop_add_handle(loop,cast(chk_handle*,sfd),NULL)) {
+		close(sfd->fd);
+		free(sfd);
+		return NULL;
+	}
+	sfd->next = signalfds;
+	signalfds = sfd;
+	return sfd;
+}
+
+int32_t chk_watch_signal(chk_event_loop *loop,int32_t signo,signal_cb cb,chk_ud ud,void (*ud_dctor)(chk_ud)) {
+	int32_t             ret = chk_error_ok;
+	chk_signal_handler *handler;
+	chk_signalfd       *sfd;
+	sigset_t            set;
+	struct sigaction    action;
+
+	//以下信号禁止watch
+	switch(signo){
+		case SIGSEGV:return chk_error_forbidden_signal;
+		default:break;
+	}
+
+	if(signo <= 0 || signo >= MAX_SIGNAL_SIZE) {
+		return chk_error_invaild_argument;
+	}
+
+	//信号需要在loop线程中阻塞
+	if(loop->threadid != chk_thread_current_tid()) {
+		CHK_SYSLOG(LOG_ERROR,"loop->threadid != chk_thread_current_tid()");
+		return chk_error_not_loop_thread;
+	}
+
+	LOCK();
+	do{
+		if(signal_handlers[signo]) {
+			ret = chk_error_create_signal_handler;
+			break;
+		}
+
+		if(NULL == (sfd = get_signalfd(loop))) {
+			ret = chk_error_create_signal_handler;
+			break;
+		}
+
+		if(NULL == (handler = calloc(1,sizeof(*handler)))) {
+			ret = chk_error_create_signal_handler;
+			break;
+		}
+		handler->sfd = sfd;
+		handler->signo = signo;
+		handler->cb = cb;
+		handler->ud = ud;
+		handler->ud_dctor = ud_dctor;
+
+		sigemptyset(&set);
+		sigaddset(&set,signo);
+		pthread_sigmask(SIG_BLOCK,&set,NULL);
+		sigaddset(&sfd->mask,signo);
+		signalfd(sfd->fd,&sfd->mask,0);
+
+		signal_threads[signo] = sfd->thread;
+		signal_watched[signo] = 1;
+		signal_handlers[signo] = handler;
+
+		sigemptyset(&action.sa_mask);
+		action.sa_flags = SA_SIGINFO | SA_RESTART;
+		action.sa_sigaction = on_signal;
+		if(0 != sigaction(signo, &action, NULL)){
+			handler->ud_dctor = NULL;//失败时ud仍然由调用者负责
+			release_signal_handler(handler);
+			ret = -1;
+		}
+	}while(0);
+	UNLOCK();
+	return ret;
+}
+
+#else
 
 static void on_signal(int32_t signo,siginfo_t* info,void *ptr) {
     chk_signal_handler *handler;
@@ -140,13 +369,17 @@ int32_t chk_watch_signal(chk_event_loop *loop,int32_t signo,signal_cb cb,chk_ud
 	return ret;
 }
 
+#endif
+
 void chk_unwatch_signal(int32_t signo) {
 	chk_signal_handler *handler;
+	if(signo <= 0 || signo >= MAX_SIGNAL_SIZE) {
+		return;
+	}
 	LOCK();
 	handler = signal_handlers[signo];
 	if(handler) {
 		release_signal_handler(handler);
 	}
-	UNLOCK();	
+	UNLOCK();
 }
-
@@ -9,6 +9,9 @@ typedef void (*signal_cb)(chk_ud);
 
 /*
  * 因为异常处理机制,SIGSEGV不允许被watch,watch SIGSEGV将返回失败
+ * Linux下信号通过signalfd读取,被watch的信号在调用线程中被阻塞,所以必须在loop所属线程中调用,
+ * 否则返回chk_error_not_loop_thread.注意之后在该线程中创建的线程和子进程会继承被阻塞的信号掩码,
+ * 子进程在exec之前应当自行解除阻塞
 */
 int32_t chk_watch_signal(chk_event_loop *,int32_t signo,signal_cb,chk_ud ud,void (*ud_dctor)(chk_ud));
 
@@ -0,0 +1,32 @@
+#define _CORE_
+#include <stdlib.h>
+#include "util/chk_time.h"
+
+static pthread_once_t tsc_once        = PTHREAD_ONCE_INIT;
+
+static double         tsc_ns_per_tick = 1.0;
+
+//以CLOCK_MONOTONIC为基准校准1毫秒,不支持RDTSC时chk_tsc()本身就是纳秒
+static void tsc_calibrate() {
+	struct timespec tv;
+	uint64_t t0,t1,n0,n1;
+	if(!_clock_rdtsc()) {
+		return;
+	}
+	_clock_gettime_boot(&tv);
+	n0 = tv.tv_sec * (uint64_t)1000000000 + tv.tv_nsec;
+	t0 = _clock_rdtsc();
+	do {
+		_clock_gettime_boot(&tv);
+		n1 = tv.tv_sec * (uint64_t)1000000000 + tv.tv_nsec;
+	}while(n1 - n0 < 1000000);
+	t1 = _clock_rdtsc();
+	if(t1 > t0) {
+		tsc_ns_per_tick = (double)(n1 - n0)/(double)(t1 - t0);
+	}
+}
+
+double chk_tsc_ns_per_tick() {
+	pthread_once(&tsc_once,tsc_calibrate);
+	return tsc_ns_per_tick;
+}
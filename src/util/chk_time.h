@@ -200,6 +200,27 @@ static inline void chk_localtime(struct tm *tm) {
 }
 
 
+/*
+*  高精度计数,用于测量短时间间隔:x86上是TSC,其它平台是CLOCK_MONOTONIC的纳秒数.
+*  两次计数的差值乘以chk_tsc_ns_per_tick()得到纳秒
+*/
+
+static inline uint64_t chk_tsc() {
+    struct timespec tv;
+    uint64_t tsc = _clock_rdtsc();
+    if(chk_likely(tsc)) {
+        return tsc;
+    }
+    _clock_gettime_boot(&tv);
+    return tv.tv_sec * (uint64_t)1000000000 + tv.tv_nsec;
+}
+
+/*
+*  chk_tsc()的一个计数对应的纳秒数,进程内第一次调用时校准
+*/
+
+double chk_tsc_ns_per_tick();
+
 static inline uint64_t chk_accurate_tick64(){
     return _clock_time();
 }
@@ -34,6 +34,9 @@ static uint16_t wheel_size[] = {
 # define  cast(T,P) ((T)(P))
 #endif
 
+//位于chk_timermgr.expired中的定时器的wtype
+#define wheel_expired -1
+
 static pthread_key_t  timer_pool_key;//用于设置key_destructor以在线程结束时清理timer_pool
 __thread chk_dlist   *timer_pool;
 
@@ -44,6 +47,8 @@ struct chk_timer {
 	uint32_t             timeout;
 	uint64_t             expire;
 	int32_t              status;
+	int8_t               wtype;    //所在的时间轮
+	chk_timermgr        *mgr;
 	chk_ud               ud;
 };
 
@@ -121,6 +126,10 @@ static inline void _reg(chk_timermgr *m,chk_timer *t,uint64_t tick) {
 			slot = w->cur + remain;
 			slot = slot >= wsize? slot-wsize:slot;
 			chk_dlist_pushback(&w->tlist[slot],&t->entry);
+			t->wtype = wtype;
+			if(wtype == wheel_sec) {
+				++m->seccount;
+			}
 			break;		
 		}else {
 			remain -= 1;
@@ -130,13 +139,38 @@ static inline void _reg(chk_timermgr *m,chk_timer *t,uint64_t tick) {
 	}while(1); 
 }
 
-static inline void _destroy_timer(chk_timer *t) {
+static inline void _destroy_timer(chk_timermgr *m,chk_timer *t) {
 	if(t->cleaner) t->cleaner(&t->ud);
 	release_timer(t);
+	--m->count;
+}
+
+//tick为当前的lasttick,到期的定时器以tick为基准重新注册
+static inline void run_timer(chk_timermgr *m,chk_timer *t,uint64_t tick) {
+	int32_t ret;
+	t->status |= INCB;
+	ret = t->cb(t->expire,t->ud);
+	t->status ^= INCB;
+	if(!(t->status & RELEASING) && ret >= 0) {
+		if(ret > 0) t->timeout = ret;
+		t->expire = CAL_EXPIRE(tick,t->timeout);
+		_reg(m,t,tick);
+	}else _destroy_timer(m,t);
+}
+
+//预算用完,剩余到期的定时器移入expired,下次chk_timer_tick时最先执行
+static inline void defer_expired(chk_timermgr *m,chk_dlist *tlist) {
+	chk_timer *t;
+	while((t = cast(chk_timer*,chk_dlist_pop(tlist)))) {
+		--m->seccount;
+		t->wtype = wheel_expired;
+		chk_dlist_pushback(&m->expired,&t->entry);
+	}
 }
 
-static void fire(chk_timermgr *m,wheel *w,uint64_t tick) {
-	int32_t    ret;
+//预算用完返回1
+static int32_t fire(chk_timermgr *m,wheel *w,uint64_t tick,chk_timer_budget_fn exhausted,void *ud) {
+	int32_t    stop = 0;
 	chk_timer *t;
 	chk_dlist  tlist;	
 	if(++(w->cur) == wheel_size[w->type]) w->cur = 0; 
@@ -145,15 +179,14 @@ static void fire(chk_timermgr *m,wheel *w,uint64_t tick) {
 		chk_dlist_move(&tlist,&w->tlist[w->cur]);				
 		if(w->type == wheel_sec) {		
 			while((t = cast(chk_timer*,chk_dlist_pop(&tlist)))) {
-				t->status |= INCB;
+				--m->seccount;
 				assert(tick == t->expire);
-				ret = t->cb(tick,t->ud);
-				t->status ^= INCB;
-				if(!(t->status & RELEASING) && ret >= 0) {
-					if(ret > 0) t->timeout = ret;
-					t->expire = CAL_EXPIRE(tick,t->timeout);
-					_reg(m,t,tick);
-				}else _destroy_timer(t);
+				run_timer(m,t,tick);
+				if(exhausted && exhausted(ud)) {
+					defer_expired(m,&tlist);
+					stop = 1;
+					break;
+				}
 			}		
 		}else {		
 			while((t = cast(chk_timer*,chk_dlist_pop(&tlist))))
@@ -161,12 +194,14 @@ static void fire(chk_timermgr *m,wheel *w,uint64_t tick) {
 		}
 	}
 	if(w->cur + 1 == wheel_size[w->type] && w->type < wheel_day)
-		fire(m,m->wheels[w->type+1],tick);
+		fire(m,m->wheels[w->type+1],tick,NULL,NULL);
+	return stop;
 }
 
 int32_t chk_timermgr_init(chk_timermgr *m) {
 	int8_t i;
 	m->ptrtick = NULL;
+	chk_dlist_init(&m->expired);
 	for(i = 0; i <= wheel_day; ++i){
 		m->wheels[i] = wheel_new(i);
 		if(!m->wheels[i]) return -1;		
@@ -178,13 +213,15 @@ void chk_timermgr_finalize(chk_timermgr *m) {
 	int16_t     i,j,size;
 	chk_dlist  *tlist;
 	chk_timer  *t;
+	while((t = cast(chk_timer*,chk_dlist_pop(&m->expired))))
+		_destroy_timer(m,t);
 	for(i = 0; i <= wheel_day; ++i) {
 		if(!m->wheels[i]) break;
 		size = wheel_size[m->wheels[i]->type];
 		for(j = 0; j < size; ++j) {
 			tlist = &m->wheels[i]->tlist[j];
 			while((t = cast(chk_timer*,chk_dlist_pop(tlist))))
-				_destroy_timer(t);				
+				_destroy_timer(m,t);				
 		}
 		free(m->wheels[i]);
 	}	
@@ -202,13 +239,66 @@ chk_timermgr *chk_timermgr_new() {
 }
 
 void chk_timer_tick(chk_timermgr *m,uint64_t now) {
-	if(!m->ptrtick) return;//没有注册过定时器
+	chk_timer_tick_budget(m,now,NULL,NULL);
+} 
+
+int32_t chk_timer_tick_budget(chk_timermgr *m,uint64_t now,chk_timer_budget_fn exhausted,void *ud) {
+	chk_timer *t;
+	if(!m->ptrtick) return 0;//没有注册过定时器
+	//先执行上次因预算用完而推迟的定时器
+	while((t = cast(chk_timer*,chk_dlist_pop(&m->expired)))) {
+		run_timer(m,t,m->lasttick);
+		if(exhausted && exhausted(ud)) {
+			return 1;
+		}
+	}
+	if(0 == m->count) {
+		//时间轮为空,直接跳到now,避免长时间休眠后逐毫秒空转
+		m->lasttick = now;
+		return 0;
+	}
 	while(m->lasttick != now) {
 		INC_LASTTICK(m->lasttick);
-		fire(m,m->wheels[wheel_sec],m->lasttick);
+		if(fire(m,m->wheels[wheel_sec],m->lasttick,exhausted,ud)) {
+			return !chk_dlist_empty(&m->expired) || m->lasttick != now;
+		}
 	}
+	return 0;
 } 
 
+int32_t chk_timermgr_next_timeout(chk_timermgr *m,uint64_t now) {
+	wheel    *w;
+	uint32_t  k,kc,slot,wsize;
+	uint64_t  elapse;
+	if(!m->ptrtick || 0 == m->count) {
+		return -1;
+	}
+	if(!chk_dlist_empty(&m->expired)) {
+		return 0;
+	}
+	w     = m->wheels[wheel_sec];
+	wsize = wheel_size[wheel_sec];
+	k     = wsize;
+	if(m->seccount > 0) {
+		//w->cur对应lasttick,slot(cur+k)在lasttick+k到期
+		for(k = 1; k < wsize; ++k) {
+			slot = w->cur + k;
+			slot = slot >= wsize ? slot - wsize : slot;
+			if(!chk_dlist_empty(&w->tlist[slot])) break;
+		}
+	}
+
+	if(m->count > m->seccount) {
+		//高层时间轮中的定时器在wheel_sec转满一圈(cur == wsize-1)时被移入wheel_sec
+		kc = wsize - 1 - w->cur;
+		if(kc == 0) kc = wsize;
+		if(kc < k) k = kc;
+	}
+
+	elapse = now > m->lasttick ? now - m->lasttick : 0;
+	return k > elapse ? cast(int32_t,k - elapse) : 0;
+}
+
 chk_timer *chk_timer_register(chk_timermgr *m,uint32_t ms,chk_timeout_cb cb,chk_ud ud,uint64_t now) {
 	chk_timer *t;
 	if(!cb){
@@ -221,6 +311,8 @@ chk_timer *chk_timer_register(chk_timermgr *m,uint32_t ms,chk_timeout_cb cb,chk_
 	t->timeout = ms > MAX_TIMEOUT ? MAX_TIMEOUT : (ms > 0 ? ms : 1);
 	t->cb = cb;
 	t->ud = ud;
+	t->mgr = m;
+	++m->count;
 	if(chk_unlikely(!m->ptrtick)){
 		m->ptrtick  = &m->lasttick;
 		m->lasttick = now;
@@ -235,7 +327,10 @@ void chk_timer_unregister(chk_timer *t) {
 	t->status |= RELEASING;
 	if(!(t->status & INCB)){
 		chk_dlist_remove(cast(chk_dlist_entry*,t));
-		_destroy_timer(t);
+		if(t->wtype == wheel_sec) {
+			--t->mgr->seccount;
+		}
+		_destroy_timer(t->mgr,t);
 	}
 }
 
@@ -67,6 +67,29 @@ void chk_timer_set_ud_cleaner(chk_timer *t,chk_timer_ud_cleaner clearfn);
 
 void chk_timer_tick(chk_timermgr *m,uint64_t now);
 
+//每执行完一个定时器回调调用一次,返回非0表示本次驱动的预算已经用完
+typedef int32_t (*chk_timer_budget_fn)(void *ud);
+
+/**
+ * 带预算的驱动定时管理器,预算用完时停止,剩余到期的定时器在下次驱动时最先执行
+ * @param m 定时管理器
+ * @param now 当前时间
+ * @param exhausted 预算检查函数,NULL表示不限制
+ * @param ud 传给exhausted的参数
+ * @return 还有到期的定时器没有执行返回1,否则返回0
+ */
+
+int32_t chk_timer_tick_budget(chk_timermgr *m,uint64_t now,chk_timer_budget_fn exhausted,void *ud);
+
+/**
+ * 返回距离下一次需要驱动定时管理器的毫秒数,没有定时器返回-1
+ * event_loop以此作为等待事件的超时时间,没有定时器到期时不会被唤醒
+ * @param m 定时管理器
+ * @param now 当前时间
+ */
+
+int32_t chk_timermgr_next_timeout(chk_timermgr *m,uint64_t now);
+
 //just for test
 uint64_t chk_timer_expire(chk_timer*);
 
@@ -20,6 +20,9 @@ struct chk_timermgr {
 	wheel 		*wheels[wheel_day+1];
 	uint64_t    *ptrtick;
 	uint64_t     lasttick;
+	uint32_t     count;      //定时器总数
+	uint32_t     seccount;   //位于wheel_sec中的定时器数量
+	chk_dlist    expired;    //已经到期,因为预算用完还没有执行的定时器
 };
 
 #endif
\ No newline at end of file
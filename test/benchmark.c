@@ -35,7 +35,10 @@ void server_event_cb(chk_stream_socket *s,chk_bytebuffer *data,int32_t error) {
 		uint64_t duration = now - lastshow;
 		if(duration >= 1000) {
 			lastshow = now;
-			printf("client:%d,%.2fMB/s,%.2fpkt/s\n",c,(bytesize/1024/1024)*1000/duration,packet_count*1000/duration);
+			uint64_t requested,flushed;
+			chk_loop_interest_stats(loop,&requested,&flushed);
+			printf("client:%d,%.2fMB/s,%.2fpkt/s,interest update:%llu,saved:%llu\n",c,(bytesize/1024/1024)*1000/duration,packet_count*1000/duration,
+				(unsigned long long)requested,(unsigned long long)(requested > flushed ? requested - flushed : 0));
 			bytesize = 0;
 			packet_count = 0;			
 		}
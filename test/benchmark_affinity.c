@@ -0,0 +1,143 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "chuck.h"
+
+/*
+* cpu绑定和连接引导前后的对比,每个cpu一个loop的echo服务,客户端在子进程中做ping-pong.
+* 统计服务端进程(包括loop线程)的cache miss,每个请求的cache miss,
+* 以及在接收连接的cpu上被处理的连接比例.
+* 用法: benchmark_affinity bind|nobind
+*/
+
+#define CONN_COUNT 64
+#define DURATION   10
+
+chk_event_loop *loop;
+
+uint64_t request_count = 0;
+
+int local_count = 0;
+
+int accept_count = 0;
+
+chk_stream_socket_option option = {
+	.recv_buffer_size = 1024,
+	.decoder = NULL,
+};
+
+static int perf_open(uint64_t config) {
+	struct perf_event_attr attr;
+	memset(&attr,0,sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = config;
+	attr.disabled = 1;
+	attr.inherit = 1;
+	attr.exclude_kernel = 1;
+	return syscall(__NR_perf_event_open,&attr,0,-1,-1,0);
+}
+
+void server_event_cb(chk_stream_socket *s,chk_bytebuffer *data,int32_t error) {
+	if(data) {
+		__sync_fetch_and_add(&request_count,1);
+		chk_stream_socket_send(s,chk_bytebuffer_clone(data));
+	} else {
+		chk_stream_socket_close(s,0);
+	}
+}
+
+void on_new_client(chk_acceptor *a,int32_t fd,chk_sockaddr *addr,chk_ud ud,int32_t err) {
+	if(err) return;
+	__sync_fetch_and_add(&accept_count,1);
+	if(easy_get_incoming_cpu(fd) == sched_getcpu()) {
+		__sync_fetch_and_add(&local_count,1);
+	}
+	chk_stream_socket *s = chk_stream_socket_new(fd,&option);
+	chk_loop_add_handle(chk_acceptor_get_loop(a),(chk_handle*)s,server_event_cb);
+}
+
+void client_event_cb(chk_stream_socket *s,chk_bytebuffer *data,int32_t error) {
+	if(data) {
+		chk_stream_socket_send(s,chk_bytebuffer_clone(data));
+	} else {
+		chk_stream_socket_close(s,0);
+	}
+}
+
+void connect_callback(int32_t fd,chk_ud ud,int32_t err) {
+	if(0 == err) {
+		chk_stream_socket *s = chk_stream_socket_new(fd,&option);
+		chk_loop_add_handle(loop,(chk_handle*)s,client_event_cb);
+		chk_bytebuffer *msg = chk_bytebuffer_new(64);
+		chk_bytebuffer_append(msg,(uint8_t*)"ping",4);
+		chk_stream_socket_send(s,msg);
+	}
+}
+
+int32_t stop_cb(uint64_t tick,chk_ud ud) {
+	chk_loop_end(loop);
+	return -1;
+}
+
+static void client(chk_sockaddr *addr) {
+	int i;
+	loop = chk_loop_new();
+	for(i = 0; i < CONN_COUNT; ++i) {
+		chk_easy_async_connect(loop,addr,NULL,connect_callback,chk_ud_make_void(NULL),-1);
+	}
+	chk_loop_addtimer(loop,DURATION * 1000,stop_cb,chk_ud_make_void(NULL));
+	chk_loop_run(loop);
+	exit(0);
+}
+
+int main(int argc,char **argv) {
+	int i,fd;
+	pid_t pid;
+	uint64_t misses = 0;
+	chk_sockaddr addr;
+	int32_t nproc = sysconf(_SC_NPROCESSORS_ONLN);
+	int32_t *cpus;
+	chk_loop_group *g;
+	if(argc < 2 || (strcmp(argv[1],"bind") && strcmp(argv[1],"nobind"))) {
+		printf("usage benchmark_affinity bind|nobind\n");
+		return 0;
+	}
+	signal(SIGPIPE,SIG_IGN);
+	easy_sockaddr_ip4(&addr,"127.0.0.1",8012);
+
+	g = chk_loop_group_new(nproc);
+	if(0 == strcmp(argv[1],"bind")) {
+		cpus = calloc(nproc,sizeof(*cpus));
+		for(i = 0; i < nproc; ++i) {
+			cpus[i] = i;
+		}
+		chk_loop_group_bind_cpus(g,cpus,nproc);
+		free(cpus);
+	}
+	chk_loop_group_listen(g,&addr,on_new_client,chk_ud_make_void(NULL));
+
+	//在创建loop线程之前打开,计数被loop线程继承
+	fd = perf_open(PERF_COUNT_HW_CACHE_MISSES);
+	if(fd >= 0) {
+		ioctl(fd,PERF_EVENT_IOC_RESET,0);
+		ioctl(fd,PERF_EVENT_IOC_ENABLE,0);
+	}
+	chk_loop_group_start(g,NULL,NULL,chk_ud_make_void(NULL));
+
+	if(0 == (pid = fork())) {
+		client(&addr);
+	}
+	waitpid(pid,NULL,0);
+	chk_loop_group_del(g);
+
+	printf("%s loops:%d,requests:%llu,local accept:%d/%d",argv[1],nproc,(unsigned long long)request_count,local_count,accept_count);
+	if(fd >= 0 && sizeof(misses) == read(fd,&misses,sizeof(misses))) {
+		printf(",cache miss:%llu,per request:%.2f\n",(unsigned long long)misses,request_count ? (double)misses/request_count : 0);
+	} else {
+		printf(",cache miss:unavailable\n");
+	}
+	return 0;
+}
@@ -35,20 +35,33 @@ typedef struct {
 
 chk_dlist _clients;
 
+//group模式以chk_socket_group广播,一次广播只有一份消息
+int use_group = 0;
+
+chk_socket_group *group;
+
 void server_event_cb(chk_stream_socket *s,chk_bytebuffer *data,int32_t error) {
 	if(data) {
-		chk_dlist_entry *it = chk_dlist_begin(&_clients);
-		chk_dlist_entry *end = chk_dlist_end(&_clients);
-		for( ; it != end; it = it->next) {
-			packet_count += 1;
-			chk_stream_socket *ss = ((_client*)it)->s;
-			chk_stream_socket_send(ss,chk_bytebuffer_clone(data));
+		if(use_group) {
+			packet_count += cc;
+			chk_socket_group_broadcast(group,chk_bytebuffer_clone(data));
+		} else {
+			chk_dlist_entry *it = chk_dlist_begin(&_clients);
+			chk_dlist_entry *end = chk_dlist_end(&_clients);
+			for( ; it != end; it = it->next) {
+				packet_count += 1;
+				chk_stream_socket *ss = ((_client*)it)->s;
+				chk_stream_socket_send(ss,chk_bytebuffer_clone(data));
+			}
 		}
 		uint64_t now = chk_systick();
 		uint64_t duration = now - lastshow;
 		if(duration >= 1000) {
 			lastshow = now;
-			printf("client:%d,pkt:%.2f/s\n",cc,(packet_count*1000)/duration);
+			uint64_t requested,flushed;
+			chk_loop_interest_stats(loop,&requested,&flushed);
+			printf("client:%d,pkt:%.2f/s,interest update:%llu,saved:%llu\n",cc,(packet_count*1000)/duration,
+				(unsigned long long)requested,(unsigned long long)(requested > flushed ? requested - flushed : 0));
 			packet_count = 0;			
 		}
 	} else {	
@@ -73,11 +86,15 @@ void on_new_client(chk_acceptor *a,int32_t fd,chk_sockaddr *addr,chk_ud ud,int32
 	chk_stream_socket_setUd(s,chk_ud_make_void(c));
 	chk_dlist_pushback(&_clients,(&c->entry));
 	chk_loop_add_handle(loop,(chk_handle*)s,server_event_cb);
+	if(use_group) {
+		chk_socket_group_add(group,s);
+	}
 	++cc;
 }
 
 int server() {
 	chk_dlist_init(&_clients);
+	group = chk_socket_group_new();
 	lastshow = chk_systick();
     chk_sockaddr addr_local;
     easy_sockaddr_ip4(&addr_local,ip,port);
@@ -137,7 +154,7 @@ void client() {
 int main(int argc,char **argv) {
 
 	if(argc < 4) {
-		printf("usage: benchmark_brocast [server|client|both] ip port [clientcount]\n");
+		printf("usage: benchmark_brocast [server|client|both] ip port [clientcount] [group]\n");
 		return 0;
 	}
 
@@ -145,7 +162,7 @@ int main(int argc,char **argv) {
 
 	if(strcmp(type,"client") == 0 || strcmp(type,"both") == 0 ) {
 		if(argc < 5) {
-			printf("usage: benchmark_brocast [server|client|both] ip port [clientcount]\n");
+			printf("usage: benchmark_brocast [server|client|both] ip port [clientcount] [group]\n");
 			return 0;
 		}
 	}
@@ -153,6 +170,8 @@ int main(int argc,char **argv) {
 	signal(SIGPIPE,SIG_IGN);
 	loop = chk_loop_new();	
 
+	use_group = strcmp(argv[argc - 1],"group") == 0;
+
 	ip = argv[2];
 	port = atoi(argv[3]);
 
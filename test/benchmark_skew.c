@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include "chuck.h"
+
+/*
+* 连接负载倾斜时的吞吐对比:
+*   static 每个连接固定在一个loop上(与SO_REUSEPORT分配连接的效果相同),
+*   shared 所有worker共享一个epoll(EPOLLONESHOT),就绪的连接由空闲的worker处理.
+* CONN_COUNT个ping-pong连接中,下标为LOOP_COUNT倍数的连接是重连接,每个请求忙等HEAVY_US微秒,
+* static模式下它们都落在loop 0上,和它们同loop的轻连接被拖慢.
+* 用法: benchmark_skew static|shared
+*/
+
+#define LOOP_COUNT 4
+#define CONN_COUNT 16
+#define HEAVY_US   500
+#define LIGHT_US   10
+#define DURATION   10
+
+chk_event_loop *loop;
+
+chk_loop_group *group;
+
+uint64_t heavy_count = 0;
+
+uint64_t light_count = 0;
+
+uint64_t lastshow;
+
+int seconds = 0;
+
+chk_stream_socket_option option = {
+	.recv_buffer_size = 1024,
+	.decoder = NULL,
+};
+
+double ns_per_tick;
+
+static void busy(uint32_t us) {
+	uint64_t start = chk_tsc();
+	while((chk_tsc() - start) * ns_per_tick < us * 1000.0);
+}
+
+void server_event_cb(chk_stream_socket *s,chk_bytebuffer *data,int32_t error) {
+	if(data) {
+		busy(chk_stream_socket_getUd(s).v.i64 % LOOP_COUNT == 0 ? HEAVY_US : LIGHT_US);
+		chk_stream_socket_send(s,chk_bytebuffer_clone(data));
+	} else {
+		chk_stream_socket_close(s,0);
+	}
+}
+
+static void add_to_loop(chk_ud ud) {
+	chk_stream_socket *s = (chk_stream_socket*)ud.v.val;
+	int64_t idx = chk_stream_socket_getUd(s).v.i64;
+	chk_loop_add_handle(chk_loop_group_get(group,idx % LOOP_COUNT),(chk_handle*)s,server_event_cb);
+}
+
+void client_event_cb(chk_stream_socket *s,chk_bytebuffer *data,int32_t error) {
+	if(data) {
+		if(chk_stream_socket_getUd(s).v.i64 % LOOP_COUNT == 0) {
+			++heavy_count;
+		} else {
+			++light_count;
+		}
+		chk_stream_socket_send(s,chk_bytebuffer_clone(data));
+	} else {
+		chk_stream_socket_close(s,0);
+	}
+}
+
+int32_t show_cb(uint64_t tick,chk_ud ud) {
+	printf("%s heavy:%llu req/s,light:%llu req/s,total:%llu req/s\n",(const char*)ud.v.val,
+		   (unsigned long long)heavy_count,(unsigned long long)light_count,(unsigned long long)(heavy_count + light_count));
+	heavy_count = light_count = 0;
+	if(++seconds == DURATION) {
+		chk_loop_end(loop);
+		return -1;
+	}
+	return 0;
+}
+
+int main(int argc,char **argv) {
+	int i,shared;
+	int32_t fds[2];
+	chk_stream_socket *s;
+	chk_bytebuffer *msg;
+	if(argc < 2 || (strcmp(argv[1],"static") && strcmp(argv[1],"shared"))) {
+		printf("usage benchmark_skew static|shared\n");
+		return 0;
+	}
+	signal(SIGPIPE,SIG_IGN);
+	ns_per_tick = chk_tsc_ns_per_tick();
+	shared = 0 == strcmp(argv[1],"shared");
+	if(shared) {
+		group = chk_loop_group_new_shared(LOOP_COUNT);
+	} else {
+		group = chk_loop_group_new(LOOP_COUNT);
+	}
+	chk_loop_group_start(group,NULL,NULL,chk_ud_make_void(NULL));
+
+	loop = chk_loop_new();
+	for(i = 0; i < CONN_COUNT; ++i) {
+		socketpair(AF_UNIX,SOCK_STREAM,0,fds);
+		s = chk_stream_socket_new(fds[0],&option);
+		chk_stream_socket_setUd(s,chk_ud_make_i64(i));
+		if(shared) {
+			chk_loop_group_add_handle(group,(chk_handle*)s,server_event_cb);
+		} else {
+			chk_loop_post_closure(chk_loop_group_get(group,i % LOOP_COUNT),add_to_loop,chk_ud_make_void(s));
+		}
+		s = chk_stream_socket_new(fds[1],&option);
+		chk_stream_socket_setUd(s,chk_ud_make_i64(i));
+		chk_loop_add_handle(loop,(chk_handle*)s,client_event_cb);
+		msg = chk_bytebuffer_new(64);
+		chk_bytebuffer_append(msg,(uint8_t*)"ping",4);
+		chk_stream_socket_send(s,msg);
+	}
+	chk_loop_addtimer(loop,1000,show_cb,chk_ud_make_void(argv[1]));
+	chk_loop_run(loop);
+	chk_loop_group_del(group);
+	chk_loop_del(loop);
+	return 0;
+}
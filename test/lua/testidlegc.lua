@@ -0,0 +1,78 @@
+package.cpath = './lib/?.so;'
+
+local chuck = require("chuck")
+local event_loop = chuck.event_loop.New()
+
+--空闲GC模式:前半段每10ms产生少量垃圾,回收在空闲时完成;
+--后半段每轮循环都忙于分配,只有内存增长超过force_kb时才强制步进,内存仍然有界.
+--两段的GC停顿都应受budget_us限制:一次停顿可以超出一个LUA_GCSTEP,再加上线程被抢占,
+--只允许极少数停顿超过4倍的budget_us
+
+event_loop:EnableStats()
+event_loop:SetBudget({timer_count=1})
+local budget_us = 500
+event_loop:SetLuaGC({step_kb=32,budget_us=budget_us,force_kb=2048})
+assert(not collectgarbage("isrunning"))
+
+local function busy(ms)
+	local t = os.clock()
+	while os.clock() - t < ms / 1000 do end
+end
+
+local function garbage(n)
+	local t = {}
+	for i = 1,n do t[i] = {i} end
+end
+
+local function check_pause(stats)
+	local total,over = 0,0
+	for _,v in ipairs(stats.gc_pause) do
+		total = total + v[2]
+		if v[1] > 4 * budget_us then
+			over = over + v[2]
+		end
+	end
+	print("pause","total",total,"over",over,"p50",stats.gc_p50)
+	assert(total > 0 and over <= total * 0.02 and stats.gc_p50 <= 2 * budget_us)
+end
+
+local count = 0
+local max_kb = 0
+
+event_loop:AddTimer(10,function ()
+	garbage(200)
+	count = count + 1
+	if count == 100 then
+		local stats = event_loop:GetStats()
+		print("idle","cycles",stats.gc_cycles,"forced",stats.gc_forced,"p50",stats.gc_p50,"p99",stats.gc_p99)
+		assert(stats.gc_cycles > 0 and stats.gc_forced == 0)
+		check_pause(stats)
+		return -1
+	end
+end)
+
+event_loop:AddTimer(1100,function ()
+	local n = 0
+	event_loop:AddTimer(1,function ()
+		garbage(2000)
+		busy(2)
+		max_kb = math.max(max_kb,collectgarbage("count"))
+		n = n + 1
+		if n == 500 then
+			event_loop:Stop()
+			return -1
+		end
+	end)
+	return -1
+end)
+
+event_loop:Run()
+
+local stats = event_loop:GetStats()
+print("busy","cycles",stats.gc_cycles,"forced",stats.gc_forced,"max kb",max_kb)
+assert(stats.gc_forced > 0 and max_kb < 64 * 1024)
+check_pause(stats)
+
+event_loop:SetLuaGC(nil)
+assert(collectgarbage("isrunning"))
+print("ok")
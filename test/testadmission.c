@@ -0,0 +1,109 @@
+#include <stdio.h>
+#include "testhelper.h"
+
+/*
+* acceptor准入控制:loop被回调拖慢(延迟超过lag_high)时暂停acceptor,
+* 期间发起的连接在恢复之后才被接受;reject模式下过载期间的连接被立即以RST关闭
+*/
+
+chk_event_loop *loop;
+
+chk_acceptor *acceptor;
+
+int accept_count = 0;
+
+void on_new_client(chk_acceptor *a,int32_t fd,chk_sockaddr *addr,chk_ud ud,int32_t err) {
+	if(0 == err) {
+		++accept_count;
+		close(fd);
+	}
+}
+
+static int client(chk_sockaddr *addr) {
+	int fd = socket(AF_INET,SOCK_STREAM,IPPROTO_TCP);
+	easy_connect(fd,addr,NULL);
+	return fd;
+}
+
+static void run_for(uint32_t ms) {
+	uint64_t start = chk_accurate_tick64();
+	while(chk_accurate_tick64() - start < ms) {
+		chk_loop_run_once(loop,5);
+	}
+}
+
+//每轮循环前忙等,直到进入过载
+static int overload(chk_acceptor_admission_state *state) {
+	int i;
+	for(i = 0; i < 20; ++i) {
+		busy(40);
+		chk_loop_run_once(loop,0);
+		chk_acceptor_get_admission(acceptor,NULL,state);
+		if(state->overloaded) {
+			return 1;
+		}
+	}
+	return 0;
+}
+
+int main(int argc,char **argv) {
+	int i,fd,ret,paused_ok,resumed_ok,reset_ok;
+	char c;
+	chk_sockaddr addr;
+	chk_acceptor_admission admission = {0};
+	chk_acceptor_admission_state state;
+	signal(SIGPIPE,SIG_IGN);
+	loop = chk_loop_new();
+	easy_sockaddr_ip4(&addr,"127.0.0.1",8013);
+	acceptor = chk_listen(loop,&addr,on_new_client,chk_ud_make_void(NULL));
+	if(!acceptor) {
+		printf("listen failed\n");
+		return 0;
+	}
+	admission.interval = 10;
+	admission.lag_high = 20;
+	admission.lag_low  = 5;
+	chk_acceptor_set_admission(acceptor,&admission);
+
+	client(&addr);
+	run_for(50);
+
+	if(!overload(&state)) {
+		printf("not overloaded\n");
+		return 0;
+	}
+	//过载期间acceptor暂停,连接留在backlog中
+	client(&addr);
+	for(i = 0; i < 3; ++i) {
+		busy(40);
+		chk_loop_run_once(loop,0);
+	}
+	paused_ok = accept_count == 1;
+	run_for(200);
+	chk_acceptor_get_admission(acceptor,NULL,&state);
+	resumed_ok = accept_count == 2 && !state.overloaded;
+	printf("paused:%d,resumed:%d,lag:%u\n",paused_ok,resumed_ok,state.lag);
+
+	admission.reject = 1;
+	chk_acceptor_set_admission(acceptor,&admission);
+	if(!overload(&state)) {
+		printf("not overloaded\n");
+		return 0;
+	}
+	fd = client(&addr);
+	for(i = 0; i < 3; ++i) {
+		busy(40);
+		chk_loop_run_once(loop,0);
+	}
+	ret = recv(fd,&c,1,0);
+	reset_ok = ret < 0 && errno == ECONNRESET;
+	chk_acceptor_get_admission(acceptor,NULL,&state);
+	printf("reject:%llu,reset:%d,accept:%d\n",(unsigned long long)state.rejected,reset_ok,accept_count);
+
+	if(paused_ok && resumed_ok && reset_ok && state.rejected == 1 && accept_count == 2) {
+		printf("ok\n");
+	}
+	chk_acceptor_del(acceptor);
+	chk_loop_del(loop);
+	return 0;
+}
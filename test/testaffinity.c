@@ -0,0 +1,110 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <sched.h>
+#include "chuck.h"
+
+/*
+* cpu绑定:loop i绑定到cpu i % nproc,检查每个loop线程运行在绑定的cpu上,
+* 每个连接被接收它的cpu(SO_INCOMING_CPU)上的loop接受
+*/
+
+#define LOOP_COUNT   4
+#define CLIENT_COUNT 100
+
+chk_event_loop *loop;
+
+int32_t cpus[LOOP_COUNT];
+
+int wrong_cpu = 0;
+
+int steered = 0;
+
+int accept_count = 0;
+
+int echo_count = 0;
+
+chk_stream_socket_option option = {
+	.recv_buffer_size = 1024,
+	.decoder = NULL,
+};
+
+void server_event_cb(chk_stream_socket *s,chk_bytebuffer *data,int32_t error) {
+	if(data) {
+		chk_stream_socket_send(s,chk_bytebuffer_clone(data));
+	} else {
+		chk_stream_socket_close(s,0);
+	}
+}
+
+void on_group_start(chk_loop_group *g,chk_event_loop *l,uint32_t idx,chk_ud ud) {
+	if(sched_getcpu() != cpus[idx]) {
+		__sync_fetch_and_add(&wrong_cpu,1);
+	}
+}
+
+void on_new_client(chk_acceptor *a,int32_t fd,chk_sockaddr *addr,chk_ud ud,int32_t err) {
+	if(err) return;
+	__sync_fetch_and_add(&accept_count,1);
+	if(easy_get_incoming_cpu(fd) == sched_getcpu()) {
+		__sync_fetch_and_add(&steered,1);
+	}
+	chk_stream_socket *s = chk_stream_socket_new(fd,&option);
+	chk_loop_add_handle(chk_acceptor_get_loop(a),(chk_handle*)s,server_event_cb);
+}
+
+void client_event_cb(chk_stream_socket *s,chk_bytebuffer *data,int32_t error) {
+	if(data) {
+		if(++echo_count == CLIENT_COUNT) {
+			chk_loop_end(loop);
+		}
+	}
+	chk_stream_socket_close(s,0);
+}
+
+void connect_callback(int32_t fd,chk_ud ud,int32_t err) {
+	if(0 == err) {
+		chk_stream_socket *s = chk_stream_socket_new(fd,&option);
+		chk_loop_add_handle(loop,(chk_handle*)s,client_event_cb);
+		chk_bytebuffer *msg = chk_bytebuffer_new(64);
+		chk_bytebuffer_append(msg,(uint8_t*)"hello",5);
+		chk_stream_socket_send(s,msg);
+	} else {
+		printf("connect error\n");
+	}
+}
+
+int main(int argc,char **argv) {
+	int i;
+	chk_sockaddr addr;
+	int32_t nproc = sysconf(_SC_NPROCESSORS_ONLN);
+	signal(SIGPIPE,SIG_IGN);
+	easy_sockaddr_ip4(&addr,"127.0.0.1",8011);
+	for(i = 0; i < LOOP_COUNT; ++i) {
+		cpus[i] = i % nproc;
+	}
+
+	chk_loop_group *g = chk_loop_group_new(LOOP_COUNT);
+	if(0 != chk_loop_group_bind_cpus(g,cpus,LOOP_COUNT)) {
+		printf("chk_loop_group_bind_cpus failed\n");
+		return 0;
+	}
+	if(0 != chk_loop_group_listen(g,&addr,on_new_client,chk_ud_make_void(g))) {
+		printf("chk_loop_group_listen failed\n");
+		return 0;
+	}
+	chk_loop_group_start(g,on_group_start,NULL,chk_ud_make_void(NULL));
+
+	loop = chk_loop_new();
+	for(i = 0; i < CLIENT_COUNT; ++i) {
+		chk_easy_async_connect(loop,&addr,NULL,connect_callback,chk_ud_make_void(NULL),-1);
+	}
+	chk_loop_run(loop);
+	chk_loop_group_del(g);
+	chk_loop_del(loop);
+
+	printf("accept:%d,steered:%d,wrong cpu:%d,echo:%d\n",accept_count,steered,wrong_cpu,echo_count);
+	if(echo_count == CLIENT_COUNT && accept_count == CLIENT_COUNT && steered == CLIENT_COUNT && wrong_cpu == 0) {
+		printf("ok\n");
+	}
+	return 0;
+}
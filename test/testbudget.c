@@ -0,0 +1,92 @@
+#include <stdio.h>
+#include "chuck.h"
+
+/*
+* 每轮循环的预算和handle优先级:
+* io_count=1时,三个同时就绪的连接按HIGH,NORMAL,LOW的顺序每轮处理一个;
+* timer_count=1时,同时到期的三个定时器每轮执行一个;
+* closure_count=2时,投递的5个closure分3轮执行完
+*/
+
+chk_event_loop *loop;
+
+char order[16];
+
+int  norder = 0;
+
+int  timer_count = 0;
+
+int  closure_count = 0;
+
+chk_stream_socket_option option = {
+	.recv_buffer_size = 1024,
+	.decoder = NULL,
+};
+
+void data_cb(chk_stream_socket *s,chk_bytebuffer *data,int32_t error) {
+	if(data) {
+		order[norder++] = *(char*)chk_stream_socket_getUd(s).v.val;
+	}
+}
+
+int32_t timer_cb(uint64_t tick,chk_ud ud) {
+	++timer_count;
+	return -1;
+}
+
+static void on_closure(chk_ud ud) {
+	++closure_count;
+}
+
+static chk_stream_socket *new_socket(int32_t fds[2],const char *name,int8_t priority) {
+	chk_stream_socket *s;
+	socketpair(AF_UNIX,SOCK_STREAM,0,fds);
+	easy_noblock(fds[0],1);
+	s = chk_stream_socket_new(fds[0],&option);
+	chk_stream_socket_setUd(s,chk_ud_make_void((void*)name));
+	chk_loop_set_priority((chk_handle*)s,priority);
+	chk_loop_add_handle(loop,(chk_handle*)s,data_cb);
+	TEMP_FAILURE_RETRY(write(fds[1],"x",1));
+	return s;
+}
+
+int main(int argc,char **argv) {
+	int i;
+	int32_t fds[3][2];
+	int timers[3],closures[3];
+	chk_loop_budget budget;
+	loop = chk_loop_new();
+	chk_loop_get_budget(loop,&budget);
+	if(budget.closure_count != CHK_LOOP_CLOSURE_BUDGET) {
+		printf("default closure budget error\n");
+		return 0;
+	}
+	budget.io_count = 1;
+	budget.timer_count = 1;
+	budget.closure_count = 2;
+	chk_loop_set_budget(loop,&budget);
+
+	new_socket(fds[0],"L",CHK_PRIORITY_LOW);
+	new_socket(fds[1],"N",CHK_PRIORITY_NORMAL);
+	new_socket(fds[2],"H",CHK_PRIORITY_HIGH);
+	for(i = 0; i < 3; ++i) {
+		chk_loop_addtimer(loop,1,timer_cb,chk_ud_make_void(NULL));
+	}
+	for(i = 0; i < 5; ++i) {
+		chk_loop_post_closure(loop,on_closure,chk_ud_make_void(NULL));
+	}
+	chk_sleepms(5);
+	for(i = 0; i < 3; ++i) {
+		chk_loop_run_once(loop,100);
+		timers[i] = timer_count;
+		closures[i] = closure_count;
+	}
+	order[norder] = 0;
+	printf("order:%s,timer:%d %d %d,closure:%d %d %d\n",order,timers[0],timers[1],timers[2],closures[0],closures[1],closures[2]);
+	if(0 == strcmp(order,"HNL") && timers[0] == 1 && timers[1] == 2 && timers[2] == 3 &&
+	   closures[0] == 2 && closures[1] == 4 && closures[2] == 5) {
+		printf("ok\n");
+	}
+	chk_loop_del(loop);
+	return 0;
+}
@@ -0,0 +1,56 @@
+#include <stdio.h>
+#include <sys/resource.h>
+#include "chuck.h"
+
+/*
+* busy-poll:开启1毫秒的轮询窗口,loop只被10毫秒的定时器唤醒(空闲),
+* 窗口应当逐渐缩小,500毫秒内消耗的CPU时间远小于每次都轮询满1毫秒(50毫秒)
+*/
+
+chk_event_loop *loop;
+
+int timer_count = 0;
+
+int closure_count = 0;
+
+static void on_closure(chk_ud ud) {
+	++closure_count;
+}
+
+static void *post_routine(void *arg) {
+	chk_sleepms(100);
+	chk_loop_post_closure(loop,on_closure,chk_ud_make_void(NULL));
+	return NULL;
+}
+
+int32_t timer_cb(uint64_t tick,chk_ud ud) {
+	if(++timer_count == 50) {
+		chk_loop_end(loop);
+		return -1;
+	}
+	return 0;
+}
+
+static uint64_t cpu_us() {
+	struct rusage ru;
+	getrusage(RUSAGE_SELF,&ru);
+	return (ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000 + ru.ru_utime.tv_usec + ru.ru_stime.tv_usec;
+}
+
+int main(int argc,char **argv) {
+	pthread_t tid;
+	uint64_t  start;
+	loop = chk_loop_new();
+	chk_loop_set_busy_poll(loop,1000);
+	chk_loop_addtimer(loop,10,timer_cb,chk_ud_make_void(NULL));
+	pthread_create(&tid,NULL,post_routine,NULL);
+	start = cpu_us();
+	chk_loop_run(loop);
+	pthread_join(tid,NULL);
+	printf("timer:%d,closure:%d,cpu:%llu us\n",timer_count,closure_count,(unsigned long long)(cpu_us() - start));
+	if(timer_count == 50 && closure_count == 1 && cpu_us() - start < 25000) {
+		printf("ok\n");
+	}
+	chk_loop_del(loop);
+	return 0;
+}
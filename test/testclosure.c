@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include "chuck.h"
+
+#define PRODUCER_COUNT 4
+#define POST_COUNT     100000
+#define ROUND_COUNT    100
+#define ROUND_SIZE     1000
+
+/*
+* 第二阶段:一个线程分批投递,每批被loop消费之后再投递下一批.loop线程释放的closure
+* 归还给投递线程的对象池,之后的批次重复使用,投递线程只在开始时分配
+*/
+
+chk_event_loop *loop;
+
+int32_t   closure_count = 0;
+
+uint64_t  max_delay = 0;
+
+#ifndef __SANITIZE_ADDRESS__
+extern void *__libc_malloc(size_t);
+
+static __thread int32_t counting = 0;
+
+uint32_t  closure_malloc = 0;
+
+void *malloc(size_t size) {
+	if(counting && size == sizeof(chk_clouser)) {
+		++closure_malloc;
+	}
+	return __libc_malloc(size);
+}
+#endif
+
+void on_closure(chk_ud ud) {
+	uint64_t delay = chk_accurate_tick64() - ud.v.u64;
+	if(delay > max_delay) {
+		max_delay = delay;
+	}
+	if(++closure_count == PRODUCER_COUNT * POST_COUNT) {
+		chk_loop_end(loop);
+	}
+}
+
+void *producer(void *_) {
+	int32_t i;
+	for(i = 0; i < POST_COUNT; ++i) {
+		chk_loop_post_closure(loop,on_closure,chk_ud_make_u64(chk_accurate_tick64()));
+	}
+	return NULL;
+}
+
+void on_round(chk_ud ud) {
+	if(chk_atomic_increase_fetch(&closure_count) == ROUND_COUNT * ROUND_SIZE) {
+		chk_loop_end(loop);
+	}
+}
+
+void *round_producer(void *_) {
+	int32_t i,j;
+#ifndef __SANITIZE_ADDRESS__
+	counting = 1;
+#endif
+	for(i = 0; i < ROUND_COUNT; ++i) {
+		for(j = 0; j < ROUND_SIZE; ++j) {
+			chk_loop_post_closure(loop,on_round,chk_ud_make_u64(0));
+		}
+		while(chk_atomic_load_acquire(&closure_count) < (i + 1) * ROUND_SIZE) {
+			usleep(100);
+		}
+	}
+#ifndef __SANITIZE_ADDRESS__
+	counting = 0;
+#endif
+	return NULL;
+}
+
+int main(int argc,char **argv) {
+	int32_t     i;
+	chk_thread *threads[PRODUCER_COUNT];
+	loop = chk_loop_new();
+	for(i = 0; i < PRODUCER_COUNT; ++i) {
+		threads[i] = chk_thread_new(producer,NULL);
+	}
+	chk_loop_run(loop);
+	for(i = 0; i < PRODUCER_COUNT; ++i) {
+		chk_thread_join(threads[i]);
+		chk_thread_del(threads[i]);
+	}
+	printf("closure:%d max delay:%llu ms\n",closure_count,(unsigned long long)max_delay);
+
+	closure_count = 0;
+	threads[0] = chk_thread_new(round_producer,NULL);
+	chk_loop_run(loop);
+	chk_thread_join(threads[0]);
+	chk_thread_del(threads[0]);
+#ifndef __SANITIZE_ADDRESS__
+	printf("round closure:%d malloc:%u\n",closure_count,closure_malloc);
+	if(closure_count == ROUND_COUNT * ROUND_SIZE && closure_malloc <= 2 * ROUND_SIZE) {
+		printf("ok\n");
+	}
+#else
+	printf("round closure:%d\n",closure_count);
+#endif
+	chk_loop_del(loop);
+	return 0;
+}
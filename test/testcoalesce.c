@@ -0,0 +1,142 @@
+#include <stdio.h>
+#include "chuck.h"
+
+/*
+* 合并发送:对端不读时,每个key反复发送的更新只保留最新的一个,发送队列的大小有界.
+* 已经开始发送的buffer保持完整,同key的新buffer排在它之后.对端读取之后按顺序收到
+* 完整的大buffer,之后是每个key的最新值.大量key时索引扩张之后仍然正确
+*/
+
+#define KEYS        10
+#define ROUNDS      100
+#define RECORD_SIZE 16
+#define BIG_SIZE    (256*1024)
+#define MANY_KEYS   1000
+
+chk_event_loop *loop;
+
+chk_stream_socket_option option = {
+	.recv_buffer_size = 1024,
+	.decoder = NULL,
+};
+
+void data_cb(chk_stream_socket *s,chk_bytebuffer *data,int32_t error) {
+}
+
+static void record(char *buf,int key,int round) {
+	char tmp[RECORD_SIZE + 1];
+	snprintf(tmp,sizeof(tmp),"k%02d r%04d;     ",key,round);
+	memcpy(buf,tmp,RECORD_SIZE);
+}
+
+static void send_keyed(chk_stream_socket *s,int key,const char *data,uint32_t size) {
+	chk_bytebuffer *b = chk_bytebuffer_new(size);
+	chk_bytebuffer_append(b,(uint8_t*)data,size);
+	chk_stream_socket_send_keyed(s,key,b);
+}
+
+int main(int argc,char **argv) {
+	int i,j,r,fds[2],ok = 1,sndbuf = 16*1024;
+	char buf[RECORD_SIZE],*big,*expect,*received;
+	size_t total,received_size = 0;
+	uint64_t start,queued,replaced = 0;
+	uint32_t keys = 0;
+	chk_stream_socket *s;
+	signal(SIGPIPE,SIG_IGN);
+	loop = chk_loop_new();
+	socketpair(AF_UNIX,SOCK_STREAM,0,fds);
+	setsockopt(fds[0],SOL_SOCKET,SO_SNDBUF,&sndbuf,sizeof(sndbuf));
+	easy_noblock(fds[1],1);
+	s = chk_stream_socket_new(fds[0],&option);
+	chk_loop_add_handle(loop,(chk_handle*)s,data_cb);
+
+	//大buffer立即开始发送,只写出一部分
+	big = malloc(BIG_SIZE);
+	for(i = 0; i < BIG_SIZE; ++i) {
+		big[i] = (char)(i % 251);
+	}
+	send_keyed(s,0,big,BIG_SIZE);
+	record(buf,0,ROUNDS);
+	send_keyed(s,0,buf,RECORD_SIZE);
+
+	for(j = 0; j < ROUNDS; ++j) {
+		for(i = 1; i <= KEYS; ++i) {
+			record(buf,i,j);
+			send_keyed(s,i,buf,RECORD_SIZE);
+		}
+	}
+	queued = chk_stream_socket_loop_send_bytes(loop);
+	chk_stream_socket_coalesce_stats(s,&replaced,&keys);
+	printf("queued:%llu,replaced:%llu,keys:%u\n",(unsigned long long)queued,(unsigned long long)replaced,keys);
+	ok = ok && queued < BIG_SIZE + (KEYS + 1) * RECORD_SIZE && replaced == (ROUNDS - 1) * KEYS && keys == KEYS + 1;
+
+	//大buffer完整,之后是key 0和每个key最新的值
+	total = BIG_SIZE + (KEYS + 1) * RECORD_SIZE;
+	expect = malloc(total);
+	memcpy(expect,big,BIG_SIZE);
+	record(expect + BIG_SIZE,0,ROUNDS);
+	for(i = 1; i <= KEYS; ++i) {
+		record(expect + BIG_SIZE + i * RECORD_SIZE,i,ROUNDS - 1);
+	}
+	received = malloc(total + 1024);
+	start = chk_accurate_tick64();
+	while(received_size < total && chk_accurate_tick64() - start < 5000) {
+		chk_loop_run_once(loop,1);
+		while((r = read(fds[1],received + received_size,total + 1024 - received_size)) > 0) {
+			received_size += r;
+		}
+	}
+	chk_loop_run_once(loop,1);
+	if((r = read(fds[1],received + received_size,total + 1024 - received_size)) > 0) {
+		received_size += r;
+	}
+	chk_stream_socket_coalesce_stats(s,NULL,&keys);
+	printf("received:%zu/%zu,match:%d,keys after drain:%u\n",received_size,total,
+		   received_size == total && 0 == memcmp(received,expect,total),keys);
+	ok = ok && received_size == total && 0 == memcmp(received,expect,total) && keys == 0;
+
+	//发送完之后同key的buffer重新排队
+	record(buf,1,ROUNDS);
+	send_keyed(s,1,buf,RECORD_SIZE);
+	chk_loop_run_once(loop,1);
+	r = read(fds[1],received,RECORD_SIZE * 2);
+	ok = ok && r == RECORD_SIZE && 0 == memcmp(received,buf,RECORD_SIZE);
+
+	//大量key,在循环写出之前每个key发送两次
+	chk_stream_socket_coalesce_stats(s,&replaced,NULL);
+	queued = replaced;
+	for(j = 0; j < 2; ++j) {
+		for(i = 0; i < MANY_KEYS; ++i) {
+			record(buf,i % 100,j);
+			send_keyed(s,i * 7919,buf,RECORD_SIZE);
+		}
+	}
+	chk_stream_socket_coalesce_stats(s,&replaced,&keys);
+	ok = ok && replaced - queued == MANY_KEYS && keys == MANY_KEYS;
+	received_size = 0;
+	start = chk_accurate_tick64();
+	while(received_size < MANY_KEYS * RECORD_SIZE && chk_accurate_tick64() - start < 5000) {
+		chk_loop_run_once(loop,1);
+		while((r = read(fds[1],received + received_size,total + 1024 - received_size)) > 0) {
+			received_size += r;
+		}
+	}
+	for(i = 0; i < MANY_KEYS; ++i) {
+		record(buf,i % 100,1);
+		ok = ok && 0 == memcmp(received + i * RECORD_SIZE,buf,RECORD_SIZE);
+	}
+	chk_stream_socket_coalesce_stats(s,NULL,&keys);
+	printf("many keys received:%zu,keys after drain:%u\n",received_size,keys);
+	ok = ok && received_size == MANY_KEYS * RECORD_SIZE && keys == 0;
+
+	if(ok) {
+		printf("ok\n");
+	}
+	chk_stream_socket_close(s,0);
+	chk_loop_del(loop);
+	close(fds[1]);
+	free(big);
+	free(expect);
+	free(received);
+	return 0;
+}
@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include "testhelper.h"
+
+/*
+* cork模式:一次回调中发送的多个buffer在本轮循环结束时以一次writev写出,
+* 对照nodelay模式每个buffer一次writev.包含文件段的flush以TCP_CORK发送,
+* 完成之后TCP_CORK被关闭,对端收到的数据完整
+*/
+
+#define REPLY_COUNT 10
+#define FILE_SIZE   (256*1024)
+
+chk_event_loop *loop;
+
+chk_stream_socket_option option = {
+	.recv_buffer_size = 1024,
+	.decoder = NULL,
+};
+
+int watch_fd = -1;
+
+int writev_calls = 0;
+
+//统计被测socket上的writev次数
+static void count_writev(int fd) {
+	if(fd == watch_fd) {
+		++writev_calls;
+	}
+}
+
+static void send_string(chk_stream_socket *s,const char *str) {
+	chk_bytebuffer *b = chk_bytebuffer_new(16);
+	chk_bytebuffer_append(b,(uint8_t*)str,strlen(str));
+	chk_stream_socket_send(s,b);
+}
+
+//每收到一个请求回复REPLY_COUNT个buffer
+void data_cb(chk_stream_socket *s,chk_bytebuffer *data,int32_t error) {
+	int i;
+	char reply[16];
+	if(!data) {
+		return;
+	}
+	for(i = 0; i < REPLY_COUNT; ++i) {
+		snprintf(reply,sizeof(reply),"r%d;",i);
+		send_string(s,reply);
+	}
+}
+
+//发送一个请求,执行一轮循环,返回对端立即能读到的字节数
+static int request(chk_stream_socket *s,int fd,char *buf,int size) {
+	int r,n = 0;
+	write(fd,"?",1);
+	chk_loop_run_once(loop,100);
+	while(n < size && (r = read(fd,buf + n,size - n)) > 0) {
+		n += r;
+	}
+	return n;
+}
+
+static const char *expect_replies() {
+	static char expect[REPLY_COUNT * 4 + 1];
+	int i,n = 0;
+	for(i = 0; i < REPLY_COUNT; ++i) {
+		n += snprintf(expect + n,sizeof(expect) - n,"r%d;",i);
+	}
+	return expect;
+}
+
+int main(int argc,char **argv) {
+	int i,fd,fds[2],r,n,ok = 1,cork_calls,nodelay_calls,optval;
+	char buf[65536],path[] = "/tmp/testcorkXXXXXX";
+	char *content,*received;
+	const char *expect = expect_replies();
+	size_t received_size = 0,total;
+	uint64_t start;
+	socklen_t len = sizeof(optval);
+	chk_stream_socket *s;
+	signal(SIGPIPE,SIG_IGN);
+	loop = chk_loop_new();
+	if(0 != tcp_pair(fds,0,0)) {
+		printf("tcp_pair failed\n");
+		return 0;
+	}
+	easy_noblock(fds[1],1);
+	s = chk_stream_socket_new(fds[0],&option);
+	chk_loop_add_handle(loop,(chk_handle*)s,data_cb);
+	chk_stream_socket_nodelay(s,1);
+	watch_fd = fds[0];
+	on_writev = count_writev;
+
+	//nodelay:每个buffer立即写出
+	writev_calls = 0;
+	n = request(s,fds[1],buf,sizeof(buf));
+	nodelay_calls = writev_calls;
+	ok = ok && n == (int)strlen(expect) && 0 == memcmp(buf,expect,n);
+
+	//cork:回调结束后同一轮循环中一次写出
+	chk_stream_socket_cork(s,1);
+	writev_calls = 0;
+	n = request(s,fds[1],buf,sizeof(buf));
+	cork_calls = writev_calls;
+	printf("nodelay writev:%d,cork writev:%d,received:%d\n",nodelay_calls,cork_calls,n);
+	ok = ok && nodelay_calls == REPLY_COUNT && cork_calls == 1 && n == (int)strlen(expect) && 0 == memcmp(buf,expect,n);
+
+	//循环之外的发送在下一轮等待事件之前写出
+	send_string(s,"outside");
+	writev_calls = 0;
+	chk_loop_run_once(loop,0);
+	n = read(fds[1],buf,sizeof(buf));
+	printf("outside writev:%d,received:%d\n",writev_calls,n);
+	ok = ok && writev_calls == 1 && n == 7 && 0 == memcmp(buf,"outside",7);
+
+	//文件段:header和文件在TCP_CORK下发送
+	content = malloc(FILE_SIZE);
+	for(i = 0; i < FILE_SIZE; ++i) {
+		content[i] = (char)(i % 251);
+	}
+	fd = mkstemp(path);
+	unlink(path);
+	if(fd < 0 || FILE_SIZE != write(fd,content,FILE_SIZE)) {
+		printf("create file failed\n");
+		return 0;
+	}
+	send_string(s,"head");
+	chk_stream_socket_sendfile(s,fd,0,0);
+	close(fd);
+	total = 4 + FILE_SIZE;
+	received = malloc(total);
+	start = chk_accurate_tick64();
+	while(received_size < total && chk_accurate_tick64() - start < 5000) {
+		chk_loop_run_once(loop,1);
+		while((r = read(fds[1],buf,sizeof(buf))) > 0) {
+			if(received_size + r > total) {
+				r = total - received_size;
+			}
+			memcpy(received + received_size,buf,r);
+			received_size += r;
+		}
+	}
+	optval = -1;
+	getsockopt(fds[0],IPPROTO_TCP,TCP_CORK,&optval,&len);
+	printf("file received:%zu/%zu,TCP_CORK:%d\n",received_size,total,optval);
+	ok = ok && received_size == total && 0 == memcmp(received,"head",4) && 0 == memcmp(received + 4,content,FILE_SIZE) && optval == 0;
+
+	if(ok) {
+		printf("ok\n");
+	}
+	chk_stream_socket_close(s,0);
+	chk_loop_del(loop);
+	close(fds[1]);
+	free(content);
+	free(received);
+	return 0;
+}
@@ -0,0 +1,104 @@
+#include <stdio.h>
+#include "chuck.h"
+
+/*
+* 边缘触发模式:两个客户端同时向服务端发送大量数据,服务端以很小的预算接收,
+* 检查数据完整,并且两个连接的数据是交替处理的(预算用完时让出)
+*/
+
+#define CLIENT_COUNT 2
+#define SEND_COUNT   64
+#define BUFF_SIZE    (64*1024)
+
+chk_event_loop *loop;
+
+uint64_t recv_bytes = 0;
+
+int switch_count = 0;
+
+chk_stream_socket *last = NULL;
+
+int close_count = 0;
+
+chk_stream_socket_option server_option = {
+	.recv_buffer_size = 4096,
+	.decoder = NULL,
+	.edge_trigger = 1,
+	.io_budget = 16*1024,
+	.packet_budget = 4,
+};
+
+chk_stream_socket_option client_option = {
+	.recv_buffer_size = 4096,
+	.decoder = NULL,
+	.edge_trigger = 1,
+	.io_budget = 128*1024,
+};
+
+char buff[BUFF_SIZE];
+
+void server_event_cb(chk_stream_socket *s,chk_bytebuffer *data,int32_t error) {
+	if(data) {
+		recv_bytes += data->datasize;
+		if(last && last != s) {
+			++switch_count;
+		}
+		last = s;
+	} else {
+		chk_stream_socket_close(s,0);
+		if(++close_count == CLIENT_COUNT) {
+			chk_loop_end(loop);
+		}
+	}
+}
+
+void on_new_client(chk_acceptor *a,int32_t fd,chk_sockaddr *addr,chk_ud ud,int32_t err) {
+	if(err) return;
+	chk_stream_socket *s = chk_stream_socket_new(fd,&server_option);
+	chk_loop_add_handle(loop,(chk_handle*)s,server_event_cb);
+}
+
+void client_event_cb(chk_stream_socket *s,chk_bytebuffer *data,int32_t error) {
+	if(!data) {
+		chk_stream_socket_close(s,0);
+	}
+}
+
+void connect_callback(int32_t fd,chk_ud ud,int32_t err) {
+	int i;
+	if(0 == err) {
+		chk_stream_socket *s = chk_stream_socket_new(fd,&client_option);
+		chk_loop_add_handle(loop,(chk_handle*)s,client_event_cb);
+		for(i = 0; i < SEND_COUNT; ++i) {
+			chk_bytebuffer *msg = chk_bytebuffer_new(BUFF_SIZE);
+			chk_bytebuffer_append(msg,(uint8_t*)buff,BUFF_SIZE);
+			chk_stream_socket_send(s,msg);
+		}
+		//发送完成后关闭
+		chk_stream_socket_close(s,5000);
+	} else {
+		printf("connect error\n");
+	}
+}
+
+int main(int argc,char **argv) {
+	int i;
+	chk_sockaddr addr;
+	signal(SIGPIPE,SIG_IGN);
+	easy_sockaddr_ip4(&addr,"127.0.0.1",8011);
+	loop = chk_loop_new();
+	if(NULL == chk_listen(loop,&addr,on_new_client,chk_ud_make_void(NULL))) {
+		printf("listen failed\n");
+		return 0;
+	}
+	for(i = 0; i < CLIENT_COUNT; ++i) {
+		chk_easy_async_connect(loop,&addr,NULL,connect_callback,chk_ud_make_void(NULL),-1);
+	}
+	chk_loop_run(loop);
+	printf("recv:%llu,switch:%d\n",(unsigned long long)recv_bytes,switch_count);
+	if(recv_bytes == (uint64_t)CLIENT_COUNT*SEND_COUNT*BUFF_SIZE && switch_count > 2) {
+		printf("ok\n");
+	}
+	chk_loop_del(loop);
+	return 0;
+}
@@ -0,0 +1,95 @@
+#include <stdio.h>
+#include <sys/resource.h>
+#include "chuck.h"
+
+/*
+* 每个空闲连接的内存占用:创建socketpair,一端以惰性接收模式加入loop并收发一次数据,
+* 统计进程RSS的增量.默认1M个连接,受RLIMIT_NOFILE限制时按上限减少.
+* 用法: testfootprint [连接数]
+*/
+
+#define CONN_COUNT (1024*1024)
+
+chk_event_loop *loop;
+
+chk_stream_socket_option option = {
+	.recv_buffer_size = 4096,
+	.lazy_recv = 1,
+};
+
+uint32_t received = 0;
+
+void data_cb(chk_stream_socket *s,chk_bytebuffer *data,int32_t error) {
+	if(data) {
+		++received;
+	}
+}
+
+static uint64_t rss() {
+	uint64_t size = 0,resident = 0;
+	FILE *f = fopen("/proc/self/statm","r");
+	if(f) {
+		if(2 != fscanf(f,"%llu %llu",(unsigned long long*)&size,(unsigned long long*)&resident)) {
+			resident = 0;
+		}
+		fclose(f);
+	}
+	return resident * sysconf(_SC_PAGESIZE);
+}
+
+int main(int argc,char **argv) {
+	int i,fds[2];
+	int *peers;
+	int count = argc > 1 ? atoi(argv[1]) : CONN_COUNT;
+	uint64_t before,after;
+	struct rlimit rl;
+	chk_stream_socket **sockets;
+	signal(SIGPIPE,SIG_IGN);
+
+	//尽量提高描述符上限,每个连接需要2个描述符
+	getrlimit(RLIMIT_NOFILE,&rl);
+	rl.rlim_cur = rl.rlim_max = (rlim_t)count * 2 + 64;
+	if(0 != setrlimit(RLIMIT_NOFILE,&rl)) {
+		getrlimit(RLIMIT_NOFILE,&rl);
+		rl.rlim_cur = rl.rlim_max;
+		setrlimit(RLIMIT_NOFILE,&rl);
+		count = MIN(count,(int)((rl.rlim_cur - 64) / 2));
+	}
+
+	loop = chk_loop_new();
+	peers = calloc(count,sizeof(*peers));
+	sockets = calloc(count,sizeof(*sockets));
+	//先触碰测试自己的数组,不计入增量
+	memset(peers,0,count * sizeof(*peers));
+	memset(sockets,0,count * sizeof(*sockets));
+	before = rss();
+	for(i = 0; i < count; ++i) {
+		if(0 != socketpair(AF_UNIX,SOCK_STREAM,0,fds)) {
+			printf("socketpair failed at %d:%s\n",i,strerror(errno));
+			count = i;
+			break;
+		}
+		peers[i] = fds[1];
+		sockets[i] = chk_stream_socket_new(fds[0],&option);
+		chk_loop_add_handle(loop,(chk_handle*)sockets[i],data_cb);
+		write(fds[1],"ping",4);
+	}
+	while(received < (uint32_t)count) {
+		chk_loop_run_once(loop,10);
+	}
+	after = rss();
+
+	printf("connections:%d,rss:%llu KB,per connection:%llu bytes\n",count,
+		   (unsigned long long)(after - before) / 1024,(unsigned long long)(count ? (after - before) / count : 0));
+	if(count > 0 && (after - before) / count < 1024) {
+		printf("ok\n");
+	}
+	for(i = 0; i < count; ++i) {
+		chk_stream_socket_close(sockets[i],0);
+		close(peers[i]);
+	}
+	chk_loop_del(loop);
+	free(peers);
+	free(sockets);
+	return 0;
+}
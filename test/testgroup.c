@@ -0,0 +1,192 @@
+#include <stdio.h>
+#include "testhelper.h"
+
+/*
+* 广播组:
+* 1) 广播与单播交错时每个成员按发送顺序收到数据,一轮循环中每个成员只有一次writev;
+* 2) 成员的发送缓冲满时,退出组之前排入的消息(包括只发送了部分的消息)完整发送,之后的广播不再收到;
+* 3) 成员关闭之后自动退出组,其它成员不受影响;
+* 4) 删除组之后还没有发送的消息继续发送
+*/
+
+#define MEMBERS  4
+#define BIG_SIZE (64*1024)
+#define BIG_COUNT 16
+
+chk_event_loop *loop;
+
+chk_stream_socket_option option = {
+	.recv_buffer_size = 1024,
+	.decoder = NULL,
+};
+
+chk_stream_socket *sockets[MEMBERS];
+
+int peers[MEMBERS];
+
+int writev_calls[MEMBERS];
+
+//统计每个成员上的writev次数
+static void count_writev(int fd) {
+	int i;
+	for(i = 0; i < MEMBERS; ++i) {
+		if(sockets[i] && fd == chk_stream_socket_getfd(sockets[i])) {
+			++writev_calls[i];
+		}
+	}
+}
+
+void data_cb(chk_stream_socket *s,chk_bytebuffer *data,int32_t error) {
+}
+
+static chk_bytebuffer *make_buffer(const char *data,uint32_t size) {
+	chk_bytebuffer *b = chk_bytebuffer_new(size);
+	chk_bytebuffer_append(b,(uint8_t*)data,size);
+	return b;
+}
+
+static void broadcast(chk_socket_group *g,const char *str) {
+	chk_socket_group_broadcast(g,make_buffer(str,strlen(str)));
+}
+
+static int read_all(int fd,char *buf,int size) {
+	int r,n = 0;
+	while(n < size && (r = read(fd,buf + n,size - n)) > 0) {
+		n += r;
+	}
+	return n;
+}
+
+//运行循环并读取每个成员收到的数据,直到expect[i]全部到达
+static int drain(char *expect[MEMBERS],size_t sizes[MEMBERS],char *buf) {
+	int i,r,ok = 1;
+	size_t received[MEMBERS] = {0};
+	uint64_t start = chk_accurate_tick64();
+	for(;;) {
+		int done = 1;
+		chk_loop_run_once(loop,1);
+		for(i = 0; i < MEMBERS; ++i) {
+			if(peers[i] < 0) {
+				continue;
+			}
+			while(received[i] < sizes[i] && (r = read(peers[i],buf + received[i],sizes[i] - received[i])) > 0) {
+				if(0 != memcmp(buf + received[i],expect[i] + received[i],r)) {
+					ok = 0;
+				}
+				received[i] += r;
+			}
+			done = done && received[i] == sizes[i];
+		}
+		if(done || chk_accurate_tick64() - start > 5000) {
+			break;
+		}
+	}
+	for(i = 0; i < MEMBERS; ++i) {
+		if(peers[i] >= 0) {
+			ok = ok && received[i] == sizes[i] && read(peers[i],buf,1) < 0;
+		}
+	}
+	return ok;
+}
+
+int main(int argc,char **argv) {
+	int i,j,fds[2],n,ok = 1,sndbuf = 16*1024,single_writev = 1;
+	char buf[64],*big,*expect[MEMBERS],*recvbuf;
+	size_t sizes[MEMBERS];
+	chk_socket_group *g;
+	signal(SIGPIPE,SIG_IGN);
+	on_writev = count_writev;
+	loop = chk_loop_new();
+	g = chk_socket_group_new();
+	for(i = 0; i < MEMBERS; ++i) {
+		socketpair(AF_UNIX,SOCK_STREAM,0,fds);
+		setsockopt(fds[0],SOL_SOCKET,SO_SNDBUF,&sndbuf,sizeof(sndbuf));
+		easy_noblock(fds[1],1);
+		peers[i] = fds[1];
+		sockets[i] = chk_stream_socket_new(fds[0],&option);
+		chk_loop_add_handle(loop,(chk_handle*)sockets[i],data_cb);
+		chk_socket_group_add(g,sockets[i]);
+	}
+	ok = ok && chk_socket_group_size(g) == MEMBERS;
+
+	//1
+	memset(writev_calls,0,sizeof(writev_calls));
+	broadcast(g,"A;");
+	chk_stream_socket_send(sockets[0],make_buffer("u;",2));
+	broadcast(g,"B;");
+	broadcast(g,"C;");
+	chk_stream_socket_send(sockets[1],make_buffer("v;",2));
+	chk_loop_run_once(loop,0);
+	for(i = 0; i < MEMBERS; ++i) {
+		const char *e = i == 0 ? "A;u;B;C;" : i == 1 ? "A;B;C;v;" : "A;B;C;";
+		n = read_all(peers[i],buf,sizeof(buf));
+		ok = ok && n == (int)strlen(e) && 0 == memcmp(buf,e,n);
+		single_writev = single_writev && writev_calls[i] == 1;
+	}
+	printf("interleaved order:%d,one writev per member:%d\n",ok,single_writev);
+	ok = ok && single_writev;
+
+	//2
+	big = malloc(BIG_SIZE * BIG_COUNT + 2);
+	for(i = 0; i < BIG_SIZE * BIG_COUNT; ++i) {
+		big[i] = (char)(i % 251);
+	}
+	memcpy(big + BIG_SIZE * BIG_COUNT,"X;",2);
+	for(i = 0; i < BIG_COUNT; ++i) {
+		chk_socket_group_broadcast(g,make_buffer(big + i * BIG_SIZE,BIG_SIZE));
+	}
+	//发送缓冲很小,只写出了一部分
+	chk_loop_run_once(loop,0);
+	chk_socket_group_remove(g,sockets[1]);
+	broadcast(g,"X;");
+	for(i = 0; i < MEMBERS; ++i) {
+		expect[i] = big;
+		sizes[i]  = BIG_SIZE * BIG_COUNT + (i == 1 ? 0 : 2);
+	}
+	recvbuf = malloc(BIG_SIZE * BIG_COUNT + 2);
+	j = drain(expect,sizes,recvbuf);
+	printf("remove with pending data:%d,size:%u\n",j,chk_socket_group_size(g));
+	ok = ok && j && chk_socket_group_size(g) == MEMBERS - 1;
+
+	//3
+	chk_stream_socket_close(sockets[2],0);
+	sockets[2] = NULL;
+	close(peers[2]);
+	peers[2] = -1;
+	broadcast(g,"after close;");
+	for(i = 0; i < MEMBERS; ++i) {
+		expect[i] = i == 1 ? "" : "after close;";
+		sizes[i]  = strlen(expect[i]);
+	}
+	j = drain(expect,sizes,recvbuf);
+	printf("close member:%d,size:%u\n",j,chk_socket_group_size(g));
+	ok = ok && j && chk_socket_group_size(g) == MEMBERS - 2;
+
+	//4
+	for(i = 0; i < BIG_COUNT; ++i) {
+		chk_socket_group_broadcast(g,make_buffer(big + i * BIG_SIZE,BIG_SIZE));
+	}
+	chk_loop_run_once(loop,0);
+	chk_socket_group_del(g);
+	for(i = 0; i < MEMBERS; ++i) {
+		expect[i] = big;
+		sizes[i]  = i == 1 ? 0 : BIG_SIZE * BIG_COUNT;
+	}
+	j = drain(expect,sizes,recvbuf);
+	printf("delete group with pending data:%d\n",j);
+	ok = ok && j;
+
+	if(ok) {
+		printf("ok\n");
+	}
+	for(i = 0; i < MEMBERS; ++i) {
+		if(sockets[i]) {
+			chk_stream_socket_close(sockets[i],0);
+			close(peers[i]);
+		}
+	}
+	chk_loop_del(loop);
+	free(big);
+	free(recvbuf);
+	return 0;
+}
@@ -0,0 +1,52 @@
+#ifndef _TESTHELPER_H
+#define _TESTHELPER_H
+
+/*
+* 测试共用的辅助函数
+*/
+
+#include "chuck.h"
+
+//忙等ms毫秒,模拟耗时的回调
+static inline void busy(uint32_t ms) {
+	uint64_t start = chk_accurate_tick64();
+	while(chk_accurate_tick64() - start < ms);
+}
+
+/*
+* 建立一对回环tcp连接,fds[0]为accept得到的一端,fds[1]为客户端.
+* sndbuf/rcvbuf大于0时分别设置fds[0]的发送缓冲和fds[1]的接收缓冲
+*/
+static inline int tcp_pair(int fds[2],int sndbuf,int rcvbuf) {
+	int listenfd,one = 1;
+	struct sockaddr_in addr;
+	socklen_t len = sizeof(addr);
+	memset(&addr,0,sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	listenfd = socket(AF_INET,SOCK_STREAM,0);
+	setsockopt(listenfd,SOL_SOCKET,SO_REUSEADDR,&one,sizeof(one));
+	//accept得到的socket继承监听socket的发送缓冲
+	if(sndbuf > 0) {
+		setsockopt(listenfd,SOL_SOCKET,SO_SNDBUF,&sndbuf,sizeof(sndbuf));
+	}
+	if(0 != bind(listenfd,(struct sockaddr*)&addr,sizeof(addr)) || 0 != listen(listenfd,1)) {
+		return -1;
+	}
+	getsockname(listenfd,(struct sockaddr*)&addr,&len);
+	fds[1] = socket(AF_INET,SOCK_STREAM,0);
+	if(rcvbuf > 0) {
+		setsockopt(fds[1],SOL_SOCKET,SO_RCVBUF,&rcvbuf,sizeof(rcvbuf));
+	}
+	if(0 != connect(fds[1],(struct sockaddr*)&addr,sizeof(addr))) {
+		return -1;
+	}
+	fds[0] = accept(listenfd,NULL,NULL);
+	close(listenfd);
+	return fds[0] >= 0 ? 0 : -1;
+}
+
+//每次writev调用前以fd回调,定义在test/testwritev.c,链接了它的测试才能使用
+extern void (*on_writev)(int fd);
+
+#endif
@@ -0,0 +1,160 @@
+#include <stdio.h>
+#include "chuck.h"
+
+/*
+* 惰性接收模式:空闲的socket不持有接收chunk.
+* 1) 完整的包在回调之后不保留chunk;
+* 2) 半个包只保留按大小分配的chunk,收到剩余部分之后解出完整的包;
+* 3) 回调保留了buffer时chunk一直保留,buffer释放之后下一次读取完成时释放;
+* 4) 大包(超过临时缓冲一半的读取)直接使用临时缓冲,数据完整;
+* 5) 默认解包器同样不保留chunk,普通模式的socket一直持有recv_buffer_size大小的chunk
+*/
+
+chk_event_loop *loop;
+
+chk_bytebuffer *kept = NULL;
+
+int keep = 0;
+
+int packets = 0;
+
+char last[128*1024];
+
+uint32_t last_size = 0;
+
+chk_stream_socket_option option = {
+	.recv_buffer_size = 64*1024,
+	.lazy_recv = 1,
+};
+
+void data_cb(chk_stream_socket *s,chk_bytebuffer *data,int32_t error) {
+	uint32_t pos,size;
+	if(!data) {
+		return;
+	}
+	++packets;
+	pos  = data->spos;
+	size = data->datasize;
+	chk_bytechunk_read(data->head,last,&pos,&size);
+	last_size = size;
+	if(keep) {
+		kept = chk_bytebuffer_clone(data);
+	}
+}
+
+static uint32_t held(chk_stream_socket *s) {
+	chk_stream_socket_recv_stats stats;
+	chk_stream_socket_get_recv_stats(s,&stats);
+	return stats.held;
+}
+
+static void run() {
+	int i;
+	for(i = 0; i < 5; ++i) {
+		chk_loop_run_once(loop,1);
+	}
+}
+
+static void send_packet(int fd,const char *payload,uint32_t len,uint32_t first) {
+	char *buf = malloc(len + 4);
+	uint32_t n = chk_hton32(len);
+	memcpy(buf,&n,4);
+	memcpy(buf + 4,payload,len);
+	if(first < len + 4) {
+		write(fd,buf,first);
+		run();
+		write(fd,buf + first,len + 4 - first);
+	} else {
+		write(fd,buf,len + 4);
+	}
+	free(buf);
+}
+
+static int check_last(const char *payload,uint32_t len) {
+	return last_size == len + 4 && 0 == memcmp(last + 4,payload,len);
+}
+
+int main(int argc,char **argv) {
+	int i,fds[2],dfds[2],nfds[2],ok = 1;
+	char *big;
+	uint32_t half_held;
+	chk_stream_socket *s,*d,*n;
+	chk_stream_socket_option default_option = {.recv_buffer_size = 4096,.lazy_recv = 1};
+	chk_stream_socket_option normal_option  = {.recv_buffer_size = 4096};
+	signal(SIGPIPE,SIG_IGN);
+	loop = chk_loop_new();
+	socketpair(AF_UNIX,SOCK_STREAM,0,fds);
+	option.decoder = (chk_decoder*)packet_decoder_new(256*1024);
+	s = chk_stream_socket_new(fds[0],&option);
+	chk_loop_add_handle(loop,(chk_handle*)s,data_cb);
+
+	//1
+	send_packet(fds[1],"hello",5,0);
+	run();
+	printf("full packet:%d,held:%u\n",check_last("hello",5),held(s));
+	ok = ok && check_last("hello",5) && held(s) == 0;
+
+	//2
+	send_packet(fds[1],"half packet",11,6);
+	half_held = 0;
+	run();
+	printf("half packet:%d,held:%u\n",check_last("half packet",11),held(s));
+	ok = ok && check_last("half packet",11) && held(s) == 0;
+	write(fds[1],"\0\0\0\x05wor",7);
+	run();
+	half_held = held(s);
+	write(fds[1],"ld",2);
+	run();
+	printf("remainder held:%u,packet:%d,held:%u\n",half_held,check_last("world",5),held(s));
+	ok = ok && half_held > 0 && half_held <= 64 && check_last("world",5) && held(s) == 0;
+
+	//3
+	keep = 1;
+	send_packet(fds[1],"keep",4,0);
+	run();
+	keep = 0;
+	printf("kept held:%u\n",held(s));
+	ok = ok && kept && held(s) > 0;
+	chk_bytebuffer_del(kept);
+	send_packet(fds[1],"after",5,0);
+	run();
+	printf("released held:%u\n",held(s));
+	ok = ok && check_last("after",5) && held(s) == 0;
+
+	//4
+	big = malloc(100*1024);
+	for(i = 0; i < 100*1024; ++i) {
+		big[i] = (char)(i % 251);
+	}
+	easy_noblock(fds[1],1);
+	send_packet(fds[1],big,100*1024,0);
+	for(i = 0; i < 20 && !check_last(big,100*1024); ++i) {
+		run();
+	}
+	printf("big packet:%d,held:%u\n",check_last(big,100*1024),held(s));
+	ok = ok && check_last(big,100*1024) && held(s) == 0;
+
+	//5
+	socketpair(AF_UNIX,SOCK_STREAM,0,dfds);
+	d = chk_stream_socket_new(dfds[0],&default_option);
+	chk_loop_add_handle(loop,(chk_handle*)d,data_cb);
+	write(dfds[1],"default",7);
+	run();
+	socketpair(AF_UNIX,SOCK_STREAM,0,nfds);
+	n = chk_stream_socket_new(nfds[0],&normal_option);
+	chk_loop_add_handle(loop,(chk_handle*)n,data_cb);
+	write(nfds[1],"normal",6);
+	run();
+	printf("default decoder held:%u,normal held:%u,packets:%d\n",held(d),held(n),packets);
+	ok = ok && held(d) == 0 && held(n) == 4096 && packets == 8;
+
+	if(ok) {
+		printf("ok\n");
+	}
+	chk_stream_socket_close(s,0);
+	chk_stream_socket_close(d,0);
+	chk_stream_socket_close(n,0);
+	chk_loop_del(loop);
+	free(big);
+	return 0;
+}
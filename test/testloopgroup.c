@@ -0,0 +1,91 @@
+#include <stdio.h>
+#include "chuck.h"
+
+#define LOOP_COUNT   4
+#define CLIENT_COUNT 200
+
+chk_event_loop *loop;
+
+int accept_count[LOOP_COUNT] = {0};
+
+int echo_count = 0;
+
+chk_stream_socket_option option = {
+	.recv_buffer_size = 1024,
+	.decoder = NULL,
+};
+
+void server_event_cb(chk_stream_socket *s,chk_bytebuffer *data,int32_t error) {
+	if(data) {
+		chk_stream_socket_send(s,chk_bytebuffer_clone(data));
+	} else {
+		chk_stream_socket_close(s,0);
+	}
+}
+
+void on_group_start(chk_loop_group *g,chk_event_loop *l,uint32_t idx,chk_ud ud) {
+	printf("loop %u start\n",idx);
+}
+
+void on_new_client(chk_acceptor *a,int32_t fd,chk_sockaddr *addr,chk_ud ud,int32_t err) {
+	uint32_t i;
+	chk_loop_group *g = (chk_loop_group*)ud.v.val;
+	if(err) return;
+	chk_event_loop *l = chk_acceptor_get_loop(a);
+	for(i = 0; i < chk_loop_group_size(g); ++i) {
+		if(chk_loop_group_get(g,i) == l) {
+			__sync_fetch_and_add(&accept_count[i],1);
+		}
+	}
+	chk_stream_socket *s = chk_stream_socket_new(fd,&option);
+	chk_loop_add_handle(l,(chk_handle*)s,server_event_cb);
+}
+
+void client_event_cb(chk_stream_socket *s,chk_bytebuffer *data,int32_t error) {
+	if(data) {
+		if(++echo_count == CLIENT_COUNT) {
+			chk_loop_end(loop);
+		}
+	}
+	chk_stream_socket_close(s,0);
+}
+
+void connect_callback(int32_t fd,chk_ud ud,int32_t err) {
+	if(0 == err) {
+		chk_stream_socket *s = chk_stream_socket_new(fd,&option);
+		chk_loop_add_handle(loop,(chk_handle*)s,client_event_cb);
+		chk_bytebuffer *msg = chk_bytebuffer_new(64);
+		chk_bytebuffer_append(msg,(uint8_t*)"hello",5);
+		chk_stream_socket_send(s,msg);
+	} else {
+		printf("connect error\n");
+	}
+}
+
+int main(int argc,char **argv) {
+	int i;
+	chk_sockaddr addr;
+	signal(SIGPIPE,SIG_IGN);
+	easy_sockaddr_ip4(&addr,"127.0.0.1",8010);
+
+	chk_loop_group *g = chk_loop_group_new(LOOP_COUNT);
+	if(0 != chk_loop_group_listen(g,&addr,on_new_client,chk_ud_make_void(g))) {
+		printf("chk_loop_group_listen failed\n");
+		return 0;
+	}
+	chk_loop_group_start(g,on_group_start,NULL,chk_ud_make_void(NULL));
+
+	loop = chk_loop_new();
+	for(i = 0; i < CLIENT_COUNT; ++i) {
+		chk_easy_async_connect(loop,&addr,NULL,connect_callback,chk_ud_make_void(NULL),-1);
+	}
+	chk_loop_run(loop);
+
+	for(i = 0; i < LOOP_COUNT; ++i) {
+		printf("loop %d accept:%d\n",i,accept_count[i]);
+	}
+	printf("echo:%d\n",echo_count);
+	chk_loop_group_del(g);
+	chk_loop_del(loop);
+	return 0;
+}
@@ -0,0 +1,178 @@
+#include <stdio.h>
+#include "chuck.h"
+
+/*
+* 连接在loop之间迁移:
+* 1) loop 0上4个echo连接的流量不同,chk_loop_group_rebalance把读写最多的一部分迁移到空闲的loop 1,
+*    之后这些连接的回调在loop 1的线程中执行,其余的留在loop 0.流量最大的连接没有设置migratable,
+*    不会被迁移;
+* 2) 一个使用packet_decoder的连接在收到半个包,send_list中还有未发完的数据时迁移到loop 1,
+*    迁移之后收到完整的包,客户端收到全部数据
+*/
+
+#define CONN_COUNT 4
+#define BIG_SIZE   (1024*1024)
+
+chk_loop_group *group;
+
+pid_t loop_tids[2] = {0};
+
+pid_t echo_tids[CONN_COUNT] = {0};
+
+pid_t packet_tid = 0;
+
+int   packet_size = 0;
+
+chk_stream_socket *packet_socket;
+
+chk_stream_socket_option option = {
+	.recv_buffer_size = 1024,
+	.decoder = NULL,
+};
+
+chk_stream_socket_option packet_option = {
+	.recv_buffer_size = 1024,
+};
+
+static void on_start(chk_loop_group *g,chk_event_loop *loop,uint32_t idx,chk_ud ud) {
+	loop_tids[idx] = chk_thread_current_tid();
+	chk_loop_enable_stats(loop,1);
+}
+
+void echo_cb(chk_stream_socket *s,chk_bytebuffer *data,int32_t error) {
+	if(data) {
+		echo_tids[chk_stream_socket_getUd(s).v.i64] = chk_thread_current_tid();
+		chk_stream_socket_send(s,chk_bytebuffer_clone(data));
+	} else {
+		chk_stream_socket_close(s,0);
+	}
+}
+
+void packet_cb(chk_stream_socket *s,chk_bytebuffer *data,int32_t error) {
+	if(data) {
+		packet_tid  = chk_thread_current_tid();
+		packet_size = data->datasize;
+	} else {
+		chk_stream_socket_close(s,0);
+	}
+}
+
+static void add_echo(chk_ud ud) {
+	chk_loop_add_handle(chk_loop_group_get(group,0),(chk_handle*)ud.v.val,echo_cb);
+}
+
+static void add_packet(chk_ud ud) {
+	chk_loop_add_handle(chk_loop_group_get(group,0),(chk_handle*)ud.v.val,packet_cb);
+}
+
+//在loop 0中发送一个大包(超出socket缓冲,剩余部分留在send_list中)后迁移
+static void send_and_migrate(chk_ud ud) {
+	chk_bytebuffer *b = chk_bytebuffer_new(BIG_SIZE);
+	char *buf = calloc(1,BIG_SIZE);
+	memset(buf,'x',BIG_SIZE);
+	chk_bytebuffer_append(b,(uint8_t*)buf,BIG_SIZE);
+	free(buf);
+	chk_stream_socket_send(packet_socket,b);
+	chk_stream_socket_migrate(packet_socket,chk_loop_group_get(group,1));
+}
+
+static int readn(int fd,char *buf,int size) {
+	int n = 0,r;
+	while(n < size) {
+		r = TEMP_FAILURE_RETRY(read(fd,buf + n,size - n));
+		if(r <= 0) {
+			return -1;
+		}
+		n += r;
+	}
+	return n;
+}
+
+int main(int argc,char **argv) {
+	int i,j,on_target = 0,on_source = 0,received = 0,r;
+	int32_t fds[CONN_COUNT][2],pfds[2];
+	char buf[8192];
+	uint32_t len;
+	chk_stream_socket *s;
+	signal(SIGPIPE,SIG_IGN);
+	group = chk_loop_group_new(2);
+	chk_loop_group_start(group,on_start,NULL,chk_ud_make_void(NULL));
+	chk_sleepms(50);
+
+	for(i = 0; i < CONN_COUNT; ++i) {
+		socketpair(AF_UNIX,SOCK_STREAM,0,fds[i]);
+		s = chk_stream_socket_new(fds[i][0],&option);
+		chk_stream_socket_setUd(s,chk_ud_make_i64(i));
+		if(i < CONN_COUNT - 1) {
+			chk_stream_socket_set_migratable(s,1);
+		}
+		chk_loop_post_closure(chk_loop_group_get(group,0),add_echo,chk_ud_make_void(s));
+	}
+
+	//连接i的流量为(i+1)*2000字节
+	memset(buf,'a',sizeof(buf));
+	for(i = 0; i < CONN_COUNT; ++i) {
+		for(j = 0; j <= i; ++j) {
+			TEMP_FAILURE_RETRY(write(fds[i][1],buf,1000));
+			readn(fds[i][1],buf,1000);
+		}
+	}
+
+	if(chk_error_ok != chk_loop_group_rebalance(group,CONN_COUNT)) {
+		printf("chk_loop_group_rebalance failed\n");
+		return 0;
+	}
+	chk_sleepms(100);
+
+	for(i = 0; i < CONN_COUNT; ++i) {
+		TEMP_FAILURE_RETRY(write(fds[i][1],buf,1));
+		readn(fds[i][1],buf,1);
+		if(echo_tids[i] == loop_tids[1]) {
+			++on_target;
+		} else if(echo_tids[i] == loop_tids[0]) {
+			++on_source;
+		}
+	}
+	printf("rebalance on source:%d,on target:%d\n",on_source,on_target);
+
+	socketpair(AF_UNIX,SOCK_STREAM,0,pfds);
+	packet_option.decoder = (chk_decoder*)packet_decoder_new(4096);
+	packet_socket = chk_stream_socket_new(pfds[0],&packet_option);
+	chk_loop_post_closure(chk_loop_group_get(group,0),add_packet,chk_ud_make_void(packet_socket));
+
+	//先发送半个包
+	len = chk_hton32(8);
+	memcpy(buf,&len,sizeof(len));
+	memcpy(buf + 4,"half",4);
+	TEMP_FAILURE_RETRY(write(pfds[1],buf,8));
+	chk_sleepms(50);
+
+	chk_loop_post_closure(chk_loop_group_get(group,0),send_and_migrate,chk_ud_make_void(NULL));
+	chk_sleepms(50);
+
+	TEMP_FAILURE_RETRY(write(pfds[1],"full",4));
+	while(received < BIG_SIZE) {
+		r = TEMP_FAILURE_RETRY(read(pfds[1],buf,sizeof(buf)));
+		if(r <= 0) {
+			break;
+		}
+		for(i = 0; i < r; ++i) {
+			if(buf[i] != 'x') {
+				break;
+			}
+		}
+		if(i < r) {
+			break;
+		}
+		received += r;
+	}
+	chk_sleepms(50);
+	printf("packet size:%d,received:%d,on target:%d\n",packet_size,received,packet_tid == loop_tids[1]);
+
+	chk_loop_group_del(group);
+	if(on_target > 0 && on_source > 0 && on_target + on_source == CONN_COUNT && echo_tids[CONN_COUNT - 1] == loop_tids[0] &&
+	   packet_size == 12 && received == BIG_SIZE && packet_tid == loop_tids[1]) {
+		printf("ok\n");
+	}
+	return 0;
+}
@@ -0,0 +1,107 @@
+#include <stdio.h>
+#include "chuck.h"
+
+/*
+* 接收缓冲自适应:对端大块写入时接收chunk从1KB倍增到上限64KB,
+* 之后持续的小消息使接收chunk逐步减半回到1KB,收到的数据保持完整
+*/
+
+#define BULK_SIZE (4*1024*1024)
+
+chk_event_loop *loop;
+
+size_t received = 0;
+
+int corrupt = 0;
+
+chk_stream_socket_option option = {
+	.recv_buffer_size = 1024,
+	.recv_buffer_max  = 64*1024,
+	.decoder = NULL,
+};
+
+void data_cb(chk_stream_socket *s,chk_bytebuffer *data,int32_t error) {
+	uint32_t pos = data ? data->spos : 0,size;
+	chk_bytechunk *chunk;
+	if(!data) {
+		return;
+	}
+	for(chunk = data->head,size = data->datasize; chunk && size; chunk = chunk->next,pos = 0) {
+		uint32_t i,n = MIN(chunk->cap - pos,size);
+		for(i = 0; i < n; ++i) {
+			if(chunk->data[pos + i] != (char)((received + i) % 251)) {
+				++corrupt;
+			}
+		}
+		received += n;
+		size -= n;
+	}
+}
+
+static void print_stats(const char *tag,chk_stream_socket_recv_stats *stats) {
+	uint32_t i;
+	printf("%s reads:%llu,bytes:%llu,recv_buffer_size:%u,grows:%u,shrinks:%u,read_size:",tag,
+		   (unsigned long long)stats->reads,(unsigned long long)stats->bytes,stats->recv_buffer_size,stats->grows,stats->shrinks);
+	for(i = 0; i < CHK_RECV_SIZE_BUCKETS; ++i) {
+		if(stats->read_size[i]) {
+			printf(" %u:%u",i ? 1 << (i + 6) : 0,stats->read_size[i]);
+		}
+	}
+	printf("\n");
+}
+
+int main(int argc,char **argv) {
+	int i,fds[2];
+	size_t sent = 0,n;
+	char *buf;
+	chk_stream_socket *s;
+	chk_stream_socket_recv_stats bulk,idle;
+	signal(SIGPIPE,SIG_IGN);
+	socketpair(AF_UNIX,SOCK_STREAM,0,fds);
+	easy_noblock(fds[1],1);
+	loop = chk_loop_new();
+	s = chk_stream_socket_new(fds[0],&option);
+	chk_loop_add_handle(loop,(chk_handle*)s,data_cb);
+
+	buf = malloc(BULK_SIZE);
+	for(i = 0; i < BULK_SIZE; ++i) {
+		buf[i] = (char)(i % 251);
+	}
+	//大块写入,每轮循环之前写满对端的接收缓冲
+	while(received < BULK_SIZE) {
+		while(sent < BULK_SIZE) {
+			int r = write(fds[1],buf + sent,BULK_SIZE - sent);
+			if(r <= 0) {
+				break;
+			}
+			sent += r;
+		}
+		chk_loop_run_once(loop,10);
+	}
+	chk_stream_socket_get_recv_stats(s,&bulk);
+	print_stats("bulk",&bulk);
+
+	//小消息,每轮循环只读到几十字节
+	for(i = 0; i < 64 * 8; ++i) {
+		for(n = 0; n < 32; ++n) {
+			buf[n] = (char)((sent + n) % 251);
+		}
+		write(fds[1],buf,n);
+		sent += n;
+		while(received < sent) {
+			chk_loop_run_once(loop,10);
+		}
+	}
+	chk_stream_socket_get_recv_stats(s,&idle);
+	print_stats("small",&idle);
+
+	if(corrupt == 0 && received == sent && bulk.recv_buffer_size == 64*1024 && bulk.grows == 6 &&
+	   idle.recv_buffer_size == 1024 && idle.shrinks == 6) {
+		printf("ok\n");
+	}
+	chk_stream_socket_close(s,0);
+	chk_loop_del(loop);
+	close(fds[1]);
+	free(buf);
+	return 0;
+}
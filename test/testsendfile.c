@@ -0,0 +1,116 @@
+#include <stdio.h>
+#include "testhelper.h"
+
+/*
+* sendfile发送:文件段与普通buffer按排入的顺序发送,len为0时发送到文件末尾.
+* 文件段开始发送之后排入的urgent数据要等文件段发送完才发送,对端收到的数据顺序为
+* head,文件[1000,601000),urgent,mid,整个文件
+*/
+
+#define FILE_SIZE (1024*1024)
+#define SEG_OFF   1000
+#define SEG_LEN   600000
+
+chk_event_loop *loop;
+
+chk_stream_socket_option option = {
+	.recv_buffer_size = 1024,
+	.decoder = NULL,
+};
+
+void data_cb(chk_stream_socket *s,chk_bytebuffer *data,int32_t error) {
+}
+
+static void send_string(chk_stream_socket *s,const char *str,int urgent) {
+	chk_bytebuffer *b = chk_bytebuffer_new(16);
+	chk_bytebuffer_append(b,(uint8_t*)str,strlen(str));
+	if(urgent) {
+		chk_stream_socket_send_urgent(s,b);
+	} else {
+		chk_stream_socket_send(s,b);
+	}
+}
+
+static void append(char *expect,size_t *size,const char *data,size_t len) {
+	memcpy(expect + *size,data,len);
+	*size += len;
+}
+
+int main(int argc,char **argv) {
+	int i,fd,fds[2],r;
+	char path[] = "/tmp/testsendfileXXXXXX";
+	char buf[65536];
+	char *content,*expect,*received;
+	size_t expect_size = 0,received_size = 0;
+	uint64_t start;
+	chk_stream_socket *s;
+	signal(SIGPIPE,SIG_IGN);
+
+	content = malloc(FILE_SIZE);
+	for(i = 0; i < FILE_SIZE; ++i) {
+		content[i] = (char)(i * 7 % 251);
+	}
+	fd = mkstemp(path);
+	unlink(path);
+	if(fd < 0 || FILE_SIZE != write(fd,content,FILE_SIZE)) {
+		printf("create file failed\n");
+		return 0;
+	}
+
+	//缩小缓冲,保证文件段不能一次发完
+	if(0 != tcp_pair(fds,16*1024,16*1024)) {
+		printf("tcp_pair failed\n");
+		return 0;
+	}
+	easy_noblock(fds[1],1);
+	loop = chk_loop_new();
+	s = chk_stream_socket_new(fds[0],&option);
+	chk_loop_add_handle(loop,(chk_handle*)s,data_cb);
+
+	send_string(s,"head",0);
+	if(0 != chk_stream_socket_sendfile(s,fd,SEG_OFF,SEG_LEN)) {
+		printf("chk_stream_socket_sendfile failed\n");
+		return 0;
+	}
+	send_string(s,"mid",0);
+	chk_stream_socket_sendfile(s,fd,0,0);
+	//fd被dup,可以立即关闭
+	close(fd);
+
+	//对端不读,文件段只发送了一部分
+	for(i = 0; i < 3; ++i) {
+		chk_loop_run_once(loop,1);
+	}
+	send_string(s,"urgent",1);
+
+	expect = malloc(FILE_SIZE * 2);
+	append(expect,&expect_size,"head",4);
+	append(expect,&expect_size,content + SEG_OFF,SEG_LEN);
+	append(expect,&expect_size,"urgent",6);
+	append(expect,&expect_size,"mid",3);
+	append(expect,&expect_size,content,FILE_SIZE);
+
+	received = malloc(expect_size);
+	start = chk_accurate_tick64();
+	while(received_size < expect_size && chk_accurate_tick64() - start < 5000) {
+		chk_loop_run_once(loop,1);
+		while((r = read(fds[1],buf,sizeof(buf))) > 0) {
+			if(received_size + r > expect_size) {
+				r = expect_size - received_size;
+			}
+			memcpy(received + received_size,buf,r);
+			received_size += r;
+		}
+	}
+	printf("received:%zu/%zu\n",received_size,expect_size);
+	if(received_size == expect_size && 0 == memcmp(received,expect,expect_size)) {
+		printf("ok\n");
+	}
+	chk_stream_socket_close(s,0);
+	chk_loop_del(loop);
+	close(fds[1]);
+	free(content);
+	free(expect);
+	free(received);
+	return 0;
+}
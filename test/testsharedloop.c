@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include "testhelper.h"
+
+/*
+* 共享epoll模式的loop group:4个worker处理8个连接,连接0每个请求忙等2毫秒.
+* 检查同一连接的回调没有并发执行,其它连接由空闲的worker处理(参与处理的线程多于1个),
+* 最后一轮服务端延迟关闭(socket被固定到当前loop),客户端收到全部回应和关闭
+*/
+
+#define LOOP_COUNT   4
+#define CLIENT_COUNT 8
+#define ROUNDS       50
+
+chk_event_loop *loop;
+
+chk_loop_group *group;
+
+int in_callback[CLIENT_COUNT] = {0};
+
+int concurrent = 0;
+
+int round_count[CLIENT_COUNT] = {0};
+
+pid_t workers[LOOP_COUNT] = {0};
+
+int echo_count = 0;
+
+int close_count = 0;
+
+chk_stream_socket_option option = {
+	.recv_buffer_size = 1024,
+	.decoder = NULL,
+};
+
+static void record_worker() {
+	int i;
+	pid_t tid = chk_thread_current_tid();
+	for(i = 0; i < LOOP_COUNT; ++i) {
+		if(workers[i] == tid) {
+			return;
+		}
+		if(__sync_bool_compare_and_swap(&workers[i],0,tid)) {
+			return;
+		}
+	}
+}
+
+void server_event_cb(chk_stream_socket *s,chk_bytebuffer *data,int32_t error) {
+	int idx = (int)chk_stream_socket_getUd(s).v.i64;
+	if(__sync_fetch_and_add(&in_callback[idx],1) != 0) {
+		__sync_fetch_and_add(&concurrent,1);
+	}
+	record_worker();
+	if(data) {
+		if(idx == 0) {
+			busy(2);
+		}
+		chk_stream_socket_send(s,chk_bytebuffer_clone(data));
+		if(++round_count[idx] == ROUNDS) {
+			chk_stream_socket_close(s,1000);
+		}
+	} else {
+		chk_stream_socket_close(s,0);
+	}
+	__sync_fetch_and_sub(&in_callback[idx],1);
+}
+
+void client_event_cb(chk_stream_socket *s,chk_bytebuffer *data,int32_t error) {
+	if(data) {
+		++echo_count;
+		chk_stream_socket_send(s,chk_bytebuffer_clone(data));
+	} else {
+		chk_stream_socket_close(s,0);
+		if(++close_count == CLIENT_COUNT) {
+			chk_loop_end(loop);
+		}
+	}
+}
+
+int32_t timeout_cb(uint64_t tick,chk_ud ud) {
+	chk_loop_end(loop);
+	return -1;
+}
+
+int main(int argc,char **argv) {
+	int i,worker_count = 0;
+	int32_t fds[2];
+	chk_stream_socket *s;
+	chk_bytebuffer *msg;
+	signal(SIGPIPE,SIG_IGN);
+	group = chk_loop_group_new_shared(LOOP_COUNT);
+	if(!group) {
+		printf("chk_loop_group_new_shared failed\n");
+		return 0;
+	}
+	chk_loop_group_start(group,NULL,NULL,chk_ud_make_void(NULL));
+
+	loop = chk_loop_new();
+	for(i = 0; i < CLIENT_COUNT; ++i) {
+		socketpair(AF_UNIX,SOCK_STREAM,0,fds);
+		s = chk_stream_socket_new(fds[0],&option);
+		chk_stream_socket_setUd(s,chk_ud_make_i64(i));
+		if(0 != chk_loop_group_add_handle(group,(chk_handle*)s,server_event_cb)) {
+			printf("chk_loop_group_add_handle failed\n");
+			return 0;
+		}
+		s = chk_stream_socket_new(fds[1],&option);
+		chk_loop_add_handle(loop,(chk_handle*)s,client_event_cb);
+		msg = chk_bytebuffer_new(64);
+		chk_bytebuffer_append(msg,(uint8_t*)"hello",5);
+		chk_stream_socket_send(s,msg);
+	}
+	chk_loop_addtimer(loop,10000,timeout_cb,chk_ud_make_void(NULL));
+	chk_loop_run(loop);
+
+	chk_loop_group_del(group);
+	chk_loop_del(loop);
+	for(i = 0; i < LOOP_COUNT; ++i) {
+		if(workers[i]) {
+			++worker_count;
+		}
+	}
+	printf("echo:%d,close:%d,workers:%d,concurrent:%d\n",echo_count,close_count,worker_count,concurrent);
+	if(echo_count == CLIENT_COUNT * ROUNDS && close_count == CLIENT_COUNT && worker_count > 1 && concurrent == 0) {
+		printf("ok\n");
+	}
+	return 0;
+}
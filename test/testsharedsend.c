@@ -0,0 +1,194 @@
+#include <stdio.h>
+#include "chuck.h"
+
+/*
+* 共享epoll模式下在持有者之外的线程中发送:2个worker,每个客户端有请求和回应两个连接.
+* 偶数客户端的请求在worker的10毫秒定时器中回应(回应时socket可能已经被归还或被其它worker持有),
+* 奇数客户端的请求在请求连接的回调中从回应连接发出(另一个socket的回调).
+* 检查所有回应按顺序到达,同一连接的回调没有并发执行
+*/
+
+#define LOOP_COUNT   2
+#define CLIENT_COUNT 4
+#define ROUNDS       50
+
+chk_event_loop *loop;
+
+chk_loop_group *group;
+
+static __thread chk_event_loop *t_loop = NULL;
+
+chk_stream_socket *reply_sockets[CLIENT_COUNT];
+
+chk_stream_socket *request_sockets[CLIENT_COUNT];
+
+int in_callback[CLIENT_COUNT * 2] = {0};
+
+int concurrent = 0;
+
+int reply_count[CLIENT_COUNT] = {0};
+
+int order_error = 0;
+
+int done_count = 0;
+
+chk_stream_socket_option option = {
+	.recv_buffer_size = 1024,
+	.decoder = NULL,
+};
+
+static void enter(int idx) {
+	if(__sync_fetch_and_add(&in_callback[idx],1) != 0) {
+		__sync_fetch_and_add(&concurrent,1);
+	}
+}
+
+static void leave(int idx) {
+	__sync_fetch_and_sub(&in_callback[idx],1);
+}
+
+static chk_bytebuffer *make_reply(int idx,int round) {
+	char buf[32];
+	chk_bytebuffer *b;
+	snprintf(buf,sizeof(buf),"%d:%04d;",idx,round);
+	b = chk_bytebuffer_new(32);
+	chk_bytebuffer_append(b,(uint8_t*)buf,strlen(buf));
+	return b;
+}
+
+static int32_t reply_timer_cb(uint64_t tick,chk_ud ud) {
+	int idx = (int)(ud.v.i64 >> 16);
+	int round = (int)(ud.v.i64 & 0xffff);
+	chk_stream_socket_send(reply_sockets[idx],make_reply(idx,round));
+	return -1;
+}
+
+void on_start(chk_loop_group *g,chk_event_loop *e,uint32_t idx,chk_ud ud) {
+	t_loop = e;
+}
+
+//请求连接,ud为客户端下标,数据为请求的轮次
+void request_cb(chk_stream_socket *s,chk_bytebuffer *data,int32_t error) {
+	int idx = (int)chk_stream_socket_getUd(s).v.i64;
+	int round;
+	char buf[16] = {0};
+	enter(idx);
+	if(data) {
+		chk_bytebuffer_read(data,0,buf,data->datasize < sizeof(buf) - 1 ? data->datasize : sizeof(buf) - 1);
+		round = atoi(buf);
+		if(idx % 2 == 0) {
+			chk_loop_addtimer(t_loop,10,reply_timer_cb,chk_ud_make_i64(((int64_t)idx << 16) | round));
+		} else {
+			chk_stream_socket_send(reply_sockets[idx],make_reply(idx,round));
+		}
+	} else {
+		chk_stream_socket_close(s,0);
+	}
+	leave(idx);
+}
+
+//回应连接,只发送
+void reply_cb(chk_stream_socket *s,chk_bytebuffer *data,int32_t error) {
+	int idx = (int)chk_stream_socket_getUd(s).v.i64;
+	enter(CLIENT_COUNT + idx);
+	if(!data) {
+		chk_stream_socket_close(s,0);
+	}
+	leave(CLIENT_COUNT + idx);
+}
+
+static void send_request(chk_stream_socket *s,int round) {
+	char buf[16];
+	chk_bytebuffer *b = chk_bytebuffer_new(16);
+	snprintf(buf,sizeof(buf),"%d",round);
+	chk_bytebuffer_append(b,(uint8_t*)buf,strlen(buf));
+	chk_stream_socket_send(s,b);
+}
+
+void client_cb(chk_stream_socket *s,chk_bytebuffer *data,int32_t error) {
+	int idx = (int)chk_stream_socket_getUd(s).v.i64;
+	char buf[64] = {0},expect[32];
+	if(!data) {
+		chk_stream_socket_close(s,0);
+		return;
+	}
+	//一轮只有一个回应在途,每次收到完整的一个
+	chk_bytebuffer_read(data,0,buf,data->datasize < sizeof(buf) - 1 ? data->datasize : sizeof(buf) - 1);
+	snprintf(expect,sizeof(expect),"%d:%04d;",idx,reply_count[idx]);
+	if(strcmp(buf,expect) != 0) {
+		++order_error;
+	}
+	if(++reply_count[idx] == ROUNDS) {
+		if(++done_count == CLIENT_COUNT) {
+			chk_loop_end(loop);
+		}
+	} else {
+		send_request(request_sockets[idx],reply_count[idx]);
+	}
+}
+
+void client_request_cb(chk_stream_socket *s,chk_bytebuffer *data,int32_t error) {
+	if(!data) {
+		chk_stream_socket_close(s,0);
+	}
+}
+
+int32_t timeout_cb(uint64_t tick,chk_ud ud) {
+	chk_loop_end(loop);
+	return -1;
+}
+
+static chk_stream_socket *shared_socket(int32_t fd,int idx,chk_event_callback cb) {
+	chk_stream_socket *s = chk_stream_socket_new(fd,&option);
+	chk_stream_socket_setUd(s,chk_ud_make_i64(idx));
+	if(0 != chk_loop_group_add_handle(group,(chk_handle*)s,cb)) {
+		printf("chk_loop_group_add_handle failed\n");
+		exit(0);
+	}
+	return s;
+}
+
+int main(int argc,char **argv) {
+	int i,total = 0;
+	int32_t fds[2];
+	chk_stream_socket *s;
+	uint64_t start;
+	signal(SIGPIPE,SIG_IGN);
+	group = chk_loop_group_new_shared(LOOP_COUNT);
+	if(!group) {
+		printf("chk_loop_group_new_shared failed\n");
+		return 0;
+	}
+	chk_loop_group_start(group,on_start,NULL,chk_ud_make_void(NULL));
+	loop = chk_loop_new();
+	for(i = 0; i < CLIENT_COUNT; ++i) {
+		socketpair(AF_UNIX,SOCK_STREAM,0,fds);
+		reply_sockets[i] = shared_socket(fds[0],i,(chk_event_callback)reply_cb);
+		s = chk_stream_socket_new(fds[1],&option);
+		chk_stream_socket_setUd(s,chk_ud_make_i64(i));
+		chk_loop_add_handle(loop,(chk_handle*)s,client_cb);
+
+		socketpair(AF_UNIX,SOCK_STREAM,0,fds);
+		shared_socket(fds[0],i,(chk_event_callback)request_cb);
+		request_sockets[i] = chk_stream_socket_new(fds[1],&option);
+		chk_loop_add_handle(loop,(chk_handle*)request_sockets[i],client_request_cb);
+	}
+	for(i = 0; i < CLIENT_COUNT; ++i) {
+		send_request(request_sockets[i],0);
+	}
+	start = chk_accurate_tick64();
+	chk_loop_addtimer(loop,5000,timeout_cb,chk_ud_make_void(NULL));
+	chk_loop_run(loop);
+
+	for(i = 0; i < CLIENT_COUNT; ++i) {
+		total += reply_count[i];
+	}
+	printf("reply:%d/%d,order error:%d,concurrent:%d,elapsed:%llu ms\n",total,CLIENT_COUNT * ROUNDS,
+		   order_error,concurrent,(unsigned long long)(chk_accurate_tick64() - start));
+	chk_loop_group_del(group);
+	chk_loop_del(loop);
+	if(total == CLIENT_COUNT * ROUNDS && order_error == 0 && concurrent == 0) {
+		printf("ok\n");
+	}
+	return 0;
+}
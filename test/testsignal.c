@@ -0,0 +1,78 @@
+#include <stdio.h>
+#include <sys/wait.h>
+#include "chuck.h"
+
+/*
+* 信号:fork一批立即退出的子进程制造SIGCHLD风暴,在SIGCHLD回调中回收,检查全部被回收;
+* 再由另一个(没有阻塞信号的)线程kill SIGUSR1,检查回调被调用
+*/
+
+#define CHILD_COUNT 64
+
+chk_event_loop *loop;
+
+int reaped = 0;
+
+int usr1_count = 0;
+
+static void on_sigchld(chk_ud ud) {
+	while(waitpid(-1,NULL,WNOHANG) > 0) {
+		++reaped;
+	}
+	if(reaped == CHILD_COUNT) {
+		chk_unwatch_signal(SIGCHLD);
+		if(usr1_count) {
+			chk_loop_end(loop);
+		}
+	}
+}
+
+static void on_sigusr1(chk_ud ud) {
+	++usr1_count;
+	if(reaped == CHILD_COUNT) {
+		chk_loop_end(loop);
+	}
+}
+
+static void *kill_routine(void *arg) {
+	sigset_t set;
+	//新线程继承了loop线程的信号掩码,解除阻塞后信号由这个线程接收并转发给loop线程
+	sigemptyset(&set);
+	sigaddset(&set,SIGUSR1);
+	pthread_sigmask(SIG_UNBLOCK,&set,NULL);
+	chk_sleepms(50);
+	kill(getpid(),SIGUSR1);
+	return NULL;
+}
+
+int32_t timeout_cb(uint64_t tick,chk_ud ud) {
+	chk_loop_end(loop);
+	return -1;
+}
+
+int main(int argc,char **argv) {
+	int i;
+	pthread_t tid;
+	loop = chk_loop_new();
+	if(0 != chk_watch_signal(loop,SIGCHLD,on_sigchld,chk_ud_make_void(NULL),NULL) ||
+	   0 != chk_watch_signal(loop,SIGUSR1,on_sigusr1,chk_ud_make_void(NULL),NULL)) {
+		printf("watch signal failed\n");
+		return 0;
+	}
+	for(i = 0; i < CHILD_COUNT; ++i) {
+		if(0 == fork()) {
+			_exit(0);
+		}
+	}
+	pthread_create(&tid,NULL,kill_routine,NULL);
+	chk_loop_addtimer(loop,5000,timeout_cb,chk_ud_make_void(NULL));
+	chk_loop_run(loop);
+	pthread_join(tid,NULL);
+	chk_unwatch_signal(SIGUSR1);
+	printf("reaped:%d,usr1:%d\n",reaped,usr1_count);
+	if(reaped == CHILD_COUNT && usr1_count == 1) {
+		printf("ok\n");
+	}
+	chk_loop_del(loop);
+	return 0;
+}
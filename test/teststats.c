@@ -0,0 +1,61 @@
+#include <stdio.h>
+#include "testhelper.h"
+
+/*
+* 运行统计:定时器回调忙等(至少2毫秒),检查定时器耗时和loop延迟直方图
+*/
+
+chk_event_loop *loop;
+
+int timer_count = 0;
+
+int closure_count = 0;
+
+static void on_closure(chk_ud ud) {
+	++closure_count;
+}
+
+int32_t timer_cb(uint64_t tick,chk_ud ud) {
+	busy(3);
+	chk_loop_post_closure(loop,on_closure,chk_ud_make_void(NULL));
+	if(++timer_count == 10) {
+		chk_loop_end(loop);
+		return -1;
+	}
+	return 0;
+}
+
+int main(int argc,char **argv) {
+	uint32_t i;
+	uint64_t lag = 0;
+	chk_loop_stats stats;
+	loop = chk_loop_new();
+	if(chk_error_loop_stats_disable != chk_loop_get_stats(loop,&stats)) {
+		printf("stats should be disable\n");
+		return 0;
+	}
+	chk_loop_enable_stats(loop,1);
+	chk_loop_addtimer(loop,5,timer_cb,chk_ud_make_void(NULL));
+	chk_loop_run(loop);
+	chk_loop_get_stats(loop,&stats);
+	for(i = 0; i < CHK_LOOP_LAG_BUCKETS; ++i) {
+		lag += stats.lag[i];
+		if(i > 0 && chk_loop_stats_bucket(i) <= chk_loop_stats_bucket(i-1)) {
+			printf("bucket %u not increase\n",i);
+			return 0;
+		}
+	}
+	printf("iterations:%llu,wait:%llu us,timer:%llu us,closure:%llu us,lag p50:%llu us,p99:%llu us\n",
+		(unsigned long long)stats.iterations,
+		(unsigned long long)stats.wait_ns/1000,
+		(unsigned long long)stats.timer_ns/1000,
+		(unsigned long long)stats.closure_ns/1000,
+		(unsigned long long)chk_loop_stats_lag_percentile(&stats,50),
+		(unsigned long long)chk_loop_stats_lag_percentile(&stats,99));
+	if(stats.iterations > 0 && lag > 0 && lag <= stats.iterations && closure_count > 0 &&
+	   stats.timer_ns >= 10*2*1000*1000 && chk_loop_stats_lag_percentile(&stats,99) >= 2000) {
+		printf("ok\n");
+	}
+	chk_loop_del(loop);
+	return 0;
+}
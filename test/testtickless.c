@@ -0,0 +1,41 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <sys/resource.h>
+#include "chuck.h"
+
+/*
+*  注册一个2秒的定时器后让loop空闲,
+*  定时器到期前loop不应被唤醒(线程的主动上下文切换次数应接近0)
+*/
+
+#define IDLE_TIMEOUT 2000
+
+chk_event_loop *loop;
+
+uint64_t        start_tick;
+
+long            start_nvcsw;
+
+static long get_nvcsw() {
+	struct rusage usage;
+	getrusage(RUSAGE_THREAD,&usage);
+	return usage.ru_nvcsw;
+}
+
+int32_t on_timeout(uint64_t tick,chk_ud ud) {
+	long wakeups = get_nvcsw() - start_nvcsw;
+	printf("timeout after %llu ms,wakeups while idle:%ld\n",(unsigned long long)(chk_accurate_tick64() - start_tick),wakeups);
+	printf("%s\n",wakeups <= 2 ? "ok" : "failed");
+	chk_loop_end(loop);
+	return -1;
+}
+
+int main(int argc,char **argv) {
+	loop = chk_loop_new();
+	chk_loop_addtimer(loop,IDLE_TIMEOUT,on_timeout,chk_ud_make_void(NULL));
+	start_tick  = chk_accurate_tick64();
+	start_nvcsw = get_nvcsw();
+	chk_loop_run(loop);
+	chk_loop_del(loop);
+	return 0;
+}
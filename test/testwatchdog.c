@@ -0,0 +1,45 @@
+#include <stdio.h>
+#include "testhelper.h"
+
+/*
+* watchdog:阈值50毫秒,一个定时器回调和一个closure各忙等150毫秒,
+* 其它定时器回调很快返回,应当恰好检测到2次卡顿(调用栈写入系统日志)
+*/
+
+chk_event_loop *loop;
+
+int timer_count = 0;
+
+static void on_closure(chk_ud ud) {
+	busy(150);
+}
+
+int32_t timer_cb(uint64_t tick,chk_ud ud) {
+	++timer_count;
+	if(timer_count == 5) {
+		busy(150);
+		chk_loop_post_closure(loop,on_closure,chk_ud_make_void(NULL));
+	} else if(timer_count == 20) {
+		chk_loop_end(loop);
+		return -1;
+	}
+	return 0;
+}
+
+int main(int argc,char **argv) {
+	uint64_t stalls;
+	loop = chk_loop_new();
+	if(0 != chk_loop_set_watchdog(loop,50)) {
+		printf("set watchdog failed\n");
+		return 0;
+	}
+	chk_loop_addtimer(loop,10,timer_cb,chk_ud_make_void(NULL));
+	chk_loop_run(loop);
+	stalls = chk_loop_stall_count(loop);
+	printf("timer:%d,stalls:%llu\n",timer_count,(unsigned long long)stalls);
+	if(timer_count == 20 && stalls == 2) {
+		printf("ok\n");
+	}
+	chk_loop_del(loop);
+	return 0;
+}
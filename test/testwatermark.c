@@ -0,0 +1,123 @@
+#include <stdio.h>
+#include <sys/ioctl.h>
+#include <linux/sockios.h>
+#include "testhelper.h"
+
+/*
+* 发送队列水位:对端不读时生产者一直发送,达到高水位收到HIGH后暂停,
+* 对端读取使队列降到低水位收到LOW后继续,HIGH/LOW交替出现,对端收到的数据完整.
+* 设置TCP_NOTSENT_LOWAT之后内核中未发送的数据不超过lowat加一次写的大小,其余留在socket的队列中
+*/
+
+#define HIGH_WATER  (512*1024)
+#define LOW_WATER   (128*1024)
+#define NOTSENT     (16*1024)
+#define CHUNK_SIZE  (32*1024)
+#define TOTAL_SIZE  (8*1024*1024)
+
+chk_event_loop *loop;
+
+chk_stream_socket_option option = {
+	.recv_buffer_size = 1024,
+	.decoder = NULL,
+};
+
+int paused = 0;
+
+int highs = 0,lows = 0,alternate = 1;
+
+size_t sent = 0;
+
+void data_cb(chk_stream_socket *s,chk_bytebuffer *data,int32_t error) {
+}
+
+void water_cb(chk_stream_socket *s,int32_t event,chk_ud ud) {
+	if(event == CHK_SEND_WATER_HIGH) {
+		alternate = alternate && !paused;
+		++highs;
+		paused = 1;
+	} else {
+		alternate = alternate && paused;
+		++lows;
+		paused = 0;
+	}
+}
+
+static void produce(chk_stream_socket *s) {
+	size_t i;
+	char buf[CHUNK_SIZE];
+	chk_bytebuffer *b;
+	while(!paused && sent < TOTAL_SIZE) {
+		for(i = 0; i < CHUNK_SIZE; ++i) {
+			buf[i] = (char)((sent + i) % 251);
+		}
+		b = chk_bytebuffer_new(CHUNK_SIZE);
+		chk_bytebuffer_append(b,(uint8_t*)buf,CHUNK_SIZE);
+		chk_stream_socket_send(s,b);
+		sent += CHUNK_SIZE;
+		//水位回调在循环中触发
+		chk_loop_run_once(loop,0);
+	}
+}
+
+int main(int argc,char **argv) {
+	int i,r,fds[2],ok = 1,corrupt = 0,notsent = -1,max_notsent = 0,first_high = 0;
+	size_t received = 0;
+	char buf[65536];
+	uint64_t start;
+	chk_stream_socket *s;
+	signal(SIGPIPE,SIG_IGN);
+	//对端的接收窗口很小,发送端的数据大部分停留在未发送状态
+	if(0 != tcp_pair(fds,0,16*1024)) {
+		printf("tcp_pair failed\n");
+		return 0;
+	}
+	easy_noblock(fds[1],1);
+	loop = chk_loop_new();
+	s = chk_stream_socket_new(fds[0],&option);
+	chk_loop_add_handle(loop,(chk_handle*)s,data_cb);
+	ok = ok && chk_error_invaild_argument == chk_stream_socket_set_watermark(s,LOW_WATER,HIGH_WATER,water_cb,chk_ud_make_void(NULL));
+	chk_stream_socket_set_watermark(s,HIGH_WATER,LOW_WATER,water_cb,chk_ud_make_void(NULL));
+	if(0 != chk_stream_socket_notsent_lowat(s,NOTSENT)) {
+		printf("TCP_NOTSENT_LOWAT not supported\n");
+	}
+
+	//对端不读,直到高水位
+	produce(s);
+	for(i = 0; i < 10; ++i) {
+		chk_loop_run_once(loop,1);
+	}
+	ioctl(fds[0],SIOCOUTQNSD,&notsent);
+	first_high = highs == 1 && paused && sent < TOTAL_SIZE;
+	printf("paused at:%zu,highs:%d,kernel notsent:%d\n",sent,highs,notsent);
+	ok = ok && first_high && notsent >= 0 && notsent <= NOTSENT + 64*1024;
+
+	//对端读取,低水位时继续生产
+	start = chk_accurate_tick64();
+	while(received < TOTAL_SIZE && chk_accurate_tick64() - start < 10000) {
+		chk_loop_run_once(loop,1);
+		while((r = read(fds[1],buf,sizeof(buf))) > 0) {
+			for(i = 0; i < r; ++i) {
+				if(buf[i] != (char)((received + i) % 251)) {
+					++corrupt;
+				}
+			}
+			received += r;
+		}
+		if(0 == ioctl(fds[0],SIOCOUTQNSD,&notsent) && notsent > max_notsent) {
+			max_notsent = notsent;
+		}
+		produce(s);
+	}
+	printf("received:%zu/%d,corrupt:%d,highs:%d,lows:%d,alternate:%d,max kernel notsent:%d\n",
+		   received,TOTAL_SIZE,corrupt,highs,lows,alternate,max_notsent);
+	ok = ok && received == TOTAL_SIZE && corrupt == 0 && highs > 1 && lows >= highs - 1 && alternate;
+
+	if(ok) {
+		printf("ok\n");
+	}
+	chk_stream_socket_close(s,0);
+	chk_loop_del(loop);
+	close(fds[1]);
+	return 0;
+}
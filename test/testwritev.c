@@ -0,0 +1,17 @@
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <stddef.h>
+
+/*
+* 替换libc的writev,只链接进需要统计writev调用的测试(见src/Makefile的testcase)
+*/
+
+void (*on_writev)(int fd) = NULL;
+
+ssize_t writev(int fd,const struct iovec *iov,int iovcnt) {
+	if(on_writev) {
+		on_writev(fd);
+	}
+	return syscall(SYS_writev,fd,iov,iovcnt);
+}
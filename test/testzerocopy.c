@@ -0,0 +1,95 @@
+#include <stdio.h>
+#include "testhelper.h"
+
+/*
+* MSG_ZEROCOPY发送:大于阈值的写以MSG_ZEROCOPY发送,完成通知到达之前chunk一直被引用,
+* 小的写走拷贝路径.对端在本机时内核报告做了拷贝,之后自动退回拷贝发送.
+* 检查对端收到的数据完整,完成通知全部回收后chunk只剩测试自己的引用
+*/
+
+#define BUFFER_COUNT 8
+#define BUFFER_SIZE  (256*1024)
+
+chk_event_loop *loop;
+
+chk_stream_socket_option option = {
+	.recv_buffer_size = 1024,
+	.decoder = NULL,
+};
+
+void data_cb(chk_stream_socket *s,chk_bytebuffer *data,int32_t error) {
+}
+
+int main(int argc,char **argv) {
+	int i,j,fds[2],r,corrupt = 0;
+	uint64_t sends = 0,copied = 0,start;
+	uint32_t pending = 0,max_pending = 0;
+	size_t received = 0,total = 0;
+	char buf[65536];
+	chk_stream_socket *s;
+	chk_bytebuffer *b;
+	chk_bytechunk *chunk = NULL;
+	signal(SIGPIPE,SIG_IGN);
+	if(0 != tcp_pair(fds,0,0)) {
+		printf("tcp_pair failed\n");
+		return 0;
+	}
+	easy_noblock(fds[1],1);
+	loop = chk_loop_new();
+	s = chk_stream_socket_new(fds[0],&option);
+	chk_loop_add_handle(loop,(chk_handle*)s,data_cb);
+	if(0 != chk_stream_socket_zerocopy(s,16*1024)) {
+		printf("MSG_ZEROCOPY not supported\n");
+		printf("ok\n");
+		return 0;
+	}
+
+	for(i = 0; i < BUFFER_COUNT; ++i) {
+		b = chk_bytebuffer_new(BUFFER_SIZE);
+		for(j = 0; j < BUFFER_SIZE; j += sizeof(buf)) {
+			memset(buf,'a' + i,sizeof(buf));
+			chk_bytebuffer_append(b,(uint8_t*)buf,sizeof(buf));
+		}
+		if(i == 0) {
+			chunk = chk_bytechunk_retain(b->head);
+		}
+		chk_stream_socket_send(s,b);
+		total += BUFFER_SIZE;
+		chk_stream_socket_zerocopy_stats(s,NULL,NULL,&pending);
+		max_pending = pending > max_pending ? pending : max_pending;
+	}
+	//小的写走拷贝路径
+	b = chk_bytebuffer_new(16);
+	chk_bytebuffer_append(b,(uint8_t*)"tail",4);
+	chk_stream_socket_send(s,b);
+	total += 4;
+
+	start = chk_accurate_tick64();
+	while(chk_accurate_tick64() - start < 5000) {
+		chk_loop_run_once(loop,1);
+		while((r = read(fds[1],buf,sizeof(buf))) > 0) {
+			for(j = 0; j < r; ++j) {
+				size_t pos = received + j;
+				char expect = pos >= BUFFER_COUNT * BUFFER_SIZE ? "tail"[pos - BUFFER_COUNT * BUFFER_SIZE] : 'a' + pos / BUFFER_SIZE;
+				if(buf[j] != expect) {
+					++corrupt;
+				}
+			}
+			received += r;
+		}
+		chk_stream_socket_zerocopy_stats(s,&sends,&copied,&pending);
+		if(received == total && pending == 0) {
+			break;
+		}
+	}
+	printf("received:%zu/%zu,corrupt:%d,sends:%llu,copied:%llu,max pending:%u,pending:%u,refcount:%u\n",
+		   received,total,corrupt,(unsigned long long)sends,(unsigned long long)copied,max_pending,pending,chunk->refcount);
+	if(received == total && corrupt == 0 && sends > 0 && pending == 0 && chunk->refcount == 1) {
+		printf("ok\n");
+	}
+	chk_bytechunk_release(chunk);
+	chk_stream_socket_close(s,0);
+	chk_loop_del(loop);
+	close(fds[1]);
+	return 0;
+}